@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_blend.h"
+
+// Blends each pair of adjacent keys in a small, cache-resident pool of keys with the
+// given cardinality, comparing the scalar kernel against the vectorized kernel
+void bench_blend_linear(size_t cardinality)
+{
+	const size_t num_keys = 256;
+	float* keys = reinterpret_cast<float*>(malloc(num_keys * cardinality * sizeof(float)));
+	float* out = reinterpret_cast<float*>(malloc(cardinality * sizeof(float)));
+	for (size_t i = 0; i < num_keys * cardinality; i++)
+	{
+		keys[i] = static_cast<float>(i % 17);
+	}
+
+	const size_t iterations = 2000000;
+	const double scalar_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* a = keys + (i % (num_keys - 1)) * cardinality;
+			ad_blend_linear_scalar(a, a + cardinality, 0.3f, cardinality, out);
+		}
+		b_sink = out[0];
+	});
+	const double simd_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* a = keys + (i % (num_keys - 1)) * cardinality;
+			ad_blend_linear(a, a + cardinality, 0.3f, cardinality, out);
+		}
+		b_sink = out[0];
+	});
+	b_report("blend_linear_scalar", 1, cardinality, scalar_ns);
+	b_report("blend_linear", 1, cardinality, simd_ns);
+
+	free(keys);
+	free(out);
+}
+
+void bench_blend_cubic(size_t cardinality)
+{
+	// Hermite keys store a tangent after each value, so each key spans two runs
+	const size_t num_keys = 256;
+	const size_t stride = cardinality * 2;
+	float* keys = reinterpret_cast<float*>(malloc(num_keys * stride * sizeof(float)));
+	float* out = reinterpret_cast<float*>(malloc(cardinality * sizeof(float)));
+	for (size_t i = 0; i < num_keys * stride; i++)
+	{
+		keys[i] = static_cast<float>(i % 17);
+	}
+	const float weights[4] = { 0.784f, 0.147f, 0.216f, -0.063f };
+
+	const size_t iterations = 2000000;
+	const double scalar_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* a = keys + (i % (num_keys - 1)) * stride;
+			ad_blend_cubic_scalar(a, a + cardinality, a + stride, a + stride + cardinality, weights, cardinality, out);
+		}
+		b_sink = out[0];
+	});
+	const double simd_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float* a = keys + (i % (num_keys - 1)) * stride;
+			ad_blend_cubic(a, a + cardinality, a + stride, a + stride + cardinality, weights, cardinality, out);
+		}
+		b_sink = out[0];
+	});
+	b_report("blend_cubic_scalar", 1, cardinality, scalar_ns);
+	b_report("blend_cubic", 1, cardinality, simd_ns);
+
+	free(keys);
+	free(out);
+}
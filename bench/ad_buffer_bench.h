@@ -0,0 +1,43 @@
+#pragma once
+
+#include "benching.h"
+#include "ad_buffer.h"
+
+// Appends num_floats floats to a buffer one at a time, starting from a capacity of one,
+// so that the cost of each reallocation is amortized over every append
+void bench_buffer_append(size_t num_floats, float growth_factor)
+{
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_buffer buf;
+			buf.growth_factor = growth_factor;
+			buf.init(1);
+			for (size_t j = 0; j < num_floats; j++)
+			{
+				*buf.resize_for_edit(buf.size, 1) = static_cast<float>(j);
+			}
+			b_sink = buf.data[0];
+		}
+	}) / num_floats;
+	b_report(growth_factor >= 2.0f ? "buffer_append_growth_2" : "buffer_append_growth_1.5", num_floats, 1, ns);
+}
+
+// Inserts floats at the front of a buffer, so every edit shifts the whole buffer and
+// every reallocation has to copy the head and tail separately
+void bench_buffer_insert_front(size_t num_floats)
+{
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_buffer buf;
+			buf.init(1);
+			for (size_t j = 0; j < num_floats; j++)
+			{
+				*buf.resize_for_edit(0, 1) = static_cast<float>(j);
+			}
+			b_sink = buf.data[0];
+		}
+	}) / num_floats;
+	b_report("buffer_insert_front", num_floats, 1, ns);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_clip.h"
+
+// Evaluates a full pose for a rig with the given number of vec4 channels, either from one
+// curve per channel or from a single clip whose channels share a time axis
+void bench_clip_pose(size_t num_channels)
+{
+	const size_t num_keys = 1000;
+	const size_t cardinality = 4;
+	const size_t stride = num_channels * cardinality;
+	float* pose = reinterpret_cast<float*>(malloc(stride * sizeof(float)));
+	for (size_t i = 0; i < stride; i++)
+	{
+		pose[i] = static_cast<float>(i);
+	}
+
+	ad_curve** curves = reinterpret_cast<ad_curve**>(malloc(num_channels * sizeof(ad_curve*)));
+	for (size_t channel_i = 0; channel_i < num_channels; channel_i++)
+	{
+		curves[channel_i] = new ad_curve(cardinality, ad_interp::linear);
+		curves[channel_i]->init(num_keys);
+		for (size_t key_i = 0; key_i < num_keys; key_i++)
+		{
+			curves[channel_i]->set(static_cast<float>(key_i) / 30.0f, pose + channel_i * cardinality);
+		}
+	}
+
+	size_t* cardinalities = reinterpret_cast<size_t*>(malloc(num_channels * sizeof(size_t)));
+	ad_interp* interps = reinterpret_cast<ad_interp*>(malloc(num_channels * sizeof(ad_interp)));
+	for (size_t channel_i = 0; channel_i < num_channels; channel_i++)
+	{
+		cardinalities[channel_i] = cardinality;
+		interps[channel_i] = ad_interp::linear;
+	}
+	ad_clip clip(num_channels);
+	clip.init(cardinalities, interps, num_keys);
+	for (size_t key_i = 0; key_i < num_keys; key_i++)
+	{
+		clip.set(static_cast<float>(key_i) / 30.0f, pose);
+	}
+
+	// Sample at pseudo-random times so each pose needs a fresh search
+	const size_t iterations = 20000;
+	const float duration = static_cast<float>(num_keys) / 30.0f;
+	const double curves_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = static_cast<float>((i * 7919) % 10007) / 10007.0f * duration;
+			for (size_t channel_i = 0; channel_i < num_channels; channel_i++)
+			{
+				curves[channel_i]->evaluate(time, pose + channel_i * cardinality);
+			}
+		}
+		b_sink = pose[0];
+	});
+	const double clip_ns = b_measure(iterations, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = static_cast<float>((i * 7919) % 10007) / 10007.0f * duration;
+			clip.evaluate(time, pose);
+		}
+		b_sink = pose[0];
+	});
+	b_report("pose_from_curves", num_channels, cardinality, curves_ns);
+	b_report("pose_from_clip", num_channels, cardinality, clip_ns);
+
+	for (size_t channel_i = 0; channel_i < num_channels; channel_i++)
+	{
+		delete curves[channel_i];
+	}
+	free(curves);
+	free(cardinalities);
+	free(interps);
+	free(pose);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_compressed_curve.h"
+
+// Evaluates every curve in a library of num_curves vec3 curves (300 keys each, at 30 fps)
+// at a pseudo-random time, from full-precision curves or from compressed copies
+void bench_compressed_library(size_t num_curves, bool compressed, ad_quantize precision)
+{
+	const size_t num_keys = 300;
+	const size_t cardinality = 3;
+	ad_curve** curves = reinterpret_cast<ad_curve**>(malloc(num_curves * sizeof(ad_curve*)));
+	ad_compressed_curve** compressed_curves = reinterpret_cast<ad_compressed_curve**>(malloc(num_curves * sizeof(ad_compressed_curve*)));
+	uint32_t state = 1;
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++)
+	{
+		curves[curve_i] = new ad_curve(cardinality, ad_interp::linear);
+		curves[curve_i]->init(num_keys);
+		for (size_t key_i = 0; key_i < num_keys; key_i++)
+		{
+			const float value[3] = { static_cast<float>(b_random(state) % 1000), static_cast<float>(key_i), 0.5f };
+			curves[curve_i]->set(static_cast<float>(key_i) / 30.0f, value);
+		}
+		compressed_curves[curve_i] = new ad_compressed_curve(30.0f, precision);
+		compressed_curves[curve_i]->init(*curves[curve_i]);
+	}
+
+	float out[3];
+	const double ns = b_measure(1, [&](size_t n) {
+		uint32_t time_state = 7;
+		for (size_t i = 0; i < n; i++)
+		{
+			for (size_t curve_i = 0; curve_i < num_curves; curve_i++)
+			{
+				const float time = static_cast<float>(b_random(time_state) % (num_keys * 4)) / 120.0f;
+				if (compressed)
+				{
+					compressed_curves[curve_i]->evaluate(time, out);
+				}
+				else
+				{
+					curves[curve_i]->evaluate(time, out);
+				}
+				b_sink = out[0];
+			}
+		}
+	}) / num_curves;
+	const char* name = !compressed ? "library_evaluate_float" : (precision == ad_quantize::bits8 ? "library_evaluate_q8" : "library_evaluate_q16");
+	b_report(name, num_curves, cardinality, ns);
+
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++)
+	{
+		delete curves[curve_i];
+		delete compressed_curves[curve_i];
+	}
+	free(curves);
+	free(compressed_curves);
+}
@@ -0,0 +1,404 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_curve_t.h"
+#include "ad_curve_journal.h"
+
+// A small LCG, so that every run benchmarks the same pseudo-random sequence
+inline uint32_t b_random(uint32_t& state)
+{
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+// Returns a pseudo-random time anywhere in [0, duration), using every bit b_random gives
+// us, so that lookups spread across all the keys of even the largest curves
+static float random_time(uint32_t& state, float duration)
+{
+	return static_cast<float>(b_random(state) / 16777216.0 * duration);
+}
+
+// Fills an array with num_keys distinct key times in a shuffled order
+static float* make_shuffled_times(size_t num_keys)
+{
+	float* times = reinterpret_cast<float*>(malloc(num_keys * sizeof(float)));
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		times[i] = static_cast<float>(i);
+	}
+	uint32_t state = 12345;
+	for (size_t i = num_keys - 1; i > 0; i--)
+	{
+		const size_t j = b_random(state) % (i + 1);
+		const float tmp = times[i];
+		times[i] = times[j];
+		times[j] = tmp;
+	}
+	return times;
+}
+
+// Populates a curve with num_keys keys at integer times, with arbitrary values
+static void fill_curve(ad_curve& curve, size_t num_keys)
+{
+	float* times = reinterpret_cast<float*>(malloc(num_keys * sizeof(float)));
+	float* values = reinterpret_cast<float*>(malloc(num_keys * curve.stride * sizeof(float)));
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		times[i] = static_cast<float>(i);
+	}
+	for (size_t i = 0; i < num_keys * curve.stride; i++)
+	{
+		values[i] = static_cast<float>(i % 101);
+	}
+	curve.init(num_keys);
+	curve.set_many(times, values, num_keys);
+	free(times);
+	free(values);
+}
+
+// Picks pseudo-random times halfway between the integer key times left by fill_curve, so
+// that each set inserts a key and each remove_at removes it again: the times are kept
+// below 2^23, past which a float can't hold the half and the edit would land on a key
+static float* make_edit_times(size_t num_keys, size_t num_edits)
+{
+	const size_t max_key = num_keys < (1 << 23) ? num_keys : (1 << 23);
+	float* times = reinterpret_cast<float*>(malloc(num_edits * sizeof(float)));
+	uint32_t state = 7;
+	for (size_t i = 0; i < num_edits; i++)
+	{
+		times[i] = static_cast<float>(b_random(state) % (max_key - 1)) + 0.5f;
+	}
+	return times;
+}
+
+// Looks up keys at pseudo-random times, so each search starts from scratch
+void bench_curve_search(size_t num_keys)
+{
+	// Measure plain binary searches first, with no search index
+	ad_curve curve(1);
+	fill_curve(curve, num_keys);
+	curve.search_index_threshold = SIZE_MAX;
+	const float duration = static_cast<float>(num_keys);
+
+	const size_t iterations = 1000000;
+	const double lte_ns = b_measure(iterations, [&](size_t n) {
+		uint32_t state = 1;
+		int32_t sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = random_time(state, duration);
+			sum += curve.find_nearest_lte(time);
+		}
+		b_sink = static_cast<float>(sum);
+	});
+	const double range_ns = b_measure(iterations, [&](size_t n) {
+		uint32_t state = 1;
+		int32_t sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = random_time(state, duration);
+			int32_t range_n = 0;
+			sum += curve.find_inclusive_range(time, time + 2.5f, range_n) + range_n;
+		}
+		b_sink = static_cast<float>(sum);
+	});
+	// Then search again with a search index
+	curve.build_search_index();
+	const double indexed_lte_ns = b_measure(iterations, [&](size_t n) {
+		uint32_t state = 1;
+		int32_t sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = random_time(state, duration);
+			sum += curve.find_nearest_lte(time);
+		}
+		b_sink = static_cast<float>(sum);
+	});
+	const double indexed_range_ns = b_measure(iterations, [&](size_t n) {
+		uint32_t state = 1;
+		int32_t sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = random_time(state, duration);
+			int32_t range_n = 0;
+			sum += curve.find_inclusive_range(time, time + 2.5f, range_n) + range_n;
+		}
+		b_sink = static_cast<float>(sum);
+	});
+
+	// The same keys are evenly spaced, so the curve can drop its times and compute indices
+	curve.make_uniform();
+	const double uniform_ns = b_measure(iterations, [&](size_t n) {
+		uint32_t state = 1;
+		int32_t sum = 0;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float time = random_time(state, duration);
+			sum += curve.find_nearest_lte(time);
+		}
+		b_sink = static_cast<float>(sum);
+	});
+	b_report("curve_find_nearest_lte", num_keys, 1, lte_ns);
+	b_report("curve_find_inclusive_range", num_keys, 1, range_ns);
+	b_report("curve_find_nearest_lte_indexed", num_keys, 1, indexed_lte_ns);
+	b_report("curve_find_inclusive_range_indexed", num_keys, 1, indexed_range_ns);
+	b_report("curve_find_nearest_lte_uniform", num_keys, 1, uniform_ns);
+}
+
+// Samples a curve at sorted times, with a fresh search per sample or with evaluate_many
+void bench_curve_evaluate(size_t num_keys, size_t cardinality)
+{
+	ad_curve curve(cardinality, ad_interp::linear);
+	fill_curve(curve, num_keys);
+
+	// Sample four times per key across the whole curve
+	const size_t num_samples = num_keys * 4;
+	float* times = reinterpret_cast<float*>(malloc(num_samples * sizeof(float)));
+	float* out = reinterpret_cast<float*>(malloc(num_samples * cardinality * sizeof(float)));
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		times[i] = static_cast<float>(i) * 0.25f;
+	}
+
+	const double evaluate_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n * num_samples; i++)
+		{
+			curve.evaluate(times[i % num_samples], out + (i % num_samples) * cardinality);
+		}
+		b_sink = out[0];
+	}) / num_samples;
+	const double evaluate_many_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			curve.evaluate_many(times, num_samples, out);
+		}
+		b_sink = out[0];
+	}) / num_samples;
+	b_report("curve_evaluate", num_keys, cardinality, evaluate_ns);
+	b_report("curve_evaluate_many", num_keys, cardinality, evaluate_many_ns);
+
+	free(times);
+	free(out);
+}
+
+// Equivalent to bench_curve_evaluate, but with the cardinality fixed at compile time
+template <size_t N>
+void bench_curve_t_evaluate(size_t num_keys)
+{
+	ad_curve_t<float, float, N> curve(ad_interp::linear);
+	curve.init(num_keys);
+	float value[N];
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		for (size_t k = 0; k < N; k++)
+		{
+			value[k] = static_cast<float>((i * 7 + k) % 13);
+		}
+		curve.set(static_cast<float>(i), value);
+	}
+
+	const size_t num_samples = num_keys * 4;
+	float* times = reinterpret_cast<float*>(malloc(num_samples * sizeof(float)));
+	float* out = reinterpret_cast<float*>(malloc(num_samples * N * sizeof(float)));
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		times[i] = static_cast<float>(i) * 0.25f;
+	}
+
+	const double evaluate_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n * num_samples; i++)
+		{
+			curve.evaluate(times[i % num_samples], out + (i % num_samples) * N);
+		}
+		b_sink = out[0];
+	}) / num_samples;
+	const double evaluate_many_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			curve.evaluate_many(times, num_samples, out);
+		}
+		b_sink = out[0];
+	}) / num_samples;
+	b_report("curve_t_evaluate", num_keys, N, evaluate_ns);
+	b_report("curve_t_evaluate_many", num_keys, N, evaluate_many_ns);
+
+	free(times);
+	free(out);
+}
+
+// Inserts keys at pseudo-random times between existing keys, then removes them again,
+// so that each operation has to shift the tail of a curve with num_keys keys
+void bench_curve_set_remove(size_t num_keys, size_t cardinality)
+{
+	ad_curve curve(cardinality);
+	fill_curve(curve, num_keys);
+	curve.reserve(num_keys * 2);
+	float* value = reinterpret_cast<float*>(calloc(cardinality, sizeof(float)));
+
+	// Large curves take far longer per edit, so we make fewer of them
+	const size_t num_edits = num_keys > 100000 ? 20 : 1000;
+	float* edit_times = make_edit_times(num_keys, num_edits);
+
+	double best_set_ns = 0.0;
+	double best_remove_ns = 0.0;
+	for (int pass = 0; pass < 5; pass++)
+	{
+		const double start = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.set(edit_times[i], value);
+		}
+		const double mid = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.remove_at(edit_times[i]);
+		}
+		const double end = b_now_ns();
+
+		const double set_ns = (mid - start) / num_edits;
+		const double remove_ns = (end - mid) / num_edits;
+		best_set_ns = pass == 0 || set_ns < best_set_ns ? set_ns : best_set_ns;
+		best_remove_ns = pass == 0 || remove_ns < best_remove_ns ? remove_ns : best_remove_ns;
+	}
+	b_report("curve_set", num_keys, cardinality, best_set_ns);
+	b_report("curve_remove_at", num_keys, cardinality, best_remove_ns);
+
+	free(value);
+	free(edit_times);
+}
+
+// Imports num_keys keys in a shuffled order, one at a time or in a single batch
+void bench_curve_import(size_t num_keys)
+{
+	float* times = make_shuffled_times(num_keys);
+	float* values = make_shuffled_times(num_keys);
+
+	const double set_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_curve curve(1);
+			curve.init(16);
+			for (size_t key_i = 0; key_i < num_keys; key_i++)
+			{
+				curve.set(times[key_i], values + key_i);
+			}
+			b_sink = curve.values.data[0];
+		}
+	}) / num_keys;
+	const double set_many_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_curve curve(1);
+			curve.init(16);
+			curve.set_many(times, values, num_keys);
+			b_sink = curve.values.data[0];
+		}
+	}) / num_keys;
+	b_report("curve_import_set", num_keys, 1, set_ns);
+	b_report("curve_import_set_many", num_keys, 1, set_many_ns);
+
+	free(times);
+	free(values);
+}
+
+// Imports and reduces a noisy sine wave of num_keys linear keys to within a tolerance
+// wider than its noise
+void bench_curve_reduce(size_t num_keys)
+{
+	float* times = reinterpret_cast<float*>(malloc(num_keys * sizeof(float)));
+	float* values = reinterpret_cast<float*>(malloc(num_keys * sizeof(float)));
+	uint32_t state = 1;
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		times[i] = static_cast<float>(i) * 0.01f;
+		values[i] = sinf(times[i]) + (b_random(state) / 16777216.0f - 0.5f) * 0.01f;
+	}
+
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_curve curve(1, ad_interp::linear);
+			curve.set_many(times, values, num_keys);
+			curve.reduce(0.01f);
+			b_sink = curve.values.data[curve.num_keys - 1];
+		}
+	}) / num_keys;
+	b_report("curve_reduce", num_keys, 1, ns);
+
+	free(times);
+	free(values);
+}
+
+// Makes the same edits as bench_curve_set_remove with a journal attached, then undoes
+// and redoes them: compared against copying the whole curve, as an undo stack holding a
+// copy per edit would have to
+void bench_curve_journal(size_t num_keys)
+{
+	ad_curve curve(1);
+	fill_curve(curve, num_keys);
+	curve.reserve(num_keys * 2);
+	ad_curve_journal journal;
+	journal.init(1 << 20);
+	journal.attach(curve);
+
+	const size_t num_edits = num_keys > 100000 ? 20 : 1000;
+	float* edit_times = make_edit_times(num_keys, num_edits);
+
+	double best_set_ns = 0.0;
+	double best_undo_ns = 0.0;
+	double best_redo_ns = 0.0;
+	for (int pass = 0; pass < 5; pass++)
+	{
+		const float value = static_cast<float>(pass);
+		const double start = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.set(edit_times[i], &value);
+		}
+		const double set_end = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			journal.undo();
+		}
+		const double undo_end = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			journal.redo();
+		}
+		const double redo_end = b_now_ns();
+		journal.clear();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.remove_at(edit_times[i]);
+		}
+		journal.clear();
+
+		const double set_ns = (set_end - start) / num_edits;
+		const double undo_ns = (undo_end - set_end) / num_edits;
+		const double redo_ns = (redo_end - undo_end) / num_edits;
+		best_set_ns = pass == 0 || set_ns < best_set_ns ? set_ns : best_set_ns;
+		best_undo_ns = pass == 0 || undo_ns < best_undo_ns ? undo_ns : best_undo_ns;
+		best_redo_ns = pass == 0 || redo_ns < best_redo_ns ? redo_ns : best_redo_ns;
+	}
+
+	float* copy = reinterpret_cast<float*>(malloc(num_keys * 2 * sizeof(float)));
+	const double copy_ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			memcpy(copy, curve.times.data, num_keys * sizeof(float));
+			memcpy(copy + num_keys, curve.values.data, num_keys * sizeof(float));
+			b_sink = copy[i % num_keys];
+		}
+	});
+	b_report("curve_journal_set", num_keys, 1, best_set_ns);
+	b_report("curve_journal_undo", num_keys, 1, best_undo_ns);
+	b_report("curve_journal_redo", num_keys, 1, best_redo_ns);
+	b_report("curve_copy_for_undo", num_keys, 1, copy_ns);
+
+	free(copy);
+	free(edit_times);
+}
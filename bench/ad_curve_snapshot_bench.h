@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_curve_snapshot.h"
+
+// Edits one key at a pseudo-random time in a curve with num_keys keys and publishes the
+// result, compared to copying a whole ad_curve's keys so that readers can keep the old one
+void bench_snapshot_edit(size_t num_keys)
+{
+	ad_shared_curve shared(3, ad_interp::linear);
+	shared.init();
+	ad_curve curve(3, ad_interp::linear);
+	curve.init(num_keys);
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		const float value[3] = { static_cast<float>(i % 7), 1.0f, 2.0f };
+		shared.set(static_cast<float>(i), value);
+		curve.set(static_cast<float>(i), value);
+	}
+	shared.publish();
+
+	const size_t num_edits = 1000;
+	const double publish_ns = b_measure(num_edits, [&](size_t n) {
+		uint32_t state = 3;
+		for (size_t i = 0; i < n; i++)
+		{
+			const float value[3] = { static_cast<float>(i), 0.0f, 0.0f };
+			shared.set(static_cast<float>(b_random(state) % num_keys), value);
+			shared.publish();
+		}
+	});
+
+	ad_curve copy(3, ad_interp::linear);
+	copy.init(num_keys);
+	copy.times.size = num_keys;
+	copy.values.size = num_keys * 3;
+	const double copy_ns = b_measure(num_edits / 10, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			memcpy(copy.times.data, curve.times.data, num_keys * sizeof(float));
+			memcpy(copy.values.data, curve.values.data, num_keys * 3 * sizeof(float));
+			b_sink = copy.values.data[i % num_keys];
+		}
+	});
+	b_report("snapshot_set_publish", num_keys, 3, publish_ns);
+	b_report("curve_copy", num_keys, 3, copy_ns);
+}
+
+// Acquires the latest snapshot, evaluates it at a pseudo-random time and releases it,
+// compared to evaluating an ad_curve directly
+void bench_snapshot_evaluate(size_t num_keys)
+{
+	ad_shared_curve shared(3, ad_interp::linear);
+	shared.init();
+	ad_curve curve(3, ad_interp::linear);
+	curve.init(num_keys);
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		const float value[3] = { static_cast<float>(i % 7), 1.0f, 2.0f };
+		shared.set(static_cast<float>(i), value);
+		curve.set(static_cast<float>(i), value);
+	}
+	shared.publish();
+
+	const size_t num_lookups = 100000;
+	float out[3];
+	const double snapshot_ns = b_measure(num_lookups, [&](size_t n) {
+		uint32_t state = 5;
+		for (size_t i = 0; i < n; i++)
+		{
+			const ad_curve_snapshot* snapshot = shared.acquire();
+			snapshot->evaluate(static_cast<float>(b_random(state) % (num_keys * 4)) * 0.25f, out);
+			snapshot->release();
+			b_sink = out[0];
+		}
+	});
+	const double curve_ns = b_measure(num_lookups, [&](size_t n) {
+		uint32_t state = 5;
+		for (size_t i = 0; i < n; i++)
+		{
+			curve.evaluate(static_cast<float>(b_random(state) % (num_keys * 4)) * 0.25f, out);
+			b_sink = out[0];
+		}
+	});
+	b_report("snapshot_evaluate", num_keys, 3, snapshot_ns);
+	b_report("curve_evaluate_random", num_keys, 3, curve_ns);
+}
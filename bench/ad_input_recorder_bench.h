@@ -0,0 +1,78 @@
+#pragma once
+
+#include "benching.h"
+#include "ad_input_recorder.h"
+
+// Feeds num_samples samples at 1 kHz through a recorder, with a value that either changes
+// on every sample or holds steady (so that nearly every sample is discarded)
+void bench_input_recorder(size_t num_samples, bool changing)
+{
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_input_recorder recorder(4096, 1);
+			recorder.init();
+			for (size_t j = 0; j < num_samples; j++)
+			{
+				const float value = changing ? static_cast<float>(j & 0xff) : 1.0f;
+				recorder.handle_sample(static_cast<float>(j) * 0.001f, value);
+			}
+			b_sink = recorder.last_value_recorded;
+		}
+	}) / num_samples;
+	b_report(changing ? "input_recorder_changing" : "input_recorder_constant", num_samples, 1, ns);
+}
+
+// Feeds changing samples through a recorder that's reset (grow) or wraps around (ring)
+// between takes, so that steady-state recording reuses chunks instead of allocating
+void bench_input_recorder_reuse(size_t num_samples, ad_input_record_mode mode)
+{
+	ad_input_recorder recorder(4096, 4, ad_default_allocator(), mode);
+	recorder.init();
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			recorder.reset();
+			for (size_t j = 0; j < num_samples; j++)
+			{
+				recorder.handle_sample(static_cast<float>(j) * 0.001f, static_cast<float>(j & 0xff));
+			}
+			b_sink = recorder.last_value_recorded;
+		}
+	}) / num_samples;
+	b_report(mode == ad_input_record_mode::ring ? "input_recorder_ring" : "input_recorder_reset", num_samples, 1, ns);
+}
+
+// Bakes num_samples recorded samples into a curve, either in one pass or by calling
+// ad_curve::set per sample
+void bench_input_recorder_bake(size_t num_samples, bool per_key_set)
+{
+	ad_input_recorder recorder(4096, 1);
+	recorder.init();
+	for (size_t j = 0; j < num_samples; j++)
+	{
+		recorder.handle_sample(static_cast<float>(j) * 0.001f, static_cast<float>(j & 0xff));
+	}
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_curve curve(1, ad_interp::linear);
+			if (per_key_set)
+			{
+				curve.init(16);
+				ad_input_record_reader reader(recorder);
+				ad_input_sample sample;
+				while (reader.read(&sample, 1) == 1)
+				{
+					curve.set(sample.time, &sample.value);
+				}
+			}
+			else
+			{
+				ad_bake_to_curve(recorder, curve);
+			}
+			b_sink = curve.values.data[curve.num_keys - 1];
+		}
+	}) / num_samples;
+	b_report(per_key_set ? "input_recorder_bake_set" : "input_recorder_bake", num_samples, 1, ns);
+}
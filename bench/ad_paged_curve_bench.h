@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_paged_curve.h"
+
+// Equivalent to bench_curve_set_remove, for a paged curve: each edit only shifts keys
+// within one page, however large the curve
+void bench_paged_set_remove(size_t num_keys, size_t cardinality)
+{
+	ad_curve source(cardinality);
+	fill_curve(source, num_keys);
+	ad_paged_curve curve(cardinality);
+	curve.init();
+	curve.assign(source);
+	float* value = reinterpret_cast<float*>(calloc(cardinality, sizeof(float)));
+
+	const size_t num_edits = 1000;
+	float* edit_times = make_edit_times(num_keys, num_edits);
+
+	double best_set_ns = 0.0;
+	double best_remove_ns = 0.0;
+	for (int pass = 0; pass < 5; pass++)
+	{
+		const double start = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.set(edit_times[i], value);
+		}
+		const double mid = b_now_ns();
+		for (size_t i = 0; i < num_edits; i++)
+		{
+			curve.remove_at(edit_times[i]);
+		}
+		const double end = b_now_ns();
+
+		const double set_ns = (mid - start) / num_edits;
+		const double remove_ns = (end - mid) / num_edits;
+		best_set_ns = pass == 0 || set_ns < best_set_ns ? set_ns : best_set_ns;
+		best_remove_ns = pass == 0 || remove_ns < best_remove_ns ? remove_ns : best_remove_ns;
+	}
+	b_report("paged_set", num_keys, cardinality, best_set_ns);
+	b_report("paged_remove_at", num_keys, cardinality, best_remove_ns);
+
+	free(value);
+	free(edit_times);
+}
+
+// Equivalent to bench_curve_evaluate's batched case, for a paged curve
+void bench_paged_evaluate_many(size_t num_keys, size_t cardinality)
+{
+	ad_curve source(cardinality, ad_interp::linear);
+	fill_curve(source, num_keys);
+	ad_paged_curve curve(cardinality, ad_interp::linear);
+	curve.init();
+	curve.assign(source);
+
+	const size_t num_samples = num_keys * 4;
+	float* times = reinterpret_cast<float*>(malloc(num_samples * sizeof(float)));
+	float* out = reinterpret_cast<float*>(malloc(num_samples * cardinality * sizeof(float)));
+	for (size_t i = 0; i < num_samples; i++)
+	{
+		times[i] = static_cast<float>(i) * 0.25f;
+	}
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			curve.evaluate_many(times, num_samples, out);
+		}
+		b_sink = out[0];
+	}) / num_samples;
+	b_report("paged_evaluate_many", num_keys, cardinality, ns);
+
+	free(times);
+	free(out);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "benching.h"
+#include "ad_curve.h"
+#include "ad_thread_pool.h"
+
+// Evaluates a frame's worth of jobs for a crowd of num_curves vec4 curves (1000 keys each),
+// serially or spread across a thread pool with the default number of workers
+void bench_evaluate_jobs(size_t num_curves, bool parallel)
+{
+	const size_t num_keys = 1000;
+	const size_t cardinality = 4;
+	ad_curve** curves = reinterpret_cast<ad_curve**>(malloc(num_curves * sizeof(ad_curve*)));
+	ad_eval_job* jobs = reinterpret_cast<ad_eval_job*>(malloc(num_curves * sizeof(ad_eval_job)));
+	float* out = reinterpret_cast<float*>(malloc(num_curves * cardinality * sizeof(float)));
+	uint32_t state = 1;
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++)
+	{
+		curves[curve_i] = new ad_curve(cardinality, ad_interp::linear);
+		fill_curve(*curves[curve_i], num_keys);
+		jobs[curve_i].curve = curves[curve_i];
+		jobs[curve_i].time = static_cast<float>(b_random(state) % (num_keys * 16)) / 16.0f;
+		jobs[curve_i].out_value = out + curve_i * cardinality;
+	}
+
+	ad_thread_pool pool(parallel ? ad_default_num_workers() : 0);
+	pool.init();
+	const double ns = b_measure(1, [&](size_t n) {
+		for (size_t i = 0; i < n; i++)
+		{
+			ad_evaluate_jobs(&pool, jobs, num_curves);
+		}
+		b_sink = out[0];
+	}) / num_curves;
+	b_report(parallel ? "evaluate_jobs_parallel" : "evaluate_jobs_serial", num_curves, cardinality, ns);
+
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++)
+	{
+		delete curves[curve_i];
+	}
+	free(curves);
+	free(jobs);
+	free(out);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Benchmarks write their results here so the compiler can't discard the work
+static volatile float b_sink;
+
+// Each benchmark reports the time per operation for a given problem size (n, e.g. the
+// number of keys in a curve) and cardinality, and we collect those results so that they
+// can be written out in a machine-readable format once all benchmarks have run
+struct b_result
+{
+	const char* name;
+	size_t n;
+	size_t cardinality;
+	double ns_per_op;
+};
+
+#define B_MAX_RESULTS 1024
+static b_result b_results[B_MAX_RESULTS];
+static size_t b_num_results = 0;
+static const char* b_filter = nullptr;
+
+// Returns the current time in nanoseconds, from an arbitrary epoch
+inline double b_now_ns()
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Calls fn(iterations) for a warm-up pass and then several timed passes, returning the
+// fastest observed time per iteration in nanoseconds
+template <typename F>
+double b_measure(size_t iterations, F fn)
+{
+	fn(iterations / 10 + 1);
+
+	double best_ns = 0.0;
+	for (int pass = 0; pass < 5; pass++)
+	{
+		const double start = b_now_ns();
+		fn(iterations);
+		const double ns = (b_now_ns() - start) / iterations;
+		if (pass == 0 || ns < best_ns)
+		{
+			best_ns = ns;
+		}
+	}
+	return best_ns;
+}
+
+// Returns true if benchmarks in the given group should run, given the --filter argument
+inline bool b_should_run(const char* group)
+{
+	return !b_filter || strstr(group, b_filter) != nullptr;
+}
+
+inline void b_report(const char* name, size_t n, size_t cardinality, double ns_per_op)
+{
+	printf("%-32s %10zu %6zu %16.3f\n", name, n, cardinality, ns_per_op);
+	fflush(stdout);
+	if (b_num_results < B_MAX_RESULTS)
+	{
+		b_results[b_num_results++] = { name, n, cardinality, ns_per_op };
+	}
+}
+
+inline bool b_write_csv(const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp)
+	{
+		return false;
+	}
+	fprintf(fp, "name,n,cardinality,ns_per_op\n");
+	for (size_t i = 0; i < b_num_results; i++)
+	{
+		const b_result& result = b_results[i];
+		fprintf(fp, "%s,%zu,%zu,%.3f\n", result.name, result.n, result.cardinality, result.ns_per_op);
+	}
+	fclose(fp);
+	return true;
+}
+
+inline bool b_write_json(const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp)
+	{
+		return false;
+	}
+	fprintf(fp, "[\n");
+	for (size_t i = 0; i < b_num_results; i++)
+	{
+		const b_result& result = b_results[i];
+		const char* separator = i + 1 < b_num_results ? "," : "";
+		fprintf(fp, "  {\"name\": \"%s\", \"n\": %zu, \"cardinality\": %zu, \"ns_per_op\": %.3f}%s\n", result.name, result.n, result.cardinality, result.ns_per_op, separator);
+	}
+	fprintf(fp, "]\n");
+	fclose(fp);
+	return true;
+}
+
+// Parses arguments: '--filter <text>' only runs benchmark groups whose names contain the
+// given text, and '--csv <path>' and '--json <path>' write results to the given files
+#define b_begin(argc, argv) \
+	const char* b_csv_path = nullptr; \
+	const char* b_json_path = nullptr; \
+	for (int b_i = 1; b_i + 1 < argc; b_i += 2) { \
+		if (strcmp(argv[b_i], "--filter") == 0) { \
+			b_filter = argv[b_i + 1]; \
+		} else if (strcmp(argv[b_i], "--csv") == 0) { \
+			b_csv_path = argv[b_i + 1]; \
+		} else if (strcmp(argv[b_i], "--json") == 0) { \
+			b_json_path = argv[b_i + 1]; \
+		} \
+	} \
+	printf("%-32s %10s %6s %16s\n", "benchmark", "n", "card", "ns/op");
+
+#define b_end() \
+	if (b_csv_path && !b_write_csv(b_csv_path)) { \
+		printf("failed to write %s\n", b_csv_path); \
+		return 1; \
+	} \
+	if (b_json_path && !b_write_json(b_json_path)) { \
+		printf("failed to write %s\n", b_json_path); \
+		return 1; \
+	} \
+	return 0;
@@ -0,0 +1,140 @@
+#include <cstdio>
+
+#include "benching.h"
+#include "ad_blend_bench.h"
+#include "ad_buffer_bench.h"
+#include "ad_curve_bench.h"
+#include "ad_clip_bench.h"
+#include "ad_input_recorder_bench.h"
+#include "ad_compressed_curve_bench.h"
+#include "ad_thread_pool_bench.h"
+#include "ad_paged_curve_bench.h"
+#include "ad_curve_snapshot_bench.h"
+
+int main(int argc, char** argv)
+{
+	printf("blend kernels: %s, worker threads: %zu\n", ad_blend_isa(), ad_default_num_workers());
+	b_begin(argc, argv);
+
+	const size_t cardinalities[] = { 1, 3, 4, 16 };
+	const size_t key_counts[] = { 10, 1000, 100000, 10000000 };
+
+	if (b_should_run("blend"))
+	{
+		for (size_t cardinality : cardinalities)
+		{
+			bench_blend_linear(cardinality);
+			bench_blend_cubic(cardinality);
+		}
+	}
+
+	if (b_should_run("buffer"))
+	{
+		for (size_t num_floats : key_counts)
+		{
+			bench_buffer_append(num_floats, 2.0f);
+			bench_buffer_append(num_floats, 1.5f);
+		}
+		bench_buffer_insert_front(10);
+		bench_buffer_insert_front(1000);
+		bench_buffer_insert_front(100000);
+	}
+
+	if (b_should_run("curve_search"))
+	{
+		const size_t search_key_counts[] = { 10, 1000, 100000, 1000000, 10000000 };
+		for (size_t num_keys : search_key_counts)
+		{
+			bench_curve_search(num_keys);
+		}
+	}
+
+	if (b_should_run("curve_evaluate"))
+	{
+		for (size_t cardinality : cardinalities)
+		{
+			bench_curve_evaluate(1000, cardinality);
+			bench_curve_evaluate(100000, cardinality);
+		}
+		bench_curve_t_evaluate<1>(1000);
+		bench_curve_t_evaluate<3>(1000);
+		bench_curve_t_evaluate<4>(1000);
+		bench_curve_t_evaluate<1>(100000);
+		bench_curve_t_evaluate<3>(100000);
+		bench_curve_t_evaluate<4>(100000);
+	}
+
+	if (b_should_run("curve_edit"))
+	{
+		for (size_t num_keys : key_counts)
+		{
+			bench_curve_set_remove(num_keys, 1);
+			bench_curve_set_remove(num_keys, 4);
+			bench_curve_journal(num_keys);
+		}
+		bench_curve_import(1000);
+		bench_curve_import(100000);
+		bench_curve_reduce(100000);
+	}
+
+	if (b_should_run("clip"))
+	{
+		bench_clip_pose(20);
+		bench_clip_pose(200);
+	}
+
+	if (b_should_run("input_recorder"))
+	{
+		bench_input_recorder(100000, true);
+		bench_input_recorder(100000, false);
+		bench_input_recorder(10000000, true);
+		bench_input_recorder_reuse(100000, ad_input_record_mode::grow);
+		bench_input_recorder_reuse(100000, ad_input_record_mode::ring);
+		bench_input_recorder_bake(1000000, false);
+		bench_input_recorder_bake(1000000, true);
+	}
+
+	if (b_should_run("compressed"))
+	{
+		const size_t library_sizes[] = { 100, 10000 };
+		for (size_t num_curves : library_sizes)
+		{
+			bench_compressed_library(num_curves, false, ad_quantize::bits16);
+			bench_compressed_library(num_curves, true, ad_quantize::bits16);
+			bench_compressed_library(num_curves, true, ad_quantize::bits8);
+		}
+	}
+
+	if (b_should_run("parallel"))
+	{
+		const size_t crowd_sizes[] = { 500, 20000 };
+		for (size_t num_curves : crowd_sizes)
+		{
+			bench_evaluate_jobs(num_curves, false);
+			bench_evaluate_jobs(num_curves, true);
+		}
+	}
+
+	if (b_should_run("paged"))
+	{
+		for (size_t num_keys : key_counts)
+		{
+			bench_paged_set_remove(num_keys, 1);
+			bench_paged_set_remove(num_keys, 4);
+		}
+		bench_paged_evaluate_many(1000, 3);
+		bench_paged_evaluate_many(100000, 3);
+	}
+
+	if (b_should_run("snapshot"))
+	{
+		const size_t snapshot_key_counts[] = { 1000, 100000, 1000000 };
+		for (size_t num_keys : snapshot_key_counts)
+		{
+			bench_snapshot_edit(num_keys);
+			bench_snapshot_evaluate(num_keys);
+		}
+	}
+
+	b_end();
+}
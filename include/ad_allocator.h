@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+
+// A table of allocation callbacks, plus an opaque pointer that's passed to each of them.
+// Sizes are always given back on reallocate and deallocate, so allocators don't need to
+// store a header for each block. Reallocating a null pointer should allocate.
+struct ad_allocator
+{
+	void* (*allocate_fn)(void* user, size_t size);
+	void* (*reallocate_fn)(void* user, void* ptr, size_t old_size, size_t new_size);
+	void (*deallocate_fn)(void* user, void* ptr, size_t size);
+	void* user;
+
+	inline void* allocate(size_t size) const { return allocate_fn(user, size); }
+	inline void* reallocate(void* ptr, size_t old_size, size_t new_size) const { return reallocate_fn(user, ptr, old_size, new_size); }
+	inline void deallocate(void* ptr, size_t size) const { deallocate_fn(user, ptr, size); }
+};
+
+// Returns an allocator that uses malloc, realloc and free
+const ad_allocator* ad_default_allocator();
+
+// A linear allocator that carves blocks out of one contiguous region: individual blocks
+// are never freed, but the whole arena can be reset in O(1)
+struct ad_arena
+{
+	size_t capacity; // Number of bytes in the region
+	size_t used; // Number of bytes allocated so far, including alignment padding
+	size_t last_offset; // Offset of the most recent allocation, which can grow in place
+	uint8_t* data; // Contiguous region whose length == capacity
+	ad_allocator allocator; // Allocates from this arena
+
+	ad_arena();
+	~ad_arena();
+
+	bool init(size_t in_capacity);
+	void* allocate(size_t size);
+	void* reallocate(void* ptr, size_t old_size, size_t new_size);
+	void deallocate(void* ptr, size_t size);
+	void reset();
+};
+
+// A pool allocator that keeps a free list for each of several power-of-two size classes,
+// refilling them from slabs requested from a backing allocator: requests larger than the
+// largest class go straight to the backing allocator
+#define AD_POOL_NUM_CLASSES 8
+
+struct ad_pool
+{
+	size_t min_block_size; // Size of blocks in the smallest class: each class doubles it
+	size_t slab_size; // Number of bytes to request from the backing allocator on refill
+	const ad_allocator* backing;
+	void* free_lists[AD_POOL_NUM_CLASSES]; // Singly-linked lists of free blocks
+	void* slabs; // Singly-linked list of every slab we've allocated
+	ad_allocator allocator; // Allocates from this pool
+
+	ad_pool(size_t in_min_block_size = 16, size_t in_slab_size = 65536, const ad_allocator* in_backing = ad_default_allocator());
+	~ad_pool();
+
+	void* allocate(size_t size);
+	void* reallocate(void* ptr, size_t old_size, size_t new_size);
+	void deallocate(void* ptr, size_t size);
+	void reset();
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+
+// Curves and clips can be written to a compact binary format and loaded back without
+// copying. Every blob is little-endian and starts with an ad_binary_header, and every
+// section within a blob starts on a 16-byte boundary: a blob that's memory-mapped (or
+// viewed inside a wasm ArrayBuffer) at a 16-byte-aligned address can be evaluated in
+// place. Blob sizes are always multiples of 16, so blobs can be packed back-to-back.
+
+#define AD_BINARY_MAGIC 0x54414441u // "ADAT", read as a little-endian uint32
+#define AD_BINARY_VERSION 1u
+#define AD_BINARY_ALIGNMENT 16
+
+enum class ad_binary_kind : uint32_t
+{
+	curve = 1,
+	clip = 2,
+};
+
+struct ad_binary_header
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t kind;
+	uint32_t size; // Total size of the blob in bytes, including this header
+};
+
+// A curve blob is followed by num_keys times, then num_keys values of stride floats
+// each (cardinality values, followed by cardinality tangents for hermite curves)
+struct ad_binary_curve_header
+{
+	uint32_t cardinality;
+	uint32_t num_keys;
+	uint8_t interp;
+	uint8_t padding[7];
+};
+
+// A clip blob is followed by num_channels channels, then num_keys times, then num_keys
+// poses of every channel's value back-to-back
+struct ad_binary_clip_header
+{
+	uint32_t num_channels;
+	uint32_t num_keys;
+	uint32_t padding[2];
+};
+
+struct ad_binary_clip_channel
+{
+	uint32_t cardinality;
+	uint8_t interp;
+	uint8_t padding[3];
+};
+
+inline size_t ad_binary_align(size_t num_bytes)
+{
+	return (num_bytes + AD_BINARY_ALIGNMENT - 1) & ~static_cast<size_t>(AD_BINARY_ALIGNMENT - 1);
+}
+
+// Writes a header for a blob of the given kind and size, which must already be aligned
+void ad_binary_write_header(void* out, ad_binary_kind kind, size_t size);
+
+// Validates that data holds a complete, aligned blob of the given kind, written with a
+// version we can read, returning its header or nullptr
+const ad_binary_header* ad_binary_check(const void* data, size_t size, ad_binary_kind kind);
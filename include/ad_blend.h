@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdlib>
+
+// The blend kernels below are vectorized at compile time for the best instruction set
+// the target supports (AVX or SSE2 on x64, SIMD128 for wasm), with a scalar fallback
+
+// Blends n floats linearly from a toward b: out = a + (b - a) * alpha
+void ad_blend_linear(const float* a, const float* b, float alpha, size_t n, float* out);
+void ad_blend_linear_scalar(const float* a, const float* b, float alpha, size_t n, float* out);
+
+// Blends n floats as a weighted sum of two points and two tangents, e.g. with the cubic
+// Hermite basis: out = weights[0] * p0 + weights[1] * m0 + weights[2] * p1 + weights[3] * m1
+void ad_blend_cubic(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out);
+void ad_blend_cubic_scalar(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out);
+
+// Blends between two unit quaternions along the shorter path, either by normalizing the
+// linear blend (nlerp) or by angle (slerp when spherical is true)
+void ad_blend_quat(const float* a, const float* b, float alpha, bool spherical, float* out);
+
+// Returns the name of the instruction set the blend kernels were compiled for
+const char* ad_blend_isa();
@@ -6,15 +6,40 @@
 #include <cassert>
 #include <cinttypes>
 
-struct ad_buffer
+#include "ad_allocator.h"
+
+// A growable array of trivially-copyable elements, explicitly instantiated in
+// ad_buffer.cpp for float, double and int64_t
+template <typename T>
+struct ad_buffer_t
 {
-	size_t capacity; // Number of floats that can be stored in the data buffer
-	size_t size; // Number of floats actually stored in the data buffer
-	float* data; // Contiguous buffer whose length == capacity
+	size_t capacity; // Number of elements that can be stored in the data buffer
+	size_t size; // Number of elements actually stored in the data buffer
+	T* data; // Contiguous buffer whose length == capacity
+
+	// When an edit needs more capacity, we grow to the larger of capacity * growth_factor
+	// or the required size plus reserve_ahead: a factor of 1 with no reserve grows to fit
+	float growth_factor;
+	size_t reserve_ahead;
+
+	const ad_allocator* allocator; // Used for all allocations of our data buffer
 
-	ad_buffer();
-	~ad_buffer();
+	// A borrowed buffer views data owned by someone else (e.g. a memory-mapped file): it's
+	// read-only, and it never reallocates or frees that data
+	bool borrowed;
+
+	ad_buffer_t(const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_buffer_t();
 
 	bool init(size_t initial_capacity);
-	float* resize_for_edit(size_t i, int32_t delta_size);
+	void init_borrowed(const T* in_data, size_t in_size);
+	bool reserve(size_t min_capacity);
+	bool shrink_to_fit();
+	T* resize_for_edit(size_t i, int32_t delta_size);
 };
+
+extern template struct ad_buffer_t<float>;
+extern template struct ad_buffer_t<double>;
+extern template struct ad_buffer_t<int64_t>;
+
+typedef ad_buffer_t<float> ad_buffer;
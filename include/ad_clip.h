@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdlib>
+#include <cassert>
+
+#include "ad_buffer.h"
+#include "ad_curve.h"
+
+struct ad_clip_channel
+{
+	size_t cardinality; // Number of floats in this channel's value
+	size_t offset; // Index of this channel's first float within each pose
+	ad_interp interp; // Any mode but hermite, since poses don't store tangents
+};
+
+// A set of channels that share one array of key times, so a single search finds the key
+// for every channel. Times are kept apart from values, but values are stored pose-major
+// (every channel's value for a key, back-to-back) rather than one array per channel:
+// evaluating a pose reads two adjacent keys in full, which pose-major keeps to two
+// contiguous runs, where per-channel arrays would touch two separate lines per channel.
+struct ad_clip
+{
+	size_t num_channels;
+	size_t stride; // Number of floats in each pose: the sum of all channel cardinalities
+	size_t num_keys;
+	ad_clip_channel* channels; // Array of num_channels channel descriptions
+	const ad_allocator* allocator;
+
+	ad_buffer times; // One time per key, shared by every channel
+	ad_buffer values; // One pose per key, holding each channel's value back-to-back
+
+	ad_clip(size_t in_num_channels, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_clip();
+
+	bool init(const size_t* cardinalities, const ad_interp* interps, size_t initial_capacity);
+	// Points the clip at the keys in a binary blob (see ad_binary.h) without copying them.
+	// The blob stays owned by the caller, and may be read-only: every edit to a borrowed
+	// clip fails, returning false and leaving the blob untouched.
+	bool init_borrowed(const void* data, size_t size);
+	bool reserve(size_t num_keys_to_fit);
+	bool set(float time, const float* pose);
+	bool remove_at(float time);
+
+	bool is_borrowed() const { return times.borrowed || values.borrowed; }
+
+	bool evaluate(float time, float* out_pose) const;
+	bool evaluate_at(int32_t times_i, float time, float* out_pose) const;
+
+	int32_t find_nearest_lte(float at_time) const;
+	int32_t find_nearest_lte_from(float at_time, int32_t hint) const;
+
+	size_t binary_size() const;
+	size_t write_binary(void* out, size_t out_size) const;
+};
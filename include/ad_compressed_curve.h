@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+
+#include "ad_allocator.h"
+#include "ad_curve.h"
+
+enum class ad_quantize : uint8_t
+{
+	bits8, // 8 bits per component, or 32 bits per quaternion
+	bits16, // 16 bits per component, or 64 bits per quaternion
+};
+
+// A read-only, compressed copy of a curve whose keys lie on a fixed frame grid. Times are
+// stored as frame indices (16 bits if every frame fits, or 32 bits otherwise), and each
+// component of each value is quantized within that component's range across the curve.
+// Quaternion curves (nlerp or slerp) instead use a smallest-three encoding: the largest
+// component is dropped and reconstructed, and the other three are quantized to within
+// +/- 1/sqrt(2). Keys are decoded on the fly during evaluation.
+struct ad_compressed_curve
+{
+	size_t cardinality;
+	ad_interp interp; // Any mode but hermite
+	float frame_rate; // Number of frames per second in the grid that keys are stored on
+	ad_quantize precision;
+	size_t num_keys;
+	size_t frame_bytes; // Size of each stored frame index: 2 or 4
+	size_t key_bytes; // Size of each stored value
+
+	const ad_allocator* allocator;
+	size_t data_size;
+	uint8_t* data; // Single block holding mins, scales, frames and values, in that order
+	const float* mins; // Per-component minimum value, for non-quaternion curves
+	const float* scales; // Per-component size of each quantization step
+	const uint8_t* frames;
+	const uint8_t* values;
+
+	ad_compressed_curve(float in_frame_rate, ad_quantize in_precision = ad_quantize::bits16, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_compressed_curve();
+
+	bool init(const ad_curve& source);
+
+	bool evaluate(float time, float* out_value) const;
+	int32_t find_nearest_lte(float frame) const;
+	uint32_t frame_at(size_t i) const;
+	void decode(size_t i, float* out_value) const;
+};
@@ -2,25 +2,147 @@
 
 #include <cstdlib>
 #include <cassert>
+#include <atomic>
 
 #include "ad_buffer.h"
 
+struct ad_curve_journal;
+
+enum class ad_interp : uint8_t
+{
+	constant, // Hold the value of the nearest key at or before the evaluated time
+	linear, // Blend linearly between the values of adjacent keys
+	hermite, // Cubic Hermite spline, using a tangent stored alongside each key's value
+	nlerp, // Normalized linear blend between quaternions (cardinality 4 only)
+	slerp, // Spherical linear blend between quaternions (cardinality 4 only)
+};
+
+// Binary searches a sorted array of key times for the last key at or before at_time,
+// returning -1 if every key is after at_time
+int32_t ad_find_nearest_lte(const float* times, size_t num_times, float at_time);
+
+// Equivalent to ad_find_nearest_lte, but searches outward from a previous result, so
+// that lookups with sorted or nearly-sorted times cost O(log distance) from the hint
+int32_t ad_find_nearest_lte_from(const float* times, size_t num_times, float at_time, int32_t hint);
+
+// Blends between two adjacent keys, each storing its value (followed by its tangent, for
+// hermite curves) as floats: shared by every curve type with that layout
+bool ad_evaluate_segment(ad_interp interp, size_t cardinality, float time_a, const float* value_a, float time_b, const float* value_b, float time, float* out_value);
+
+// Large curves can search a sparse index holding the time of every 64th key: the index
+// is small enough to stay in cache, leaving just a 64-key block of the full array to
+// search, rather than missing the cache at nearly every step of a binary search
+#define AD_SEARCH_INDEX_STRIDE 64
+
+enum class ad_merge_policy : uint8_t
+{
+	replace, // Incoming keys overwrite existing keys at the same time
+	keep, // Existing keys are kept, and incoming keys at the same time are discarded
+};
+
+// Edits mark the span of time over which they may have changed the curve's evaluated
+// value as dirty: up to this many disjoint ranges are tracked before the closest are merged
+#define AD_MAX_DIRTY_RANGES 4
+
+struct ad_time_range
+{
+	float from_time; // Either bound may be infinite, if an edit affects the curve's ends
+	float to_time;
+};
+
+struct ad_curve;
+typedef void (*ad_dirty_fn)(void* user, const ad_curve& curve, float from_time, float to_time);
+
 struct ad_curve
 {
-	size_t cardinality;
+	size_t cardinality; // Number of floats in each value
+	size_t stride; // Number of floats stored per key: value, then tangent for hermite curves
 	size_t num_keys;
+	ad_interp interp;
 
-	ad_buffer times;
+	// A uniform curve has keys at start_time + i * time_step, and stores no times at all:
+	// lookups compute key indices directly, and any edit that would break the spacing
+	// converts the curve back to explicit times first
+	bool uniform;
+	float start_time;
+	float time_step;
+
+	ad_buffer times; // Empty for uniform curves
 	ad_buffer values;
 
-	ad_curve(size_t in_cardinality);
+	// Lookups build a search index lazily once we have at least search_index_threshold
+	// keys, and edits invalidate it. Const lookups are safe from any number of threads:
+	// only one thread builds the index at a time, publishing it by setting
+	// search_index_valid with release semantics, and the others fall back to a plain
+	// binary search until it's ready. Edits still need exclusive access, as ever.
+	size_t search_index_threshold;
+	mutable ad_buffer search_index;
+	mutable std::atomic<bool> search_index_valid;
+	mutable std::atomic<bool> search_index_building;
+
+	// If a journal is attached, every edit records the keys it changes there
+	ad_curve_journal* journal;
+
+	// Caches derived from the curve can rebuild just the dirty ranges (sorted and disjoint),
+	// then clear them: the hook, if set, is also called with the span of each edit
+	ad_time_range dirty_ranges[AD_MAX_DIRTY_RANGES];
+	size_t num_dirty_ranges;
+	ad_dirty_fn dirty_hook;
+	void* dirty_hook_user;
+
+	ad_curve(size_t in_cardinality, ad_interp in_interp = ad_interp::constant, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_curve();
 
 	bool init(size_t initial_capacity);
-    void set(float time, float* value);
-	void remove_at(float time);
+	bool init_uniform(float in_start_time, float in_time_step, size_t initial_capacity);
+	// Points the curve at the keys in a binary blob (see ad_binary.h) without copying them.
+	// The blob stays owned by the caller, and may be read-only: every edit to a borrowed
+	// curve fails, returning false (or -1 from remove_range) and leaving the blob untouched.
+	bool init_borrowed(const void* data, size_t size);
+	bool reserve(size_t num_keys_to_fit);
+	bool make_uniform(float tolerance = 1e-5f);
+	bool make_explicit();
+	bool set(float time, const float* value, const float* tangent = nullptr);
+	bool set_many(const float* in_times, const float* in_values, size_t n, ad_merge_policy policy = ad_merge_policy::replace);
+	bool remove_at(float time);
+	int32_t remove_range(float from_time, float to_time);
+	bool shift_range(float from_time, float to_time, float delta_time);
+	bool scale_range(float from_time, float to_time, float factor, float pivot_time);
+	bool retime_range(float from_time, float to_time, float factor, float pivot_time, float delta_time);
+	// Removes keys that the remaining keys reproduce to within tolerance: only constant and
+	// linear curves can be reduced, so this fails for any other interpolation mode
+	bool reduce(float tolerance);
 	
+	bool build_search_index() const;
+	void invalidate_search_index() { search_index_valid.store(false, std::memory_order_relaxed); }
+	bool is_borrowed() const { return times.borrowed || values.borrowed; }
+	float key_time(size_t i) const { return uniform ? start_time + static_cast<float>(i) * time_step : times.data[i]; }
+
+	void mark_dirty(float from_time, float to_time);
+	void mark_dirty_keys(size_t key_i, size_t n);
+	void note_appended(size_t key_i, size_t n);
+	void clear_dirty() { num_dirty_ranges = 0; }
+
 	bool evaluate(float time, float* out_value) const;
+	bool evaluate_many(const float* in_times, size_t n, float* out_values) const;
+	bool evaluate_at(int32_t times_i, float time, float* out_value) const;
 
 	int32_t find_nearest_lte(float at_time) const;
+	int32_t find_nearest_lte_from(float at_time, int32_t hint) const;
 	int32_t find_inclusive_range(float from_time, float to_time, int32_t& out_n) const;
+
+	size_t binary_size() const;
+	size_t write_binary(void* out, size_t out_size) const;
+};
+
+struct ad_curve_cursor
+{
+	const ad_curve* curve;
+	int32_t index; // Index of the last key found to be <= the search time, or -1
+
+	ad_curve_cursor(const ad_curve& in_curve);
+
+	void reset();
+	int32_t seek(float time);
+	bool evaluate(float time, float* out_value);
 };
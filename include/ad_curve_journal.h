@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+
+#include "ad_allocator.h"
+
+struct ad_curve;
+
+enum class ad_journal_op : uint8_t
+{
+	insert, // Keys were inserted: the record holds them, for redo
+	remove, // Keys were removed: the record holds them, for undo
+	modify, // Keys were overwritten in place: the record holds the version not in the curve
+};
+
+// Each record stores the keys it covers (their times, then their values) inline after
+// this header, followed by a copy of size, so that records can be walked in either
+// direction. Every record made by one edit shares an entry, and they're undone together.
+struct ad_journal_record
+{
+	uint32_t size; // Bytes in the whole record, including keys and the trailing size
+	uint32_t entry;
+	uint32_t key_i; // Index of the first key covered
+	uint32_t num_keys;
+	ad_journal_op op;
+	uint8_t pad[3];
+};
+
+// Records each edit made to an attached curve as a minimal delta, so that it can be
+// undone or redone in time proportional to the keys it touched, rather than by keeping a
+// copy of the whole curve. Records are packed into a single block of fixed capacity:
+// once it's full, the oldest edits are forgotten to make room for new ones.
+struct ad_curve_journal
+{
+	size_t capacity; // Bytes that records can occupy
+	size_t size; // Bytes of records held, whether they can be undone or redone
+	size_t undo_size; // Bytes of records that can be undone: any after them can be redone
+	uint8_t* data; // Contiguous block whose length == capacity
+	uint32_t next_entry;
+	uint32_t group_depth; // While nonzero, every record joins group_entry
+	uint32_t group_entry;
+	bool group_dropped; // Set if part of the open group had to be forgotten
+	ad_curve* curve;
+	const ad_allocator* allocator;
+
+	ad_curve_journal(const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_curve_journal();
+
+	bool init(size_t in_capacity);
+	void attach(ad_curve& in_curve);
+	void detach();
+	void clear();
+
+	// Groups every edit made until the matching end_group into a single undo step
+	void begin_group();
+	void end_group();
+
+	bool can_undo() const { return undo_size > 0; }
+	bool can_redo() const { return undo_size < size; }
+	bool undo();
+	bool redo();
+
+	// Called by the attached curve as it edits itself: inserts are recorded after the
+	// keys are written, removes and modifies before the keys are changed
+	void record(ad_journal_op op, size_t key_i, size_t num_keys);
+};
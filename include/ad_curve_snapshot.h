@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+#include <atomic>
+
+#include "ad_allocator.h"
+#include "ad_paged_curve.h"
+
+// Lets one writer thread edit a curve while any number of reader threads evaluate it. The
+// writer edits a paged curve, which shares every page it hasn't touched with the last
+// published snapshot, and publishes a snapshot of it with an atomic pointer swap.
+// Readers never block, and never see a version that's partly edited. Publishing waits
+// only for readers already partway through acquire, never for readers that arrive after
+// it starts, so a steady stream of readers can't stall the writer. The allocator must be
+// safe to call from any thread, since the last reader to release a snapshot frees it.
+struct ad_shared_curve
+{
+	ad_paged_curve editor; // Only the writer sees edits, until they're published
+	std::atomic<const ad_curve_snapshot*> current; // The latest published snapshot
+	// Readers count themselves in one of two slots while they acquire, loading current
+	// only after they're counted: publish switches new readers to the other slot before
+	// waiting for a slot to drain, so that no new readers can join the slot it waits on
+	mutable std::atomic<uint32_t> num_acquiring[2];
+	std::atomic<uint32_t> acquiring_slot;
+
+	ad_shared_curve(size_t in_cardinality, ad_interp in_interp = ad_interp::constant, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_shared_curve();
+
+	// Writer thread only
+	bool init();
+	bool set(float time, const float* value, const float* tangent = nullptr);
+	bool remove_at(float time);
+	bool publish();
+
+	// Any thread: each acquired snapshot must be released when the reader is done with it
+	const ad_curve_snapshot* acquire() const;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdlib>
+#include <cassert>
+
+#include "ad_buffer.h"
+#include "ad_curve.h"
+
+// A curve whose values have a cardinality of N, known at compile time, so that copies and
+// blends can be unrolled for scalars, vec3s and quaternions. Times can be floats, doubles
+// or integer ticks (int64_t): float times lose sub-millisecond precision after a few
+// hours, so long recordings should use one of the others. Tangents for hermite curves are
+// in value units per unit of time, i.e. per tick for tick times.
+//
+// Explicitly instantiated in ad_curve_t.cpp for float values with N from 1 to 4 and each
+// of those time types. ad_curve remains the general-purpose type, with a cardinality
+// chosen at runtime, uniform key spacing, a search index and binary serialization.
+template <typename TTime, typename TValue, size_t N>
+struct ad_curve_t
+{
+	static const size_t cardinality = N;
+
+	size_t stride; // Number of values stored per key: N, or 2 * N for hermite curves
+	ad_interp interp;
+
+	ad_buffer_t<TTime> times;
+	ad_buffer_t<TValue> values;
+
+	ad_curve_t(ad_interp in_interp = ad_interp::constant, const ad_allocator* in_allocator = ad_default_allocator());
+
+	size_t num_keys() const { return times.size; }
+
+	bool init(size_t initial_capacity);
+	bool reserve(size_t num_keys_to_fit);
+	bool set(TTime time, const TValue* value, const TValue* tangent = nullptr);
+	void remove_at(TTime time);
+
+	bool evaluate(TTime time, TValue* out_value) const;
+	bool evaluate_many(const TTime* in_times, size_t n, TValue* out_values) const;
+	bool evaluate_at(int32_t times_i, TTime time, TValue* out_value) const;
+
+	int32_t find_nearest_lte(TTime at_time) const;
+	int32_t find_nearest_lte_from(TTime at_time, int32_t hint) const;
+};
+
+extern template struct ad_curve_t<float, float, 1>;
+extern template struct ad_curve_t<float, float, 2>;
+extern template struct ad_curve_t<float, float, 3>;
+extern template struct ad_curve_t<float, float, 4>;
+extern template struct ad_curve_t<double, float, 1>;
+extern template struct ad_curve_t<double, float, 2>;
+extern template struct ad_curve_t<double, float, 3>;
+extern template struct ad_curve_t<double, float, 4>;
+extern template struct ad_curve_t<int64_t, float, 1>;
+extern template struct ad_curve_t<int64_t, float, 2>;
+extern template struct ad_curve_t<int64_t, float, 3>;
+extern template struct ad_curve_t<int64_t, float, 4>;
@@ -2,6 +2,10 @@
 
 #include <cstdlib>
 #include <cinttypes>
+#include <atomic>
+
+#include "ad_allocator.h"
+#include "ad_curve.h"
 
 enum class ad_input_type : uint8_t
 {
@@ -15,17 +19,27 @@ struct ad_input_sample
     float value;
 };
 
+// Recorders are safe to read from one other thread while recording: the recording thread
+// publishes each chunk's size with release semantics after writing a sample, and links
+// the next chunk before publishing the sample that fills the current one, so a reader
+// that loads size with acquire semantics can safely read every sample (and next) it sees
 struct ad_input_record_chunk
 {
     size_t capacity; // Number of samples we can hold
-    size_t size; // Number of samples currently buffered
-    ad_input_sample* data; // Array of samples, allocated up to capacity if non-null
-    struct ad_input_record_chunk* next;
+    std::atomic<size_t> size; // Number of samples currently buffered and published
+    ad_input_sample* data; // Array of samples, stored inline right after this header
+    struct ad_input_record_chunk* next; // Always linked before this chunk fills up
 
-    ad_input_record_chunk(size_t in_capacity);
-    ~ad_input_record_chunk();
+    ad_input_record_chunk(size_t in_capacity, ad_input_sample* in_data);
 
-    bool init();
+    static ad_input_record_chunk* create(size_t capacity, const ad_allocator* allocator);
+    static void destroy(ad_input_record_chunk* chunk, const ad_allocator* allocator);
+};
+
+enum class ad_input_record_mode : uint8_t
+{
+    grow, // Keep every sample, allocating new chunks as needed
+    ring, // Keep only the most recent samples, recycling the oldest chunk once all are full
 };
 
 struct ad_input_recorder
@@ -34,15 +48,69 @@ struct ad_input_recorder
     size_t num_initial_chunks;
     ad_input_record_chunk* first;
     ad_input_record_chunk* write_head;
+    ad_input_record_chunk* free_chunks; // Chunks that can be reused before allocating more
+    size_t num_free_chunks;
+    const ad_allocator* allocator;
+    ad_input_record_mode mode;
+
+    // With a tolerance of 0, only exact repeats of a value are dropped; otherwise, any
+    // sample that linear interpolation can reproduce to within tolerance is dropped,
+    // using a swinging door: the range of slopes from our last recorded sample that
+    // stay within tolerance of every sample seen since
+    float tolerance;
+    float slope_min;
+    float slope_max;
 
     float last_value_recorded;
     float last_time_recorded;
+    float last_value_seen;
     float last_time_seen;
 
-    ad_input_recorder(size_t in_chunk_size, size_t in_num_initial_chunks);
+    ad_input_recorder(size_t in_chunk_size, size_t in_num_initial_chunks, const ad_allocator* in_allocator = ad_default_allocator(), ad_input_record_mode in_mode = ad_input_record_mode::grow);
     ~ad_input_recorder();
 
     bool init();
+    void reset();
+    // Returns every chunk that a reader has finished with to our free list, reading the
+    // position the reader has published, so it's safe while that reader runs on another
+    // thread: but like every other method that records, it must only be called from the
+    // recording thread. Rings recycle their own chunks, so they can't release any.
+    void release_read_chunks(const struct ad_input_record_reader& reader);
     bool handle_sample(float time, float value);
+    bool flush();
     bool write(float time, float value);
+    ad_input_record_chunk* new_chunk();
+    void free_chunk(ad_input_record_chunk* chunk);
+};
+
+// Reads samples that have been committed to a recorder, in order, without locking: a
+// reader may run on a different thread than the one recording, but there should be only
+// one recording thread, and readers must not outlive their recorder. Ring recorders
+// recycle chunks in place, so a reader can only run concurrently with a ring recorder if
+// it's guaranteed to keep up; likewise, resetting a recorder or releasing its chunks
+// invalidates any reader that's behind the new first chunk.
+struct ad_input_record_reader
+{
+    const ad_input_record_chunk* chunk; // Chunk we're currently reading from
+    size_t index; // Index of the next sample to read within that chunk
+
+    // A copy of chunk, published with release semantics each time we move on to a new
+    // chunk, for the recording thread to read in release_read_chunks
+    std::atomic<const ad_input_record_chunk*> published_chunk;
+
+    ad_input_record_reader(const ad_input_recorder& recorder);
+
+    size_t peek(const ad_input_sample*& out_samples);
+    void consume(size_t n);
+    size_t read(ad_input_sample* out_samples, size_t max_samples);
 };
+
+// Appends every sample a reader has yet to read onto the end of a cardinality-1 curve,
+// advancing the reader past them: samples are already time-ordered, so keys are appended
+// in a single pass rather than searched for. Baking again with the same reader while
+// recording continues picks up only newly-committed samples. Recorded samples are
+// meant to be interpolated linearly.
+bool ad_bake_to_curve(ad_input_record_reader& reader, ad_curve& curve);
+
+// Bakes every sample a recorder has committed so far onto the end of a curve
+bool ad_bake_to_curve(const ad_input_recorder& recorder, ad_curve& curve);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+#include <atomic>
+
+// Instrumentation is opt-in at compile time: build with -DAD_INSTRUMENT=1 to enable the
+// counters and trace scopes below. Otherwise, every AD_COUNT and AD_TRACE_SCOPE compiles
+// away to nothing, and the counters simply stay at zero.
+#ifndef AD_INSTRUMENT
+#define AD_INSTRUMENT 0
+#endif
+
+// Running totals, updated with relaxed atomics: hot loops tally locally and add once
+struct ad_counters
+{
+	std::atomic<uint64_t> search_iterations; // Binary search steps taken by key lookups
+	std::atomic<uint64_t> bytes_moved; // Bytes shifted or copied by ad_buffer edits
+	std::atomic<uint64_t> reallocations; // Buffer reallocations made by ad_buffer edits
+	std::atomic<uint64_t> chunk_allocations; // Chunks allocated (not reused) by recorders
+	std::atomic<uint64_t> samples_dropped; // Samples that recorders skipped on arrival, as unchanged or within tolerance
+};
+
+ad_counters& ad_get_counters();
+void ad_reset_counters();
+
+// Scoped timing hooks: while a hook is set, each trace scope reports its name, thread and
+// start and end times (in nanoseconds, from a steady clock) when it closes
+typedef void (*ad_trace_fn)(void* user, const char* name, uint32_t thread_id, uint64_t begin_ns, uint64_t end_ns);
+void ad_set_trace_hook(ad_trace_fn fn, void* user);
+uint64_t ad_trace_now_ns();
+uint32_t ad_trace_thread_id();
+
+struct ad_trace_scope
+{
+	const char* name; // Must outlive the scope: usually a string literal
+	uint64_t begin_ns;
+
+	ad_trace_scope(const char* in_name);
+	~ad_trace_scope();
+};
+
+// A trace hook that collects events in memory, to be written out as a Chrome trace-event
+// JSON file (viewable in chrome://tracing or Perfetto)
+struct ad_trace_event
+{
+	const char* name;
+	uint32_t thread_id;
+	uint64_t begin_ns;
+	uint64_t end_ns;
+};
+
+struct ad_trace_log
+{
+	size_t capacity;
+	size_t size;
+	ad_trace_event* events;
+	struct ad_trace_log_lock* lock; // Guards events, since scopes close on any thread
+
+	ad_trace_log();
+	~ad_trace_log();
+
+	bool init(size_t initial_capacity);
+	void add(const char* name, uint32_t thread_id, uint64_t begin_ns, uint64_t end_ns);
+	bool write_chrome_json(const char* path) const;
+
+	static void hook(void* user, const char* name, uint32_t thread_id, uint64_t begin_ns, uint64_t end_ns);
+};
+
+#if AD_INSTRUMENT
+#define AD_COUNT(counter, n) ad_get_counters().counter.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed)
+#define AD_TRACE_CONCAT_INNER(a, b) a##b
+#define AD_TRACE_CONCAT(a, b) AD_TRACE_CONCAT_INNER(a, b)
+#define AD_TRACE_SCOPE(name) ad_trace_scope AD_TRACE_CONCAT(ad_trace_scope_, __LINE__)(name)
+#else
+#define AD_COUNT(counter, n) ((void)sizeof(n))
+#define AD_TRACE_SCOPE(name) ((void)0)
+#endif
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+#include <atomic>
+
+#include "ad_allocator.h"
+#include "ad_curve.h"
+
+// Number of keys that each page can hold: an edit copies at most one page of keys
+#define AD_CURVE_PAGE_KEYS 256
+
+// Paged curves store their keys in fixed-size pages, which are refcounted so that each
+// snapshot can share every page that later edits don't touch: a page that's referenced
+// by more than one version is immutable, and must be cloned before it can be edited
+struct ad_curve_page
+{
+	std::atomic<uint32_t> refcount;
+	uint32_t num_keys;
+	float* times; // AD_CURVE_PAGE_KEYS times, stored inline right after this header
+	float* values; // AD_CURVE_PAGE_KEYS * stride values, stored inline after the times
+
+	ad_curve_page(float* in_times, float* in_values);
+
+	static ad_curve_page* create(size_t stride, const ad_allocator* allocator);
+	static ad_curve_page* clone(const ad_curve_page* source, size_t stride, const ad_allocator* allocator);
+	static void release(ad_curve_page* page, size_t stride, const ad_allocator* allocator);
+};
+
+// A version of a paged curve: a table of pages in key order, along with the time of each
+// page's first key, so that a lookup only has to touch the one page it lands in. Once
+// it's shared as a snapshot, it's immutable: readers hold a reference while they
+// evaluate it, and the last to release it frees it.
+struct ad_curve_snapshot
+{
+	mutable std::atomic<uint32_t> refcount;
+	size_t cardinality;
+	size_t stride; // Number of floats stored per key: value, then tangent for hermite curves
+	ad_interp interp;
+	size_t num_keys;
+	size_t num_pages;
+	size_t page_capacity; // Number of slots in pages and page_first_times
+	ad_curve_page** pages; // Stored inline right after this header
+	float* page_first_times; // Stored inline after pages
+	const ad_allocator* allocator;
+
+	ad_curve_snapshot(size_t in_cardinality, size_t in_stride, ad_interp in_interp, size_t in_page_capacity, const ad_allocator* in_allocator);
+
+	static ad_curve_snapshot* create(size_t cardinality, size_t stride, ad_interp interp, size_t page_capacity, const ad_allocator* allocator);
+	static void destroy(ad_curve_snapshot* snapshot);
+
+	void retain() const;
+	void release() const;
+
+	bool evaluate(float time, float* out_value) const;
+	bool evaluate_many(const float* in_times, size_t n, float* out_values) const;
+	bool evaluate_at(int32_t page_i, int32_t key_i, float time, float* out_value) const;
+	int32_t find_page(float at_time) const;
+};
+
+// An alternative to ad_curve for very large curves, storing keys in a table of fixed-size
+// pages rather than in two contiguous buffers: an insert or remove only shifts keys
+// within one page (plus page pointers when a page splits or empties), and growth only
+// ever allocates one page at a time, never copying the whole curve. Snapshots share our
+// pages, and the pages we edit afterward are copied first, so they're cheap to take.
+struct ad_paged_curve
+{
+	size_t cardinality;
+	size_t stride;
+	ad_interp interp;
+	const ad_allocator* allocator;
+	ad_curve_snapshot* table; // Our latest version: if it's been shared, edits fork it first
+
+	ad_paged_curve(size_t in_cardinality, ad_interp in_interp = ad_interp::constant, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_paged_curve();
+
+	size_t num_keys() const { return table->num_keys; }
+
+	bool init();
+	bool assign(const ad_curve& source);
+	bool set(float time, const float* value, const float* tangent = nullptr);
+	bool remove_at(float time);
+
+	bool evaluate(float time, float* out_value) const;
+	bool evaluate_many(const float* in_times, size_t n, float* out_values) const;
+
+	// Returns our current version, retained, which later edits will leave unchanged
+	const ad_curve_snapshot* snapshot() const;
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdlib>
+#include <cinttypes>
+#include <atomic>
+
+#include "ad_allocator.h"
+#include "ad_curve.h"
+
+// Native builds (and emscripten builds with pthreads enabled, which require
+// SharedArrayBuffer) run tasks on worker threads; otherwise, every task runs serially on
+// the calling thread
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define AD_THREADS 0
+#else
+#define AD_THREADS 1
+#endif
+
+#define AD_CACHE_LINE_SIZE 64
+
+typedef void (*ad_task_fn)(void* user, size_t task_i);
+
+// Each participating thread starts out owning a contiguous range of task indices, packed
+// into one atomic (begin in the high 32 bits, end in the low 32 bits): the owner takes
+// tasks from the front, and threads that run out steal half of what's left from the back
+struct alignas(AD_CACHE_LINE_SIZE) ad_task_range
+{
+	std::atomic<uint64_t> range;
+};
+
+// A fixed set of worker threads that run batches of tasks alongside the calling thread,
+// with work stealing to balance uneven tasks. Only one thread should call run at a time.
+struct ad_thread_pool
+{
+	size_t num_workers; // Number of threads we spawn: the calling thread also runs tasks
+	const ad_allocator* allocator;
+	struct ad_thread_pool_state* state; // Threads and synchronization, allocated by init
+
+	ad_thread_pool(size_t in_num_workers, const ad_allocator* in_allocator = ad_default_allocator());
+	~ad_thread_pool();
+
+	bool init();
+	void run(ad_task_fn fn, void* user, size_t num_tasks);
+};
+
+// Returns a sensible number of workers for this machine: one fewer than the number of
+// hardware threads, since the calling thread works too
+size_t ad_default_num_workers();
+
+struct ad_eval_job
+{
+	const ad_curve* curve;
+	float time;
+	float* out_value;
+};
+
+// Evaluates every job, spread across a thread pool (or serially if pool is null). Jobs are
+// split into batches of roughly batch_size, with each boundary moved forward until the
+// jobs on either side write to different cache lines, so that threads never share output
+// lines as long as outputs are laid out in job order. Search indexes are built up front
+// for any curve that would otherwise build one lazily mid-batch. Returns false if any job
+// failed to evaluate.
+bool ad_evaluate_jobs(ad_thread_pool* pool, const ad_eval_job* jobs, size_t num_jobs, size_t batch_size = 64);
@@ -0,0 +1,287 @@
+#include "ad_allocator.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+
+// Every block we hand out is aligned for SIMD loads and stores
+static const size_t block_alignment = 16;
+
+static size_t align_up(size_t size)
+{
+	return (size + block_alignment - 1) & ~(block_alignment - 1);
+}
+
+static void* default_allocate(void* /*user*/, size_t size)
+{
+	return malloc(size);
+}
+
+static void* default_reallocate(void* /*user*/, void* ptr, size_t /*old_size*/, size_t new_size)
+{
+	return realloc(ptr, new_size);
+}
+
+static void default_deallocate(void* /*user*/, void* ptr, size_t /*size*/)
+{
+	free(ptr);
+}
+
+const ad_allocator* ad_default_allocator()
+{
+	static const ad_allocator allocator = { default_allocate, default_reallocate, default_deallocate, nullptr };
+	return &allocator;
+}
+
+static void* arena_allocate(void* user, size_t size)
+{
+	return reinterpret_cast<ad_arena*>(user)->allocate(size);
+}
+
+static void* arena_reallocate(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	return reinterpret_cast<ad_arena*>(user)->reallocate(ptr, old_size, new_size);
+}
+
+static void arena_deallocate(void* user, void* ptr, size_t size)
+{
+	reinterpret_cast<ad_arena*>(user)->deallocate(ptr, size);
+}
+
+ad_arena::ad_arena()
+	: capacity(0)
+	, used(0)
+	, last_offset(0)
+	, data(nullptr)
+	, allocator{ arena_allocate, arena_reallocate, arena_deallocate, this }
+{
+}
+
+ad_arena::~ad_arena()
+{
+	free(data);
+}
+
+bool ad_arena::init(size_t in_capacity)
+{
+	assert(in_capacity > 0);
+	assert(!data);
+
+	capacity = in_capacity;
+	data = reinterpret_cast<uint8_t*>(aligned_alloc(block_alignment, align_up(capacity)));
+	return data != nullptr;
+}
+
+void* ad_arena::allocate(size_t size)
+{
+	const size_t offset = align_up(used);
+	if (offset + size > capacity)
+	{
+		return nullptr;
+	}
+	last_offset = offset;
+	used = offset + size;
+	return data + offset;
+}
+
+void* ad_arena::reallocate(void* ptr, size_t old_size, size_t new_size)
+{
+	if (!ptr)
+	{
+		return allocate(new_size);
+	}
+
+	// If this is our most recent allocation, we can simply move the end of it
+	uint8_t* block = reinterpret_cast<uint8_t*>(ptr);
+	if (block == data + last_offset)
+	{
+		if (last_offset + new_size > capacity)
+		{
+			return nullptr;
+		}
+		used = last_offset + new_size;
+		return ptr;
+	}
+
+	// Otherwise, we need a new block: the old one is lost until the arena is reset
+	void* new_block = allocate(new_size);
+	if (new_block)
+	{
+		memcpy(new_block, ptr, old_size < new_size ? old_size : new_size);
+	}
+	return new_block;
+}
+
+void ad_arena::deallocate(void* ptr, size_t /*size*/)
+{
+	// Blocks are normally only released all at once, when the arena is reset: but if
+	// this was our most recent allocation, we can give its space back right away
+	if (ptr && reinterpret_cast<uint8_t*>(ptr) == data + last_offset)
+	{
+		used = last_offset;
+	}
+}
+
+void ad_arena::reset()
+{
+	used = 0;
+	last_offset = 0;
+}
+
+static void* pool_allocate(void* user, size_t size)
+{
+	return reinterpret_cast<ad_pool*>(user)->allocate(size);
+}
+
+static void* pool_reallocate(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	return reinterpret_cast<ad_pool*>(user)->reallocate(ptr, old_size, new_size);
+}
+
+static void pool_deallocate(void* user, void* ptr, size_t size)
+{
+	reinterpret_cast<ad_pool*>(user)->deallocate(ptr, size);
+}
+
+// Each slab starts with a header linking it to the next, followed by its blocks
+struct ad_pool_slab
+{
+	ad_pool_slab* next;
+	size_t size;
+};
+
+static const size_t slab_header_size = align_up(sizeof(ad_pool_slab));
+
+// Returns the index of the smallest size class that can hold a block of the given size,
+// or AD_POOL_NUM_CLASSES if the block is too large for any class
+static size_t pool_class_index(const ad_pool& pool, size_t size)
+{
+	size_t class_i = 0;
+	size_t block_size = pool.min_block_size;
+	while (class_i < AD_POOL_NUM_CLASSES && block_size < size)
+	{
+		class_i++;
+		block_size += block_size;
+	}
+	return class_i;
+}
+
+ad_pool::ad_pool(size_t in_min_block_size, size_t in_slab_size, const ad_allocator* in_backing)
+	: min_block_size(align_up(in_min_block_size))
+	, slab_size(in_slab_size)
+	, backing(in_backing)
+	, free_lists()
+	, slabs(nullptr)
+	, allocator{ pool_allocate, pool_reallocate, pool_deallocate, this }
+{
+	assert(min_block_size >= sizeof(void*));
+	assert(backing);
+}
+
+ad_pool::~ad_pool()
+{
+	reset();
+}
+
+void* ad_pool::allocate(size_t size)
+{
+	const size_t class_i = pool_class_index(*this, size);
+	if (class_i == AD_POOL_NUM_CLASSES)
+	{
+		return backing->allocate(size);
+	}
+
+	// If we have no free blocks of this size, carve a new slab up into blocks
+	if (!free_lists[class_i])
+	{
+		const size_t block_size = min_block_size << class_i;
+		const size_t num_blocks = slab_size > slab_header_size + block_size ? (slab_size - slab_header_size) / block_size : 1;
+		const size_t new_slab_size = slab_header_size + num_blocks * block_size;
+		ad_pool_slab* slab = reinterpret_cast<ad_pool_slab*>(backing->allocate(new_slab_size));
+		if (!slab)
+		{
+			return nullptr;
+		}
+		slab->next = reinterpret_cast<ad_pool_slab*>(slabs);
+		slab->size = new_slab_size;
+		slabs = slab;
+
+		uint8_t* block = reinterpret_cast<uint8_t*>(slab) + slab_header_size;
+		for (size_t i = 0; i < num_blocks; i++)
+		{
+			*reinterpret_cast<void**>(block) = free_lists[class_i];
+			free_lists[class_i] = block;
+			block += block_size;
+		}
+	}
+
+	// Pop a block off the front of the free list
+	void* block = free_lists[class_i];
+	free_lists[class_i] = *reinterpret_cast<void**>(block);
+	return block;
+}
+
+void* ad_pool::reallocate(void* ptr, size_t old_size, size_t new_size)
+{
+	if (!ptr)
+	{
+		return allocate(new_size);
+	}
+
+	// Blocks that stay within the same size class don't need to move
+	const size_t old_class_i = pool_class_index(*this, old_size);
+	const size_t new_class_i = pool_class_index(*this, new_size);
+	if (old_class_i == new_class_i)
+	{
+		if (old_class_i < AD_POOL_NUM_CLASSES)
+		{
+			return ptr;
+		}
+		return backing->reallocate(ptr, old_size, new_size);
+	}
+
+	void* new_block = allocate(new_size);
+	if (new_block)
+	{
+		memcpy(new_block, ptr, old_size < new_size ? old_size : new_size);
+		deallocate(ptr, old_size);
+	}
+	return new_block;
+}
+
+void ad_pool::deallocate(void* ptr, size_t size)
+{
+	if (!ptr)
+	{
+		return;
+	}
+
+	const size_t class_i = pool_class_index(*this, size);
+	if (class_i == AD_POOL_NUM_CLASSES)
+	{
+		backing->deallocate(ptr, size);
+		return;
+	}
+
+	// Push the block onto the front of its free list
+	*reinterpret_cast<void**>(ptr) = free_lists[class_i];
+	free_lists[class_i] = ptr;
+}
+
+void ad_pool::reset()
+{
+	// Return every slab to the backing allocator: any block larger than our largest size
+	// class should already have been deallocated
+	ad_pool_slab* slab = reinterpret_cast<ad_pool_slab*>(slabs);
+	while (slab)
+	{
+		ad_pool_slab* next = slab->next;
+		backing->deallocate(slab, slab->size);
+		slab = next;
+	}
+	slabs = nullptr;
+	for (size_t i = 0; i < AD_POOL_NUM_CLASSES; i++)
+	{
+		free_lists[i] = nullptr;
+	}
+}
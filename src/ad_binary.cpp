@@ -0,0 +1,44 @@
+#include "ad_binary.h"
+
+#include <cassert>
+
+// Blobs are written and read in native byte order, so we only support little-endian
+// targets, which covers x64, arm64 and wasm
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "binary format requires a little-endian target");
+#endif
+
+static_assert(sizeof(ad_binary_header) == AD_BINARY_ALIGNMENT, "header must preserve alignment");
+static_assert(sizeof(ad_binary_curve_header) == AD_BINARY_ALIGNMENT, "curve header must preserve alignment");
+static_assert(sizeof(ad_binary_clip_header) == AD_BINARY_ALIGNMENT, "clip header must preserve alignment");
+static_assert(sizeof(ad_binary_clip_channel) == 8, "clip channels must be tightly packed");
+
+void ad_binary_write_header(void* out, ad_binary_kind kind, size_t size)
+{
+	assert(size == ad_binary_align(size));
+	assert(size <= UINT32_MAX);
+
+	ad_binary_header* header = reinterpret_cast<ad_binary_header*>(out);
+	header->magic = AD_BINARY_MAGIC;
+	header->version = AD_BINARY_VERSION;
+	header->kind = static_cast<uint32_t>(kind);
+	header->size = static_cast<uint32_t>(size);
+}
+
+const ad_binary_header* ad_binary_check(const void* data, size_t size, ad_binary_kind kind)
+{
+	// Every section is read in place, so the blob itself must be aligned
+	if (!data || reinterpret_cast<uintptr_t>(data) % AD_BINARY_ALIGNMENT != 0 || size < sizeof(ad_binary_header))
+	{
+		return nullptr;
+	}
+
+	// The blob must be of the expected kind, and fit within the data we were given
+	const ad_binary_header* header = reinterpret_cast<const ad_binary_header*>(data);
+	const bool is_valid = header->magic == AD_BINARY_MAGIC
+		&& header->version == AD_BINARY_VERSION
+		&& header->kind == static_cast<uint32_t>(kind)
+		&& header->size <= size
+		&& header->size == ad_binary_align(header->size);
+	return is_valid ? header : nullptr;
+}
@@ -0,0 +1,259 @@
+#include "ad_blend.h"
+
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX__)
+#	include <immintrin.h>
+#	define AD_BLEND_AVX 1
+#	define AD_BLEND_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#	include <emmintrin.h>
+#	define AD_BLEND_SSE 1
+#elif defined(__wasm_simd128__)
+#	include <wasm_simd128.h>
+#	define AD_BLEND_WASM 1
+#endif
+
+void ad_blend_linear_scalar(const float* a, const float* b, float alpha, size_t n, float* out)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = a[i] + (b[i] - a[i]) * alpha;
+	}
+}
+
+void ad_blend_cubic_scalar(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out)
+{
+	for (size_t i = 0; i < n; i++)
+	{
+		out[i] = weights[0] * p0[i] + weights[1] * m0[i] + weights[2] * p1[i] + weights[3] * m1[i];
+	}
+}
+
+void ad_blend_quat(const float* a, const float* b, float alpha, bool spherical, float* out)
+{
+	// q and -q represent the same rotation: flip b if needed to take the shorter path
+	float dot = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+	const float sign = dot < 0.0f ? -1.0f : 1.0f;
+	dot *= sign;
+
+	// Slerp blends by angle, but it's numerically unstable (and indistinguishable from
+	// nlerp) when the two rotations are nearly identical
+	float weight_a = 1.0f - alpha;
+	float weight_b = alpha;
+	if (spherical && dot < 0.9995f)
+	{
+		const float theta = acosf(dot);
+		const float inv_sin_theta = 1.0f / sinf(theta);
+		weight_a = sinf(weight_a * theta) * inv_sin_theta;
+		weight_b = sinf(weight_b * theta) * inv_sin_theta;
+	}
+	weight_b *= sign;
+
+	float length_sq = 0.0f;
+	for (size_t i = 0; i < 4; i++)
+	{
+		out[i] = a[i] * weight_a + b[i] * weight_b;
+		length_sq += out[i] * out[i];
+	}
+
+	// Renormalize the result, which nlerp needs and which keeps slerp free of drift
+	if (length_sq > 0.0f)
+	{
+		const float inv_length = 1.0f / sqrtf(length_sq);
+		for (size_t i = 0; i < 4; i++)
+		{
+			out[i] *= inv_length;
+		}
+	}
+}
+
+#if AD_BLEND_SSE
+
+// Loads and stores a pair of floats as one 64-bit lane: through memcpy, since float
+// arrays are only guaranteed 4-byte alignment
+static inline __m128 load_pair(const float* p)
+{
+	double pair;
+	memcpy(&pair, p, sizeof(pair));
+	return _mm_castpd_ps(_mm_set_sd(pair));
+}
+
+static inline void store_pair(float* p, __m128 v)
+{
+	const double pair = _mm_cvtsd_f64(_mm_castps_pd(v));
+	memcpy(p, &pair, sizeof(pair));
+}
+
+// Loads and stores 1 to 3 floats, so that short runs like vec3 values can still be
+// processed in a single register without touching memory past the end of the run
+static inline __m128 load_partial(const float* p, size_t n)
+{
+	switch (n)
+	{
+	case 1:
+		return _mm_load_ss(p);
+	case 2:
+		return load_pair(p);
+	default:
+		return _mm_movelh_ps(load_pair(p), _mm_load_ss(p + 2));
+	}
+}
+
+static inline void store_partial(float* p, __m128 v, size_t n)
+{
+	switch (n)
+	{
+	case 1:
+		_mm_store_ss(p, v);
+		break;
+	case 2:
+		store_pair(p, v);
+		break;
+	default:
+		store_pair(p, v);
+		_mm_store_ss(p + 2, _mm_movehl_ps(v, v));
+		break;
+	}
+}
+
+void ad_blend_linear(const float* a, const float* b, float alpha, size_t n, float* out)
+{
+	// Scalar and vec2 runs don't gain enough from a vector register to pay for a
+	// partial load and store
+	if (n < 3)
+	{
+		ad_blend_linear_scalar(a, b, alpha, n, out);
+		return;
+	}
+
+	size_t i = 0;
+#if AD_BLEND_AVX
+	const __m256 alpha8 = _mm256_set1_ps(alpha);
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m256 a8 = _mm256_loadu_ps(a + i);
+		const __m256 b8 = _mm256_loadu_ps(b + i);
+		_mm256_storeu_ps(out + i, _mm256_add_ps(a8, _mm256_mul_ps(_mm256_sub_ps(b8, a8), alpha8)));
+	}
+#endif
+	const __m128 alpha4 = _mm_set1_ps(alpha);
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m128 a4 = _mm_loadu_ps(a + i);
+		const __m128 b4 = _mm_loadu_ps(b + i);
+		_mm_storeu_ps(out + i, _mm_add_ps(a4, _mm_mul_ps(_mm_sub_ps(b4, a4), alpha4)));
+	}
+	if (i < n)
+	{
+		const size_t remaining = n - i;
+		const __m128 a4 = load_partial(a + i, remaining);
+		const __m128 b4 = load_partial(b + i, remaining);
+		store_partial(out + i, _mm_add_ps(a4, _mm_mul_ps(_mm_sub_ps(b4, a4), alpha4)), remaining);
+	}
+}
+
+void ad_blend_cubic(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out)
+{
+	if (n < 3)
+	{
+		ad_blend_cubic_scalar(p0, m0, p1, m1, weights, n, out);
+		return;
+	}
+
+	size_t i = 0;
+#if AD_BLEND_AVX
+	const __m256 w0_8 = _mm256_set1_ps(weights[0]);
+	const __m256 w1_8 = _mm256_set1_ps(weights[1]);
+	const __m256 w2_8 = _mm256_set1_ps(weights[2]);
+	const __m256 w3_8 = _mm256_set1_ps(weights[3]);
+	for (; i + 8 <= n; i += 8)
+	{
+		const __m256 lhs = _mm256_add_ps(_mm256_mul_ps(w0_8, _mm256_loadu_ps(p0 + i)), _mm256_mul_ps(w1_8, _mm256_loadu_ps(m0 + i)));
+		const __m256 rhs = _mm256_add_ps(_mm256_mul_ps(w2_8, _mm256_loadu_ps(p1 + i)), _mm256_mul_ps(w3_8, _mm256_loadu_ps(m1 + i)));
+		_mm256_storeu_ps(out + i, _mm256_add_ps(lhs, rhs));
+	}
+#endif
+	const __m128 w0 = _mm_set1_ps(weights[0]);
+	const __m128 w1 = _mm_set1_ps(weights[1]);
+	const __m128 w2 = _mm_set1_ps(weights[2]);
+	const __m128 w3 = _mm_set1_ps(weights[3]);
+	for (; i + 4 <= n; i += 4)
+	{
+		const __m128 lhs = _mm_add_ps(_mm_mul_ps(w0, _mm_loadu_ps(p0 + i)), _mm_mul_ps(w1, _mm_loadu_ps(m0 + i)));
+		const __m128 rhs = _mm_add_ps(_mm_mul_ps(w2, _mm_loadu_ps(p1 + i)), _mm_mul_ps(w3, _mm_loadu_ps(m1 + i)));
+		_mm_storeu_ps(out + i, _mm_add_ps(lhs, rhs));
+	}
+	if (i < n)
+	{
+		const size_t remaining = n - i;
+		const __m128 lhs = _mm_add_ps(_mm_mul_ps(w0, load_partial(p0 + i, remaining)), _mm_mul_ps(w1, load_partial(m0 + i, remaining)));
+		const __m128 rhs = _mm_add_ps(_mm_mul_ps(w2, load_partial(p1 + i, remaining)), _mm_mul_ps(w3, load_partial(m1 + i, remaining)));
+		store_partial(out + i, _mm_add_ps(lhs, rhs), remaining);
+	}
+}
+
+const char* ad_blend_isa()
+{
+#if AD_BLEND_AVX
+	return "avx";
+#else
+	return "sse2";
+#endif
+}
+
+#elif AD_BLEND_WASM
+
+void ad_blend_linear(const float* a, const float* b, float alpha, size_t n, float* out)
+{
+	size_t i = 0;
+	const v128_t alpha4 = wasm_f32x4_splat(alpha);
+	for (; i + 4 <= n; i += 4)
+	{
+		const v128_t a4 = wasm_v128_load(a + i);
+		const v128_t b4 = wasm_v128_load(b + i);
+		wasm_v128_store(out + i, wasm_f32x4_add(a4, wasm_f32x4_mul(wasm_f32x4_sub(b4, a4), alpha4)));
+	}
+	ad_blend_linear_scalar(a + i, b + i, alpha, n - i, out + i);
+}
+
+void ad_blend_cubic(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out)
+{
+	size_t i = 0;
+	const v128_t w0 = wasm_f32x4_splat(weights[0]);
+	const v128_t w1 = wasm_f32x4_splat(weights[1]);
+	const v128_t w2 = wasm_f32x4_splat(weights[2]);
+	const v128_t w3 = wasm_f32x4_splat(weights[3]);
+	for (; i + 4 <= n; i += 4)
+	{
+		const v128_t lhs = wasm_f32x4_add(wasm_f32x4_mul(w0, wasm_v128_load(p0 + i)), wasm_f32x4_mul(w1, wasm_v128_load(m0 + i)));
+		const v128_t rhs = wasm_f32x4_add(wasm_f32x4_mul(w2, wasm_v128_load(p1 + i)), wasm_f32x4_mul(w3, wasm_v128_load(m1 + i)));
+		wasm_v128_store(out + i, wasm_f32x4_add(lhs, rhs));
+	}
+	ad_blend_cubic_scalar(p0 + i, m0 + i, p1 + i, m1 + i, weights, n - i, out + i);
+}
+
+const char* ad_blend_isa()
+{
+	return "simd128";
+}
+
+#else
+
+void ad_blend_linear(const float* a, const float* b, float alpha, size_t n, float* out)
+{
+	ad_blend_linear_scalar(a, b, alpha, n, out);
+}
+
+void ad_blend_cubic(const float* p0, const float* m0, const float* p1, const float* m1, const float* weights, size_t n, float* out)
+{
+	ad_blend_cubic_scalar(p0, m0, p1, m1, weights, n, out);
+}
+
+const char* ad_blend_isa()
+{
+	return "scalar";
+}
+
+#endif
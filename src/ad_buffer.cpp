@@ -5,65 +5,154 @@
 #include <cstring>
 #include <cassert>
 
-ad_buffer::ad_buffer()
+#include "ad_instrument.h"
+
+template <typename T>
+ad_buffer_t<T>::ad_buffer_t(const ad_allocator* in_allocator)
 	: capacity(0)
 	, size(0)
 	, data(nullptr)
+	, growth_factor(2.0f)
+	, reserve_ahead(0)
+	, allocator(in_allocator)
+	, borrowed(false)
 {
+	assert(allocator);
 }
 
-ad_buffer::~ad_buffer()
+template <typename T>
+ad_buffer_t<T>::~ad_buffer_t()
 {
-	free(data);
+	if (data && !borrowed)
+	{
+		allocator->deallocate(data, capacity * sizeof(T));
+	}
 }
 
-bool ad_buffer::init(size_t initial_capacity)
+template <typename T>
+bool ad_buffer_t<T>::init(size_t initial_capacity)
 {
 	assert(initial_capacity > 0);
 
 	capacity = initial_capacity;
-	data = reinterpret_cast<float*>(malloc(capacity * sizeof(float)));
+	data = reinterpret_cast<T*>(allocator->allocate(capacity * sizeof(T)));
 	return data != nullptr;
 }
 
-float* ad_buffer::resize_for_edit(size_t i, int32_t delta_size)
+template <typename T>
+void ad_buffer_t<T>::init_borrowed(const T* in_data, size_t in_size)
+{
+	// We should not yet be initialized: from here on, we can only be read from
+	assert(!data);
+
+	capacity = in_size;
+	size = in_size;
+	data = const_cast<T*>(in_data);
+	borrowed = true;
+}
+
+template <typename T>
+bool ad_buffer_t<T>::reserve(size_t min_capacity)
+{
+	assert(!borrowed);
+	if (min_capacity <= capacity)
+	{
+		return true;
+	}
+
+	// Reallocate in place if possible: our contents are preserved either way
+	T* new_data = reinterpret_cast<T*>(allocator->reallocate(data, capacity * sizeof(T), min_capacity * sizeof(T)));
+	if (new_data == nullptr)
+	{
+		return false;
+	}
+	data = new_data;
+	capacity = min_capacity;
+	return true;
+}
+
+template <typename T>
+bool ad_buffer_t<T>::shrink_to_fit()
 {
-	// We should've called init before attempting to make edits
+	// We always keep room for at least one element, since a zero-size reallocation may free
+	const size_t new_capacity = size > 0 ? size : 1;
+	if (!data || new_capacity >= capacity)
+	{
+		return true;
+	}
+
+	T* new_data = reinterpret_cast<T*>(allocator->reallocate(data, capacity * sizeof(T), new_capacity * sizeof(T)));
+	if (new_data == nullptr)
+	{
+		return false;
+	}
+	data = new_data;
+	capacity = new_capacity;
+	return true;
+}
+
+template <typename T>
+T* ad_buffer_t<T>::resize_for_edit(size_t i, int32_t delta_size)
+{
+	// We should've called init before attempting to make edits, and we can't edit data
+	// that we've only borrowed
 	assert(data && capacity > 0);
+	assert(!borrowed);
 
 	// Input arguments must fit within the bounds of the existing data
 	assert(i <= size);
 	assert(delta_size != 0);
-	assert(size + delta_size >= 0);
+	assert(delta_size > 0 || static_cast<size_t>(-static_cast<int64_t>(delta_size)) <= size - i);
 
 	// If this is a cut, chop out the desired length after the edit point
 	if (delta_size < 0)
 	{
 		// Just shift the tail left to the edit point and reduce size
-		float* tail_start = data + i - delta_size;
-		float* tail_end = data + size;
-		const size_t num_tail_bytes = (tail_end - tail_start) * sizeof(float);
+		T* tail_start = data + i - delta_size;
+		T* tail_end = data + size;
+		const size_t num_tail_bytes = (tail_end - tail_start) * sizeof(T);
 		memmove(data + i, tail_start, num_tail_bytes);
+		AD_COUNT(bytes_moved, num_tail_bytes);
 		size += delta_size;
 		return data + i;
 	}
 
 	// Otherwise, we want to insert new space in the middle, shifting the tail right
-	float* head_start = data;
-	float* head_end = data + i;
-	float* tail_start = head_end;
-	float* tail_end = data + size;
-	const size_t num_head_bytes = (head_end - head_start) * sizeof(float);
-	const size_t num_tail_bytes = (tail_end - tail_start) * sizeof(float);
+	T* head_start = data;
+	T* head_end = data + i;
+	T* tail_start = head_end;
+	T* tail_end = data + size;
+	const size_t num_head_bytes = (head_end - head_start) * sizeof(T);
+	const size_t num_tail_bytes = (tail_end - tail_start) * sizeof(T);
 
 	// If we've exceeded our capacity, allocate a new buffer, copy to it, and free
-	size += delta_size;
-	if (size > capacity)
+	const size_t new_size = size + delta_size;
+	if (new_size > capacity)
 	{
-		// Increase capacity and allocate a new buffer
-		capacity += capacity;
-		const size_t capacity_bytes = capacity * sizeof(float);
-		float* new_data = reinterpret_cast<float*>(malloc(capacity_bytes));
+		// Grow by our growth factor, but always by enough to fit the edit
+		size_t new_capacity = static_cast<size_t>(capacity * growth_factor);
+		if (new_capacity < new_size + reserve_ahead)
+		{
+			new_capacity = new_size + reserve_ahead;
+		}
+
+		// If we're appending at the end, there's no tail to shift, so reallocating can
+		// extend the buffer in place or move it with a single copy (which we can't see,
+		// so it doesn't count toward bytes_moved)
+		if (i == size)
+		{
+			if (!reserve(new_capacity))
+			{
+				return nullptr;
+			}
+			AD_COUNT(reallocations, 1);
+			size = new_size;
+			return data + i;
+		}
+
+		// Otherwise, allocate a new buffer so that each element only gets copied once
+		const size_t capacity_bytes = new_capacity * sizeof(T);
+		T* new_data = reinterpret_cast<T*>(allocator->allocate(capacity_bytes));
 		if (new_data == nullptr)
 		{
 			return nullptr;
@@ -72,14 +161,26 @@ float* ad_buffer::resize_for_edit(size_t i, int32_t delta_size)
 		// Copy both the head and the tail (shifted right) to the new buffer
 		memcpy(new_data, head_start, num_head_bytes);
 		memcpy(new_data + (tail_start - data) + delta_size, tail_start, num_tail_bytes);
+		AD_COUNT(reallocations, 1);
+		AD_COUNT(bytes_moved, num_head_bytes + num_tail_bytes);
 
 		// Free the old buffer and return the location of the edit point in our new buffer
-		free(data);
+		allocator->deallocate(data, capacity * sizeof(T));
 		data = new_data;
+		capacity = new_capacity;
+		size = new_size;
 		return data + i;
 	}
 
 	// We can fit the new data without reallocating, so just shift the tail rightward
 	memmove(data + i + delta_size, tail_start, num_tail_bytes);
+	AD_COUNT(bytes_moved, num_tail_bytes);
+	size = new_size;
 	return data + i;
 }
+
+// Explicitly instantiate the element types we support: floats for key values and times,
+// and doubles or integer ticks for the times of long recordings
+template struct ad_buffer_t<float>;
+template struct ad_buffer_t<double>;
+template struct ad_buffer_t<int64_t>;
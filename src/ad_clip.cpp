@@ -0,0 +1,311 @@
+#include "ad_clip.h"
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "ad_blend.h"
+#include "ad_binary.h"
+
+ad_clip::ad_clip(size_t in_num_channels, const ad_allocator* in_allocator)
+	: num_channels(in_num_channels)
+	, stride(0)
+	, num_keys(0)
+	, channels(nullptr)
+	, allocator(in_allocator)
+	, times(in_allocator)
+	, values(in_allocator)
+{
+	assert(num_channels > 0);
+}
+
+ad_clip::~ad_clip()
+{
+	if (channels)
+	{
+		allocator->deallocate(channels, num_channels * sizeof(ad_clip_channel));
+	}
+}
+
+bool ad_clip::init(const size_t* cardinalities, const ad_interp* interps, size_t initial_capacity)
+{
+	// We should be properly constructed and not yet initialized
+	assert(!channels);
+	assert(initial_capacity > 0);
+
+	channels = reinterpret_cast<ad_clip_channel*>(allocator->allocate(num_channels * sizeof(ad_clip_channel)));
+	if (!channels)
+	{
+		return false;
+	}
+
+	// Lay out each channel's value one after the other within each pose: if no modes are
+	// given, every channel is evaluated with constant interpolation
+	stride = 0;
+	for (size_t i = 0; i < num_channels; i++)
+	{
+		channels[i].cardinality = cardinalities[i];
+		channels[i].offset = stride;
+		channels[i].interp = interps ? interps[i] : ad_interp::constant;
+		assert(channels[i].cardinality > 0);
+		assert(channels[i].interp != ad_interp::hermite);
+		assert(channels[i].cardinality == 4 || (channels[i].interp != ad_interp::nlerp && channels[i].interp != ad_interp::slerp));
+		stride += channels[i].cardinality;
+	}
+
+	return times.init(initial_capacity) && values.init(initial_capacity * stride);
+}
+
+bool ad_clip::init_borrowed(const void* data, size_t size)
+{
+	// We should be properly constructed and not yet initialized
+	assert(!channels);
+
+	// The blob must hold a clip with as many channels as we were constructed with
+	const ad_binary_header* header = ad_binary_check(data, size, ad_binary_kind::clip);
+	if (!header || header->size < sizeof(ad_binary_header) + sizeof(ad_binary_clip_header))
+	{
+		return false;
+	}
+	const ad_binary_clip_header* clip_header = reinterpret_cast<const ad_binary_clip_header*>(header + 1);
+	const size_t channels_offset = sizeof(ad_binary_header) + sizeof(ad_binary_clip_header);
+	const size_t times_offset = channels_offset + ad_binary_align(num_channels * sizeof(ad_binary_clip_channel));
+	if (clip_header->num_channels != num_channels || times_offset > header->size)
+	{
+		return false;
+	}
+
+	// Our channel descriptions are small, so we copy them rather than borrowing them
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	const ad_binary_clip_channel* in_channels = reinterpret_cast<const ad_binary_clip_channel*>(bytes + channels_offset);
+	size_t in_stride = 0;
+	for (size_t i = 0; i < num_channels; i++)
+	{
+		// Cardinalities are untrusted, so no channel (and no sum of them) can hold more
+		// floats than fit in the blob
+		const ad_interp channel_interp = static_cast<ad_interp>(in_channels[i].interp);
+		const bool is_valid = in_channels[i].cardinality > 0
+			&& in_channels[i].cardinality <= header->size / sizeof(float) - in_stride
+			&& in_channels[i].interp <= static_cast<uint8_t>(ad_interp::slerp)
+			&& channel_interp != ad_interp::hermite
+			&& (in_channels[i].cardinality == 4 || (channel_interp != ad_interp::nlerp && channel_interp != ad_interp::slerp));
+		if (!is_valid)
+		{
+			return false;
+		}
+		in_stride += in_channels[i].cardinality;
+	}
+
+	// The times and values sections must fit within the blob: as with the curve, we bound
+	// num_keys by the blob's size, then compute offsets in 64 bits
+	const size_t n = clip_header->num_keys;
+	if (n > header->size / sizeof(float) / in_stride)
+	{
+		return false;
+	}
+	const uint64_t values_offset = times_offset + ad_binary_align(n * sizeof(float));
+	if (values_offset + static_cast<uint64_t>(n) * in_stride * sizeof(float) > header->size)
+	{
+		return false;
+	}
+
+	channels = reinterpret_cast<ad_clip_channel*>(allocator->allocate(num_channels * sizeof(ad_clip_channel)));
+	if (!channels)
+	{
+		return false;
+	}
+	stride = 0;
+	for (size_t i = 0; i < num_channels; i++)
+	{
+		channels[i].cardinality = in_channels[i].cardinality;
+		channels[i].offset = stride;
+		channels[i].interp = static_cast<ad_interp>(in_channels[i].interp);
+		stride += channels[i].cardinality;
+	}
+
+	// Point our buffers straight at the blob's times and poses
+	times.init_borrowed(reinterpret_cast<const float*>(bytes + times_offset), n);
+	values.init_borrowed(reinterpret_cast<const float*>(bytes + values_offset), n * stride);
+	num_keys = n;
+	return true;
+}
+
+bool ad_clip::reserve(size_t num_keys_to_fit)
+{
+	// We need to know our stride before we can reserve space for poses
+	assert(channels);
+	if (is_borrowed())
+	{
+		return false;
+	}
+	return times.reserve(num_keys_to_fit) && values.reserve(num_keys_to_fit * stride);
+}
+
+bool ad_clip::set(float time, const float* pose)
+{
+	// Borrowed keys live in the caller's read-only blob, so they can't be edited
+	if (is_borrowed())
+	{
+		return false;
+	}
+
+	const int32_t i = find_nearest_lte(time);
+	const bool is_exact = i >= 0 ? times.data[i] == time : false;
+	if (is_exact)
+	{
+		memcpy(values.data + i * stride, pose, sizeof(float) * stride);
+		return true;
+	}
+
+	const int32_t times_i = i + 1;
+	float* time_ptr = times.resize_for_edit(times_i, 1);
+	if (!time_ptr)
+	{
+		return false;
+	}
+	float* pose_ptr = values.resize_for_edit(times_i * stride, stride);
+	if (!pose_ptr)
+	{
+		times.resize_for_edit(times_i, -1);
+		return false;
+	}
+	*time_ptr = time;
+	memcpy(pose_ptr, pose, sizeof(float) * stride);
+	num_keys++;
+	return true;
+}
+
+bool ad_clip::remove_at(float time)
+{
+	if (is_borrowed())
+	{
+		return false;
+	}
+	const int32_t i = find_nearest_lte(time);
+	const bool is_exact = i >= 0 ? times.data[i] == time : false;
+	if (is_exact)
+	{
+		times.resize_for_edit(i, -1);
+		values.resize_for_edit(i * stride, -static_cast<int32_t>(stride));
+		num_keys--;
+	}
+	return true;
+}
+
+bool ad_clip::evaluate(float time, float* out_pose) const
+{
+	return evaluate_at(find_nearest_lte(time), time, out_pose);
+}
+
+bool ad_clip::evaluate_at(int32_t times_i, float time, float* out_pose) const
+{
+	// An empty clip has no pose at any time
+	if (values.size == 0)
+	{
+		return false;
+	}
+
+	// Before the first key or at/after the last key, hold the nearest pose
+	const int32_t last_i = static_cast<int32_t>(times.size) - 1;
+	if (times_i < 0 || times_i >= last_i)
+	{
+		const int32_t values_i = (times_i >= 0 ? times_i : 0) * stride;
+		memcpy(out_pose, values.data + values_i, sizeof(float) * stride);
+		return true;
+	}
+
+	// Otherwise, make a single pass over the two adjacent poses, blending each channel
+	// according to its mode
+	const float time_a = times.data[times_i];
+	const float time_b = times.data[times_i + 1];
+	const float alpha = (time - time_a) / (time_b - time_a);
+	const float* pose_a = values.data + times_i * stride;
+	const float* pose_b = pose_a + stride;
+	size_t channel_i = 0;
+	while (channel_i < num_channels)
+	{
+		// Quaternion channels are blended one at a time
+		const ad_clip_channel& channel = channels[channel_i];
+		const size_t offset = channel.offset;
+		if (channel.interp == ad_interp::nlerp || channel.interp == ad_interp::slerp)
+		{
+			ad_blend_quat(pose_a + offset, pose_b + offset, alpha, channel.interp == ad_interp::slerp, out_pose + offset);
+			channel_i++;
+			continue;
+		}
+
+		// Adjacent channels that share a constant or linear mode can be treated as one run
+		// of floats, so e.g. a rig whose channels are all linear is blended in one call
+		size_t run_length = 0;
+		while (channel_i < num_channels && channels[channel_i].interp == channel.interp)
+		{
+			run_length += channels[channel_i].cardinality;
+			channel_i++;
+		}
+		if (channel.interp == ad_interp::linear)
+		{
+			ad_blend_linear(pose_a + offset, pose_b + offset, alpha, run_length, out_pose + offset);
+		}
+		else
+		{
+			memcpy(out_pose + offset, pose_a + offset, sizeof(float) * run_length);
+		}
+	}
+	return true;
+}
+
+int32_t ad_clip::find_nearest_lte(float at_time) const
+{
+	return ad_find_nearest_lte(times.data, times.size, at_time);
+}
+
+int32_t ad_clip::find_nearest_lte_from(float at_time, int32_t hint) const
+{
+	return ad_find_nearest_lte_from(times.data, times.size, at_time, hint);
+}
+
+size_t ad_clip::binary_size() const
+{
+	return sizeof(ad_binary_header)
+		+ sizeof(ad_binary_clip_header)
+		+ ad_binary_align(num_channels * sizeof(ad_binary_clip_channel))
+		+ ad_binary_align(num_keys * sizeof(float))
+		+ ad_binary_align(num_keys * stride * sizeof(float));
+}
+
+size_t ad_clip::write_binary(void* out, size_t out_size) const
+{
+	// We need to be initialized to know our channel layout
+	assert(channels);
+	const size_t size = binary_size();
+	// Every count and size in the blob is 32-bit, so larger clips can't be written
+	if (size > out_size || size > UINT32_MAX || num_keys > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	// Zero the whole blob first, so that padding is deterministic
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(out);
+	memset(bytes, 0, size);
+	ad_binary_write_header(bytes, ad_binary_kind::clip, size);
+	ad_binary_clip_header* clip_header = reinterpret_cast<ad_binary_clip_header*>(bytes + sizeof(ad_binary_header));
+	clip_header->num_channels = static_cast<uint32_t>(num_channels);
+	clip_header->num_keys = static_cast<uint32_t>(num_keys);
+
+	const size_t channels_offset = sizeof(ad_binary_header) + sizeof(ad_binary_clip_header);
+	ad_binary_clip_channel* out_channels = reinterpret_cast<ad_binary_clip_channel*>(bytes + channels_offset);
+	for (size_t i = 0; i < num_channels; i++)
+	{
+		out_channels[i].cardinality = static_cast<uint32_t>(channels[i].cardinality);
+		out_channels[i].interp = static_cast<uint8_t>(channels[i].interp);
+	}
+
+	const size_t times_offset = channels_offset + ad_binary_align(num_channels * sizeof(ad_binary_clip_channel));
+	const size_t values_offset = times_offset + ad_binary_align(num_keys * sizeof(float));
+	if (num_keys > 0)
+	{
+		memcpy(bytes + times_offset, times.data, num_keys * sizeof(float));
+		memcpy(bytes + values_offset, values.data, num_keys * stride * sizeof(float));
+	}
+	return size;
+}
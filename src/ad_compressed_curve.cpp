@@ -0,0 +1,374 @@
+#include "ad_compressed_curve.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#include "ad_blend.h"
+#include "ad_instrument.h"
+
+// Smallest-three components always lie within +/- 1/sqrt(2)
+static const float k_smallest_three_limit = 0.70710678f;
+
+// Key times within this fraction of a frame of the grid are snapped onto it
+static const float k_frame_epsilon = 1e-3f;
+
+static bool is_quaternion(ad_interp interp)
+{
+	return interp == ad_interp::nlerp || interp == ad_interp::slerp;
+}
+
+static uint64_t encode_smallest_three(const float* q, uint32_t component_bits)
+{
+	// Find the largest component, and flip the quaternion so that it's positive: q and -q
+	// represent the same rotation, so the largest component can be rebuilt from the rest
+	size_t largest = 0;
+	for (size_t c = 1; c < 4; c++)
+	{
+		largest = fabsf(q[c]) > fabsf(q[largest]) ? c : largest;
+	}
+	const float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+
+	// Pack the index of the dropped component above the three remaining components
+	const uint64_t max_q = (1ull << component_bits) - 1;
+	uint64_t packed = static_cast<uint64_t>(largest);
+	for (size_t c = 0; c < 4; c++)
+	{
+		if (c != largest)
+		{
+			float normalized = (q[c] * sign + k_smallest_three_limit) / (2.0f * k_smallest_three_limit);
+			normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+			packed = (packed << component_bits) | static_cast<uint64_t>(lrintf(normalized * max_q));
+		}
+	}
+	return packed;
+}
+
+static void decode_smallest_three(uint64_t packed, uint32_t component_bits, float* out)
+{
+	// Unpack the three stored components, last first, then rebuild the dropped one
+	const uint64_t max_q = (1ull << component_bits) - 1;
+	const float step = 2.0f * k_smallest_three_limit / max_q;
+	const size_t largest = static_cast<size_t>(packed >> (component_bits * 3));
+	float sum_sq = 0.0f;
+	for (size_t c = 4; c-- > 0;)
+	{
+		if (c != largest)
+		{
+			out[c] = static_cast<float>(packed & max_q) * step - k_smallest_three_limit;
+			sum_sq += out[c] * out[c];
+			packed >>= component_bits;
+		}
+	}
+	out[largest] = sqrtf(sum_sq < 1.0f ? 1.0f - sum_sq : 0.0f);
+}
+
+ad_compressed_curve::ad_compressed_curve(float in_frame_rate, ad_quantize in_precision, const ad_allocator* in_allocator)
+	: cardinality(0)
+	, interp(ad_interp::constant)
+	, frame_rate(in_frame_rate)
+	, precision(in_precision)
+	, num_keys(0)
+	, frame_bytes(0)
+	, key_bytes(0)
+	, allocator(in_allocator)
+	, data_size(0)
+	, data(nullptr)
+	, mins(nullptr)
+	, scales(nullptr)
+	, frames(nullptr)
+	, values(nullptr)
+{
+	assert(frame_rate > 0.0f);
+}
+
+ad_compressed_curve::~ad_compressed_curve()
+{
+	if (data)
+	{
+		allocator->deallocate(data, data_size);
+	}
+}
+
+bool ad_compressed_curve::init(const ad_curve& source)
+{
+	AD_TRACE_SCOPE("ad_compressed_curve::init");
+	// We should not yet be initialized, and we can only compress curves without tangents
+	assert(!data);
+	if (source.interp == ad_interp::hermite || source.num_keys == 0)
+	{
+		return false;
+	}
+
+	// Every key must lie on our frame grid, with distinct frames
+	uint32_t max_frame = 0;
+	for (size_t i = 0; i < source.num_keys; i++)
+	{
+		const float frame = source.key_time(i) * frame_rate;
+		const float rounded = roundf(frame);
+		if (rounded < 0.0f || rounded >= 4294967296.0f || fabsf(frame - rounded) > k_frame_epsilon)
+		{
+			return false;
+		}
+		const uint32_t frame_i = static_cast<uint32_t>(rounded);
+		if (i > 0 && frame_i <= max_frame)
+		{
+			return false;
+		}
+		max_frame = frame_i;
+	}
+
+	// Work out how much space each part of our data needs, keeping each part aligned
+	const bool is_quat = is_quaternion(source.interp);
+	const size_t component_bytes = precision == ad_quantize::bits8 ? 1 : 2;
+	const size_t ranges_size = is_quat ? 0 : source.cardinality * 2 * sizeof(float);
+	const size_t new_frame_bytes = max_frame <= UINT16_MAX ? 2 : 4;
+	const size_t frames_size = (source.num_keys * new_frame_bytes + 7) & ~static_cast<size_t>(7);
+	const size_t new_key_bytes = is_quat ? component_bytes * 4 : component_bytes * source.cardinality;
+	const size_t new_data_size = ranges_size + frames_size + source.num_keys * new_key_bytes;
+
+	data = reinterpret_cast<uint8_t*>(allocator->allocate(new_data_size));
+	if (!data)
+	{
+		return false;
+	}
+	data_size = new_data_size;
+	cardinality = source.cardinality;
+	interp = source.interp;
+	num_keys = source.num_keys;
+	frame_bytes = new_frame_bytes;
+	key_bytes = new_key_bytes;
+	mins = is_quat ? nullptr : reinterpret_cast<const float*>(data);
+	scales = is_quat ? nullptr : mins + cardinality;
+	frames = data + ranges_size;
+	values = frames + frames_size;
+
+	// Store each key's frame index
+	uint8_t* out_frames = data + ranges_size;
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		const uint32_t frame_i = static_cast<uint32_t>(roundf(source.key_time(i) * frame_rate));
+		if (frame_bytes == 2)
+		{
+			reinterpret_cast<uint16_t*>(out_frames)[i] = static_cast<uint16_t>(frame_i);
+		}
+		else
+		{
+			reinterpret_cast<uint32_t*>(out_frames)[i] = frame_i;
+		}
+	}
+
+	uint8_t* out_values = data + ranges_size + frames_size;
+	if (is_quat)
+	{
+		// Pack each quaternion into 32 bits (10 bits per component) or 64 bits (20 bits)
+		for (size_t i = 0; i < num_keys; i++)
+		{
+			const float* q = source.values.data + i * source.stride;
+			if (precision == ad_quantize::bits8)
+			{
+				reinterpret_cast<uint32_t*>(out_values)[i] = static_cast<uint32_t>(encode_smallest_three(q, 10));
+			}
+			else
+			{
+				reinterpret_cast<uint64_t*>(out_values)[i] = encode_smallest_three(q, 20);
+			}
+		}
+		return true;
+	}
+
+	// Find the range of each component across every key
+	float* out_mins = reinterpret_cast<float*>(data);
+	float* out_scales = out_mins + cardinality;
+	const float max_q = precision == ad_quantize::bits8 ? 255.0f : 65535.0f;
+	for (size_t c = 0; c < cardinality; c++)
+	{
+		float lo = source.values.data[c];
+		float hi = lo;
+		for (size_t i = 1; i < num_keys; i++)
+		{
+			const float v = source.values.data[i * source.stride + c];
+			lo = v < lo ? v : lo;
+			hi = v > hi ? v : hi;
+		}
+		out_mins[c] = lo;
+		out_scales[c] = (hi - lo) / max_q;
+	}
+
+	// Quantize each component to the nearest step within its range
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		const float* v = source.values.data + i * source.stride;
+		for (size_t c = 0; c < cardinality; c++)
+		{
+			const float q = out_scales[c] > 0.0f ? (v[c] - out_mins[c]) / out_scales[c] : 0.0f;
+			const long rounded = lrintf(q < max_q ? q : max_q);
+			if (precision == ad_quantize::bits8)
+			{
+				out_values[i * cardinality + c] = static_cast<uint8_t>(rounded);
+			}
+			else
+			{
+				reinterpret_cast<uint16_t*>(out_values)[i * cardinality + c] = static_cast<uint16_t>(rounded);
+			}
+		}
+	}
+	return true;
+}
+
+uint32_t ad_compressed_curve::frame_at(size_t i) const
+{
+	return frame_bytes == 2 ? reinterpret_cast<const uint16_t*>(frames)[i] : reinterpret_cast<const uint32_t*>(frames)[i];
+}
+
+void ad_compressed_curve::decode(size_t i, float* out_value) const
+{
+	if (is_quaternion(interp))
+	{
+		if (precision == ad_quantize::bits8)
+		{
+			decode_smallest_three(reinterpret_cast<const uint32_t*>(values)[i], 10, out_value);
+		}
+		else
+		{
+			decode_smallest_three(reinterpret_cast<const uint64_t*>(values)[i], 20, out_value);
+		}
+		return;
+	}
+
+	for (size_t c = 0; c < cardinality; c++)
+	{
+		const float q = precision == ad_quantize::bits8
+			? static_cast<float>(values[i * cardinality + c])
+			: static_cast<float>(reinterpret_cast<const uint16_t*>(values)[i * cardinality + c]);
+		out_value[c] = mins[c] + q * scales[c];
+	}
+}
+
+template <typename TFrame>
+static int32_t find_frame_lte(const TFrame* frames, size_t num_frames, uint32_t frame)
+{
+	// Binary search for the number of frames <= the search frame, comparing integers
+	size_t lo = 0;
+	size_t len = num_frames;
+	while (len > 0)
+	{
+		const size_t half = len / 2;
+		if (frames[lo + half] <= frame)
+		{
+			lo += half + 1;
+			len -= half + 1;
+		}
+		else
+		{
+			len = half;
+		}
+	}
+	return static_cast<int32_t>(lo) - 1;
+}
+
+// Converts a frame to the whole frame at or before it, returning false if it's before
+// the first frame (or NaN). Frames past the last key all find that key, so we clamp to
+// its frame, which also keeps the conversion in range.
+static bool whole_frame_lte(float frame, uint32_t last_frame, uint32_t& out_frame)
+{
+	if (!(frame >= 0.0f))
+	{
+		return false;
+	}
+	out_frame = frame >= static_cast<float>(last_frame) ? last_frame : static_cast<uint32_t>(frame);
+	return true;
+}
+
+template <typename TFrame, typename TQ>
+static void evaluate_quantized(const ad_compressed_curve& curve, float frame, float* out_value)
+{
+	// Find the last key at or before this frame, holding the nearest key's value if we're
+	// before the first key or at/after the last key
+	const TFrame* frames = reinterpret_cast<const TFrame*>(curve.frames);
+	const TQ* values = reinterpret_cast<const TQ*>(curve.values);
+	const size_t n = curve.cardinality;
+	const int32_t last_i = static_cast<int32_t>(curve.num_keys) - 1;
+	uint32_t whole_frame;
+	const int32_t i = whole_frame_lte(frame, frames[last_i], whole_frame) ? find_frame_lte(frames, curve.num_keys, whole_frame) : -1;
+	if (i < 0 || i >= last_i || curve.interp == ad_interp::constant)
+	{
+		const TQ* q = values + (i >= 0 ? i : 0) * n;
+		for (size_t c = 0; c < n; c++)
+		{
+			out_value[c] = curve.mins[c] + static_cast<float>(q[c]) * curve.scales[c];
+		}
+		return;
+	}
+
+	// Decode and blend each component in a single pass
+	const float alpha = (frame - frames[i]) / static_cast<float>(frames[i + 1] - frames[i]);
+	const TQ* qa = values + i * n;
+	const TQ* qb = qa + n;
+	for (size_t c = 0; c < n; c++)
+	{
+		const float a = static_cast<float>(qa[c]);
+		const float b = static_cast<float>(qb[c]);
+		out_value[c] = curve.mins[c] + (a + (b - a) * alpha) * curve.scales[c];
+	}
+}
+
+int32_t ad_compressed_curve::find_nearest_lte(float frame) const
+{
+	uint32_t whole_frame;
+	if (num_keys == 0 || !whole_frame_lte(frame, frame_at(num_keys - 1), whole_frame))
+	{
+		return -1;
+	}
+	return frame_bytes == 2
+		? find_frame_lte(reinterpret_cast<const uint16_t*>(frames), num_keys, whole_frame)
+		: find_frame_lte(reinterpret_cast<const uint32_t*>(frames), num_keys, whole_frame);
+}
+
+bool ad_compressed_curve::evaluate(float time, float* out_value) const
+{
+	// An uninitialized curve has no value at any time
+	if (num_keys == 0)
+	{
+		return false;
+	}
+
+	// Work in frames, snapping onto the grid so that evaluating at a key's own time
+	// always finds that key
+	float frame = time * frame_rate;
+	const float rounded = roundf(frame);
+	frame = fabsf(frame - rounded) <= k_frame_epsilon ? rounded : frame;
+
+	// Quantized values are decoded by a kernel specialized for our storage sizes
+	if (!is_quaternion(interp))
+	{
+		const bool is_8bit = precision == ad_quantize::bits8;
+		if (frame_bytes == 2)
+		{
+			is_8bit ? evaluate_quantized<uint16_t, uint8_t>(*this, frame, out_value) : evaluate_quantized<uint16_t, uint16_t>(*this, frame, out_value);
+		}
+		else
+		{
+			is_8bit ? evaluate_quantized<uint32_t, uint8_t>(*this, frame, out_value) : evaluate_quantized<uint32_t, uint16_t>(*this, frame, out_value);
+		}
+		return true;
+	}
+
+	// Quaternions are decoded whole, then blended as usual
+	const int32_t i = find_nearest_lte(frame);
+	const int32_t last_i = static_cast<int32_t>(num_keys) - 1;
+	if (i < 0 || i >= last_i || interp == ad_interp::constant)
+	{
+		decode(i >= 0 ? i : 0, out_value);
+		return true;
+	}
+	const float frame_a = static_cast<float>(frame_at(i));
+	const float frame_b = static_cast<float>(frame_at(i + 1));
+	const float alpha = (frame - frame_a) / (frame_b - frame_a);
+	float a[4];
+	float b[4];
+	decode(i, a);
+	decode(i + 1, b);
+	ad_blend_quat(a, b, alpha, interp == ad_interp::slerp, out_value);
+	return true;
+}
@@ -2,88 +2,832 @@
 
 #include <cstdio>
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 
-ad_curve::ad_curve(size_t in_cardinality)
+#include "ad_blend.h"
+#include "ad_binary.h"
+#include "ad_curve_journal.h"
+#include "ad_instrument.h"
+
+static void write_key(float* dst, const float* value, const float* tangent, size_t cardinality, size_t stride)
+{
+	// Each key stores its value, followed by its tangent if the curve has room for one
+	memcpy(dst, value, sizeof(float) * cardinality);
+	if (stride > cardinality)
+	{
+		if (tangent)
+		{
+			memcpy(dst + cardinality, tangent, sizeof(float) * cardinality);
+		}
+		else
+		{
+			memset(dst + cardinality, 0, sizeof(float) * cardinality);
+		}
+	}
+}
+
+static void blend_hermite(const float* a, const float* b, float alpha, float duration, size_t n, float* out)
+{
+	// Each key's tangents are stored in units per second, following its n values: scale
+	// them to the duration of the segment so the basis functions can work in [0, 1]
+	const float alpha2 = alpha * alpha;
+	const float alpha3 = alpha2 * alpha;
+	const float weights[4] = {
+		2.0f * alpha3 - 3.0f * alpha2 + 1.0f,
+		(alpha3 - 2.0f * alpha2 + alpha) * duration,
+		-2.0f * alpha3 + 3.0f * alpha2,
+		(alpha3 - alpha2) * duration,
+	};
+	ad_blend_cubic(a, a + n, b, b + n, weights, n, out);
+}
+
+// Every edit passes the keys it changes through here: inserted keys once they've been
+// written, and removed or modified keys before they're changed
+static void note_edit(ad_curve& curve, ad_journal_op op, size_t key_i, size_t n)
+{
+	if (curve.journal)
+	{
+		curve.journal->record(op, key_i, n);
+	}
+	curve.mark_dirty_keys(key_i, n);
+}
+
+ad_curve::ad_curve(size_t in_cardinality, ad_interp in_interp, const ad_allocator* in_allocator)
 	: cardinality(in_cardinality)
+	, stride(in_interp == ad_interp::hermite ? in_cardinality * 2 : in_cardinality)
 	, num_keys(0)
-	, times()
-	, values()
+	, interp(in_interp)
+	, uniform(false)
+	, start_time(0.0f)
+	, time_step(0.0f)
+	, times(in_allocator)
+	, values(in_allocator)
+	, search_index_threshold(1 << 16)
+	, search_index(in_allocator)
+	, search_index_valid(false)
+	, search_index_building(false)
+	, journal(nullptr)
+	, num_dirty_ranges(0)
+	, dirty_hook(nullptr)
+	, dirty_hook_user(nullptr)
 {
 	assert(cardinality > 0);
+	assert(cardinality == 4 || (interp != ad_interp::nlerp && interp != ad_interp::slerp));
+}
+
+ad_curve::~ad_curve()
+{
+	if (journal)
+	{
+		journal->detach();
+	}
 }
 
 bool ad_curve::init(size_t initial_capacity)
 {
 	assert(initial_capacity > 0);
-	return times.init(initial_capacity) && values.init(initial_capacity * cardinality);
+	return times.init(initial_capacity) && values.init(initial_capacity * stride);
+}
+
+bool ad_curve::init_uniform(float in_start_time, float in_time_step, size_t initial_capacity)
+{
+	// Keys will be appended one step apart, with no times to store
+	assert(initial_capacity > 0);
+	assert(in_time_step > 0.0f);
+	uniform = true;
+	start_time = in_start_time;
+	time_step = in_time_step;
+	return values.init(initial_capacity * stride);
+}
+
+bool ad_curve::init_borrowed(const void* data, size_t size)
+{
+	// The blob must hold a curve with the cardinality and interpolation mode we were
+	// constructed with
+	const ad_binary_header* header = ad_binary_check(data, size, ad_binary_kind::curve);
+	if (!header || header->size < sizeof(ad_binary_header) + sizeof(ad_binary_curve_header))
+	{
+		return false;
+	}
+	const ad_binary_curve_header* curve_header = reinterpret_cast<const ad_binary_curve_header*>(header + 1);
+	if (curve_header->cardinality != cardinality || curve_header->interp != static_cast<uint8_t>(interp))
+	{
+		return false;
+	}
+
+	// Each section must fit within the blob: num_keys is untrusted, so we bound it by the
+	// blob's size first, then compute offsets in 64 bits, where they can't wrap around
+	const size_t n = curve_header->num_keys;
+	if (n > header->size / sizeof(float) / stride)
+	{
+		return false;
+	}
+	const uint64_t times_offset = sizeof(ad_binary_header) + sizeof(ad_binary_curve_header);
+	const uint64_t values_offset = times_offset + ad_binary_align(n * sizeof(float));
+	if (values_offset + static_cast<uint64_t>(n) * stride * sizeof(float) > header->size)
+	{
+		return false;
+	}
+
+	// Point our buffers straight at the blob's times and values
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+	times.init_borrowed(reinterpret_cast<const float*>(bytes + times_offset), n);
+	values.init_borrowed(reinterpret_cast<const float*>(bytes + values_offset), n * stride);
+	num_keys = n;
+	return true;
+}
+
+bool ad_curve::reserve(size_t num_keys_to_fit)
+{
+	if (is_borrowed())
+	{
+		return false;
+	}
+
+	// Reserve space up front to avoid repeated reallocations when adding many keys
+	return (uniform || times.reserve(num_keys_to_fit)) && values.reserve(num_keys_to_fit * stride);
+}
+
+bool ad_curve::make_uniform(float tolerance)
+{
+	AD_TRACE_SCOPE("ad_curve::make_uniform");
+	// We need at least two keys to know our spacing, and each key must be within
+	// tolerance (relative to the step) of where a uniform curve would put it
+	if (uniform)
+	{
+		return true;
+	}
+	if (num_keys < 2 || is_borrowed())
+	{
+		return false;
+	}
+	const float first_time = times.data[0];
+	const float step = (times.data[num_keys - 1] - first_time) / static_cast<float>(num_keys - 1);
+	for (size_t i = 1; i < num_keys - 1; i++)
+	{
+		if (fabsf(times.data[i] - (first_time + static_cast<float>(i) * step)) > tolerance * step)
+		{
+			return false;
+		}
+	}
+
+	// Our times are implied from here on, so we can release them along with our index:
+	// each key may move by up to the tolerance, so the whole curve is dirty
+	invalidate_search_index();
+	mark_dirty_keys(0, num_keys);
+	uniform = true;
+	start_time = first_time;
+	time_step = step;
+	times.allocator->deallocate(times.data, times.capacity * sizeof(float));
+	times.data = nullptr;
+	times.capacity = 0;
+	times.size = 0;
+	return true;
+}
+
+bool ad_curve::make_explicit()
+{
+	if (!uniform)
+	{
+		return true;
+	}
+
+	// Store every key's time, with room for as many keys as our values have room for
+	const size_t capacity = values.capacity / stride;
+	if (!times.reserve(capacity > 0 ? capacity : 1))
+	{
+		return false;
+	}
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		times.data[i] = key_time(i);
+	}
+	times.size = num_keys;
+	uniform = false;
+	invalidate_search_index();
+	return true;
+}
+
+static bool is_search_index_current(const ad_curve& curve)
+{
+	// The index must have been built since our last edit: once it's been published, no
+	// thread writes to it until the next edit, so it's safe to read
+	if (!curve.search_index_valid.load(std::memory_order_acquire))
+	{
+		return false;
+	}
+	assert(curve.search_index.size == (curve.times.size + AD_SEARCH_INDEX_STRIDE - 1) / AD_SEARCH_INDEX_STRIDE);
+	return true;
+}
+
+static int32_t find_lte_for_edit(const ad_curve& curve, float at_time)
+{
+	// Single-key edits use our search index if it's current, but never build it, since
+	// appending keys one at a time would otherwise rebuild it after every key
+	if (curve.uniform || is_search_index_current(curve))
+	{
+		return curve.find_nearest_lte(at_time);
+	}
+	return ad_find_nearest_lte(curve.times.data, curve.times.size, at_time);
 }
 
-void ad_curve::set(float time, float* value)
+bool ad_curve::set(float time, const float* value, const float* tangent)
 {
-	const int32_t i = find_nearest_lte(time);
-	const bool is_exact = i >= 0 ? times.data[i] == time : false;
+	// Borrowed keys live in the caller's read-only blob, so they can't be edited
+	if (is_borrowed())
+	{
+		return false;
+	}
+	const int32_t i = find_lte_for_edit(*this, time);
+	const bool is_exact = i >= 0 ? key_time(i) == time : false;
 	if (is_exact)
 	{
-		const int32_t values_i = i * cardinality;
-		memcpy(values.data + values_i, value, sizeof(float) * cardinality);
+		note_edit(*this, ad_journal_op::modify, i, 1);
+		const int32_t values_i = i * stride;
+		write_key(values.data + values_i, value, tangent, cardinality, stride);
+		return true;
 	}
-	else
+	if (uniform && i + 1 == static_cast<int32_t>(num_keys) && time == key_time(num_keys))
 	{
-		const int32_t times_i = i + 1;
-		const int32_t values_i = times_i * cardinality;
-		float* time_ptr = times.resize_for_edit(times_i, 1);
-		float* value_ptr = values.resize_for_edit(values_i, cardinality);
-		*time_ptr = time;
-		memcpy(value_ptr, value, sizeof(float) * cardinality);
+		// A key one step past the end of a uniform curve keeps it uniform
+		float* value_ptr = values.resize_for_edit(num_keys * stride, stride);
+		if (!value_ptr)
+		{
+			return false;
+		}
+		write_key(value_ptr, value, tangent, cardinality, stride);
 		num_keys++;
+		note_edit(*this, ad_journal_op::insert, num_keys - 1, 1);
+		return true;
+	}
+	if (!make_explicit())
+	{
+		return false;
+	}
+
+	invalidate_search_index();
+	const int32_t times_i = i + 1;
+	const int32_t values_i = times_i * stride;
+	float* time_ptr = times.resize_for_edit(times_i, 1);
+	if (!time_ptr)
+	{
+		return false;
+	}
+	float* value_ptr = values.resize_for_edit(values_i, stride);
+	if (!value_ptr)
+	{
+		times.resize_for_edit(times_i, -1);
+		return false;
 	}
+	*time_ptr = time;
+	write_key(value_ptr, value, tangent, cardinality, stride);
+	num_keys++;
+	note_edit(*this, ad_journal_op::insert, times_i, 1);
+	return true;
 }
 
-void ad_curve::remove_at(float time)
+bool ad_curve::set_many(const float* in_times, const float* in_values, size_t n, ad_merge_policy policy)
 {
-	const int32_t i = find_nearest_lte(time);
-	const bool is_exact = i >= 0 ? times.data[i] == time : false;
-	if (is_exact)
+	AD_TRACE_SCOPE("ad_curve::set_many");
+	if (is_borrowed())
+	{
+		return false;
+	}
+	if (!make_explicit())
 	{
-		times.resize_for_edit(i, -1);
-		values.resize_for_edit(i, -1);
-		num_keys--;
+		return false;
 	}
+	invalidate_search_index();
+
+	// Batches are usually already in time order, in which case we can read them as-is
+	bool is_sorted = true;
+	for (size_t j = 1; j < n && is_sorted; j++)
+	{
+		is_sorted = in_times[j - 1] < in_times[j];
+	}
+
+	// Otherwise, build a list of indices into the batch in time order: if the batch has
+	// several keys at the same time, only the one that'd win out (the last with replace,
+	// or the first with keep) should remain in the list
+	size_t* order = nullptr;
+	size_t num_incoming = n;
+	if (!is_sorted)
+	{
+		order = reinterpret_cast<size_t*>(malloc(n * sizeof(size_t)));
+		if (!order)
+		{
+			return false;
+		}
+		for (size_t j = 0; j < n; j++)
+		{
+			order[j] = j;
+		}
+		std::stable_sort(order, order + n, [in_times](size_t lhs, size_t rhs) { return in_times[lhs] < in_times[rhs]; });
+
+		num_incoming = 0;
+		for (size_t j = 0; j < n; j++)
+		{
+			const bool is_duplicate = num_incoming > 0 && in_times[order[num_incoming - 1]] == in_times[order[j]];
+			if (!is_duplicate)
+			{
+				order[num_incoming++] = order[j];
+			}
+			else if (policy == ad_merge_policy::replace)
+			{
+				order[num_incoming - 1] = order[j];
+			}
+		}
+	}
+
+	// Walk both sorted lists once to find out how many incoming keys are new
+	const size_t num_existing = times.size;
+	size_t num_new = 0;
+	size_t existing_j = 0;
+	for (size_t incoming_j = 0; incoming_j < num_incoming; incoming_j++)
+	{
+		const float time = in_times[order ? order[incoming_j] : incoming_j];
+		while (existing_j < num_existing && times.data[existing_j] < time)
+		{
+			existing_j++;
+		}
+		if (existing_j == num_existing || times.data[existing_j] != time)
+		{
+			num_new++;
+		}
+	}
+
+	// Incoming keys can only disturb existing keys within the span of their times: we
+	// journal that span as being removed, then as inserted again once we've merged
+	const size_t changed_begin = num_incoming > 0 ? std::lower_bound(times.data, times.data + num_existing, in_times[order ? order[0] : 0]) - times.data : 0;
+	const size_t changed_end = num_incoming > 0 ? std::upper_bound(times.data, times.data + num_existing, in_times[order ? order[num_incoming - 1] : num_incoming - 1]) - times.data : 0;
+
+	// Make room for the new keys at the end of our buffers, all at once
+	if (num_new > 0)
+	{
+		const bool resized = reserve(num_existing + num_new)
+			&& times.resize_for_edit(num_existing, static_cast<int32_t>(num_new))
+			&& values.resize_for_edit(num_existing * stride, static_cast<int32_t>(num_new * stride));
+		if (!resized)
+		{
+			free(order);
+			return false;
+		}
+	}
+	if (journal)
+	{
+		journal->begin_group();
+	}
+	note_edit(*this, ad_journal_op::remove, changed_begin, changed_end - changed_begin);
+
+	// Merge from the back, so that every key only moves once and we never overwrite an
+	// existing key that we haven't moved yet
+	const size_t value_size = sizeof(float) * stride;
+	size_t write_j = num_existing + num_new;
+	size_t remaining_existing = num_existing;
+	size_t remaining_incoming = num_incoming;
+	while (remaining_incoming > 0)
+	{
+		const size_t incoming_j = order ? order[remaining_incoming - 1] : remaining_incoming - 1;
+		const float incoming_time = in_times[incoming_j];
+		const float* incoming_value = in_values + incoming_j * stride;
+		write_j--;
+
+		if (remaining_existing > 0 && times.data[remaining_existing - 1] > incoming_time)
+		{
+			// The last existing key comes later than any remaining incoming key
+			remaining_existing--;
+			times.data[write_j] = times.data[remaining_existing];
+			memmove(values.data + write_j * stride, values.data + remaining_existing * stride, value_size);
+		}
+		else if (remaining_existing > 0 && times.data[remaining_existing - 1] == incoming_time)
+		{
+			// The incoming key collides with an existing key: one of them wins out
+			remaining_existing--;
+			remaining_incoming--;
+			times.data[write_j] = incoming_time;
+			if (policy == ad_merge_policy::replace)
+			{
+				memcpy(values.data + write_j * stride, incoming_value, value_size);
+			}
+			else
+			{
+				memmove(values.data + write_j * stride, values.data + remaining_existing * stride, value_size);
+			}
+		}
+		else
+		{
+			// The incoming key comes later than any remaining existing key
+			remaining_incoming--;
+			times.data[write_j] = incoming_time;
+			memcpy(values.data + write_j * stride, incoming_value, value_size);
+		}
+	}
+
+	// Any existing keys that remain precede all incoming keys, so they're already in place
+	assert(write_j == remaining_existing);
+	num_keys += num_new;
+	free(order);
+	note_edit(*this, ad_journal_op::insert, changed_begin, changed_end - changed_begin + num_new);
+	if (journal)
+	{
+		journal->end_group();
+	}
+	return true;
 }
 
-bool ad_curve::evaluate(float time, float* out_value) const
+bool ad_curve::remove_at(float time)
 {
-	const int32_t times_i = find_nearest_lte(time);
-	if (times_i >= 0)
+	if (is_borrowed())
+	{
+		return false;
+	}
+	const int32_t i = find_lte_for_edit(*this, time);
+	const bool is_exact = i >= 0 ? key_time(i) == time : false;
+	if (!is_exact)
+	{
+		return true;
+	}
+	if (!make_explicit())
+	{
+		return false;
+	}
+	invalidate_search_index();
+	note_edit(*this, ad_journal_op::remove, i, 1);
+	times.resize_for_edit(i, -1);
+	values.resize_for_edit(i * stride, -static_cast<int32_t>(stride));
+	num_keys--;
+	return true;
+}
+
+int32_t ad_curve::remove_range(float from_time, float to_time)
+{
+	AD_TRACE_SCOPE("ad_curve::remove_range");
+	if (is_borrowed())
+	{
+		return -1;
+	}
+
+	// Cut every key in the range out of both buffers at once
+	int32_t n = 0;
+	const int32_t i = find_inclusive_range(from_time, to_time, n);
+	if (n > 0)
+	{
+		if (!make_explicit())
+		{
+			return -1;
+		}
+		invalidate_search_index();
+		note_edit(*this, ad_journal_op::remove, i, n);
+		times.resize_for_edit(i, -n);
+		values.resize_for_edit(i * stride, -n * static_cast<int32_t>(stride));
+		num_keys -= n;
+	}
+	return n;
+}
+
+bool ad_curve::shift_range(float from_time, float to_time, float delta_time)
+{
+	return retime_range(from_time, to_time, 1.0f, 0.0f, delta_time);
+}
+
+bool ad_curve::scale_range(float from_time, float to_time, float factor, float pivot_time)
+{
+	return retime_range(from_time, to_time, factor, pivot_time, 0.0f);
+}
+
+bool ad_curve::retime_range(float from_time, float to_time, float factor, float pivot_time, float delta_time)
+{
+	AD_TRACE_SCOPE("ad_curve::retime_range");
+	if (is_borrowed())
+	{
+		return false;
+	}
+
+	// Each key in the range is moved to (time - pivot_time) * factor + pivot_time + delta_time
+	int32_t n = 0;
+	const int32_t i = find_inclusive_range(from_time, to_time, n);
+	if (n == 0 || (factor == 1.0f && delta_time == 0.0f))
+	{
+		return true;
+	}
+	if (!make_explicit())
+	{
+		return false;
+	}
+	invalidate_search_index();
+
+	// A negative factor reverses the order of the moved keys: either way, we want to
+	// visit them in their new time order
+	const int32_t first_moved = factor < 0.0f ? i + n - 1 : i;
+	const int32_t moved_step = factor < 0.0f ? -1 : 1;
+	const float new_first_time = (times.data[first_moved] - pivot_time) * factor + pivot_time + delta_time;
+	const float new_last_time = (times.data[first_moved + (n - 1) * moved_step] - pivot_time) * factor + pivot_time + delta_time;
+
+	// Only the keys between the old and new positions of the range are affected: we
+	// rebuild that window in time order in a scratch buffer, then copy it back
+	const int32_t window_begin = std::min(i, static_cast<int32_t>(std::lower_bound(times.data, times.data + times.size, new_first_time) - times.data));
+	const int32_t window_end = std::max(i + n, static_cast<int32_t>(std::upper_bound(times.data, times.data + times.size, new_last_time) - times.data));
+	const size_t window_size = window_end - window_begin;
+	float* scratch = reinterpret_cast<float*>(malloc(window_size * (1 + stride) * sizeof(float)));
+	if (!scratch)
+	{
+		return false;
+	}
+	float* scratch_times = scratch;
+	float* scratch_values = scratch + window_size;
+
+	// Hermite tangents are per second, so they need to be scaled to keep their shape
+	const float tangent_scale = factor != 0.0f ? 1.0f / factor : 1.0f;
+	const size_t value_size = sizeof(float) * stride;
+	size_t num_written = 0;
+	int32_t unmoved_j = window_begin;
+	int32_t num_moved_left = n;
+	int32_t moved_j = first_moved;
+	while (unmoved_j < window_end || num_moved_left > 0)
+	{
+		// Skip over the keys being moved when we reach them in the unmoved sequence
+		if (unmoved_j == i)
+		{
+			unmoved_j = i + n;
+			continue;
+		}
+
+		// Take whichever key comes first, favoring unmoved keys on a tie so that a moved
+		// key will replace any unmoved key it lands on
+		const bool take_moved = num_moved_left > 0 && (unmoved_j >= window_end || (times.data[moved_j] - pivot_time) * factor + pivot_time + delta_time < times.data[unmoved_j]);
+		const int32_t src_j = take_moved ? moved_j : unmoved_j;
+		const float time = take_moved ? (times.data[src_j] - pivot_time) * factor + pivot_time + delta_time : times.data[src_j];
+
+		// Any key landing at the same time as the last key we wrote replaces it
+		const size_t dst_j = (num_written > 0 && scratch_times[num_written - 1] == time) ? num_written - 1 : num_written++;
+		scratch_times[dst_j] = time;
+		memcpy(scratch_values + dst_j * stride, values.data + src_j * stride, value_size);
+		if (take_moved)
+		{
+			for (size_t k = cardinality; k < stride; k++)
+			{
+				scratch_values[dst_j * stride + k] *= tangent_scale;
+			}
+			moved_j += moved_step;
+			num_moved_left--;
+		}
+		else
+		{
+			unmoved_j++;
+		}
+	}
+
+	// Copy the rebuilt window back, closing up the gap if any keys were replaced
+	if (journal)
+	{
+		journal->begin_group();
+	}
+	note_edit(*this, ad_journal_op::remove, window_begin, window_size);
+	memcpy(times.data + window_begin, scratch_times, num_written * sizeof(float));
+	memcpy(values.data + window_begin * stride, scratch_values, num_written * value_size);
+	const int32_t num_replaced = static_cast<int32_t>(window_size - num_written);
+	if (num_replaced > 0)
+	{
+		times.resize_for_edit(window_begin + num_written, -num_replaced);
+		values.resize_for_edit((window_begin + num_written) * stride, -num_replaced * static_cast<int32_t>(stride));
+		num_keys -= num_replaced;
+	}
+	note_edit(*this, ad_journal_op::insert, window_begin, num_written);
+	if (journal)
+	{
+		journal->end_group();
+	}
+	free(scratch);
+	return true;
+}
+
+bool ad_curve::reduce(float tolerance)
+{
+	AD_TRACE_SCOPE("ad_curve::reduce");
+	if (is_borrowed())
+	{
+		return false;
+	}
+
+	// Only constant and linear curves can be reduced, since their error at each removed key
+	// bounds their error everywhere: the reduced curve stays within tolerance of every
+	// component of every original key
+	if (interp != ad_interp::constant && interp != ad_interp::linear)
+	{
+		return false;
+	}
+	if (num_keys < 3)
 	{
-		const int32_t values_i = times_i * cardinality;
-		memcpy(out_value, values.data + values_i, sizeof(float) * cardinality);
 		return true;
 	}
+	if (!make_explicit())
+	{
+		return false;
+	}
+	invalidate_search_index();
+
+	// Flag each key that we're keeping: the first and last keys always stay
+	uint8_t* keep = reinterpret_cast<uint8_t*>(calloc(num_keys, 1));
+	if (!keep)
+	{
+		return false;
+	}
+	keep[0] = 1;
+	keep[num_keys - 1] = 1;
+
+	if (interp == ad_interp::constant)
+	{
+		// A constant key can go if the previous key we kept holds a close enough value
+		size_t kept = 0;
+		for (size_t i = 1; i < num_keys - 1; i++)
+		{
+			const float* kept_value = values.data + kept * stride;
+			const float* value = values.data + i * stride;
+			for (size_t c = 0; c < cardinality && !keep[i]; c++)
+			{
+				keep[i] = fabsf(value[c] - kept_value[c]) > tolerance;
+			}
+			kept = keep[i] ? i : kept;
+		}
+	}
+	else
+	{
+		// Ramer-Douglas-Peucker: for each span between kept keys, keep the key furthest from
+		// the line across that span if it's out of tolerance, then split the span at that key
+		size_t* spans = reinterpret_cast<size_t*>(malloc(num_keys * 2 * sizeof(size_t)));
+		if (!spans)
+		{
+			free(keep);
+			return false;
+		}
+		size_t num_spans = 1;
+		spans[0] = 0;
+		spans[1] = num_keys - 1;
+		while (num_spans > 0)
+		{
+			num_spans--;
+			const size_t a = spans[num_spans * 2];
+			const size_t b = spans[num_spans * 2 + 1];
+			const float* value_a = values.data + a * stride;
+			const float* value_b = values.data + b * stride;
+			const float inv_span = 1.0f / (times.data[b] - times.data[a]);
+
+			float max_error = tolerance;
+			size_t max_i = 0;
+			for (size_t i = a + 1; i < b; i++)
+			{
+				const float alpha = (times.data[i] - times.data[a]) * inv_span;
+				const float* value = values.data + i * stride;
+				for (size_t c = 0; c < cardinality; c++)
+				{
+					const float error = fabsf(value[c] - (value_a[c] + (value_b[c] - value_a[c]) * alpha));
+					if (error > max_error)
+					{
+						max_error = error;
+						max_i = i;
+					}
+				}
+			}
+
+			// Each split adds at most one span beyond the one we just took, and every key
+			// is split on at most once, so our stack never holds more than num_keys spans
+			if (max_i > 0)
+			{
+				keep[max_i] = 1;
+				spans[num_spans * 2] = a;
+				spans[num_spans * 2 + 1] = max_i;
+				spans[num_spans * 2 + 2] = max_i;
+				spans[num_spans * 2 + 3] = b;
+				num_spans += 2;
+			}
+		}
+		free(spans);
+	}
+
+	// Every key before the first one we drop stays in place
+	size_t first_dropped = 0;
+	while (first_dropped < num_keys && keep[first_dropped])
+	{
+		first_dropped++;
+	}
+	if (journal)
+	{
+		journal->begin_group();
+	}
+	note_edit(*this, ad_journal_op::remove, first_dropped, num_keys - first_dropped);
+
+	// Compact the keys we're keeping to the front of our buffers
+	size_t num_kept = 0;
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		if (keep[i])
+		{
+			if (num_kept != i)
+			{
+				times.data[num_kept] = times.data[i];
+				memcpy(values.data + num_kept * stride, values.data + i * stride, stride * sizeof(float));
+			}
+			num_kept++;
+		}
+	}
+	free(keep);
+
+	num_keys = num_kept;
+	times.size = num_kept;
+	values.size = num_kept * stride;
+	note_edit(*this, ad_journal_op::insert, first_dropped, num_kept - first_dropped);
+	if (journal)
+	{
+		journal->end_group();
+	}
+	return true;
+}
+
+bool ad_curve::evaluate(float time, float* out_value) const
+{
+	return evaluate_at(find_nearest_lte(time), time, out_value);
+}
+
+bool ad_curve::evaluate_many(const float* in_times, size_t n, float* out_values) const
+{
+	AD_TRACE_SCOPE("ad_curve::evaluate_many");
+	// Walk a cursor through the requested times: if they're sorted, each lookup only
+	// needs to step forward from the last key we found
+	ad_curve_cursor cursor(*this);
+	for (size_t i = 0; i < n; i++)
+	{
+		if (!cursor.evaluate(in_times[i], out_values + i * cardinality))
+		{
+			return false;
+		}
+	}
+	return true;
+}
 
-	if (values.size > 0)
+bool ad_curve::evaluate_at(int32_t times_i, float time, float* out_value) const
+{
+	// An empty curve has no value at any time
+	if (values.size == 0)
 	{
-		const int32_t values_i = 0;
+		return false;
+	}
+
+	// Before the first key or at/after the last key, hold the value of the nearest key
+	const int32_t last_i = static_cast<int32_t>(uniform ? num_keys : times.size) - 1;
+	if (times_i < 0 || times_i >= last_i || interp == ad_interp::constant)
+	{
+		const int32_t values_i = (times_i >= 0 ? times_i : 0) * stride;
 		memcpy(out_value, values.data + values_i, sizeof(float) * cardinality);
 		return true;
 	}
 
-	return false;
+	// Otherwise, blend between the key at times_i and the key that follows it
+	const float* value_a = values.data + times_i * stride;
+	return ad_evaluate_segment(interp, cardinality, key_time(times_i), value_a, key_time(times_i + 1), value_a + stride, time, out_value);
 }
 
-int32_t ad_curve::find_nearest_lte(float at_time) const
+bool ad_evaluate_segment(ad_interp interp, size_t cardinality, float time_a, const float* value_a, float time_b, const float* value_b, float time, float* out_value)
+{
+	const float duration = time_b - time_a;
+	const float alpha = (time - time_a) / duration;
+	switch (interp)
+	{
+	case ad_interp::constant:
+		memcpy(out_value, value_a, sizeof(float) * cardinality);
+		break;
+	case ad_interp::linear:
+		ad_blend_linear(value_a, value_b, alpha, cardinality, out_value);
+		break;
+	case ad_interp::hermite:
+		blend_hermite(value_a, value_b, alpha, duration, cardinality, out_value);
+		break;
+	case ad_interp::nlerp:
+	case ad_interp::slerp:
+		ad_blend_quat(value_a, value_b, alpha, interp == ad_interp::slerp, out_value);
+		break;
+	default:
+		assert(false);
+		return false;
+	}
+	return true;
+}
+
+int32_t ad_find_nearest_lte(const float* times, size_t num_times, float at_time)
 {
 	// Use -1 as a sentinel if there are no keys <= the search time
 	int32_t i = -1;
 
 	// Start a binary search encompassing the entire times array
 	int32_t lo = 0;
-	int32_t hi = static_cast<int32_t>(times.size) - 1;
+	int32_t hi = static_cast<int32_t>(num_times) - 1;
+	uint32_t num_steps = 0;
 	while (lo <= hi)
 	{
 		// Examine the time value in the middle of the current search space
+		num_steps++;
 		const int32_t mid = lo + (hi - lo) / 2;
-		const float time = times.data[mid];
+		const float time = times[mid];
 		if (time <= at_time)
 		{
 			// If this time is <= the search time, update our result and keep searching to the right
@@ -96,21 +840,326 @@ int32_t ad_curve::find_nearest_lte(float at_time) const
 			hi = mid - 1;
 		}
 	}
+	AD_COUNT(search_iterations, num_steps);
+	return i;
+}
+
+int32_t ad_find_nearest_lte_from(const float* times, size_t num_times, float at_time, int32_t hint)
+{
+	// A hint that's out of range is no better than no hint at all
+	const int32_t n = static_cast<int32_t>(num_times);
+	if (hint < 0 || hint >= n)
+	{
+		return ad_find_nearest_lte(times, num_times, at_time);
+	}
+
+	// Gallop away from the hint in the direction of the search time, doubling our step
+	// each time, until we've bracketed the result: for a search time that's near the
+	// hint, this costs O(log distance) rather than O(log n)
+	int32_t lo;
+	int32_t hi;
+	uint32_t num_steps = 0;
+	if (times[hint] <= at_time)
+	{
+		// The result is at or to the right of the hint: find a key past the search time
+		lo = hint + 1;
+		hi = hint + 1;
+		int32_t step = 1;
+		while (hi < n && times[hi] <= at_time)
+		{
+			num_steps++;
+			lo = hi + 1;
+			hi += step;
+			step += step;
+		}
+		hi = (hi < n ? hi : n) - 1;
+	}
+	else
+	{
+		// The result is to the left of the hint: find a key that's <= the search time
+		lo = hint - 1;
+		hi = hint - 1;
+		int32_t step = 1;
+		while (lo >= 0 && times[lo] > at_time)
+		{
+			num_steps++;
+			hi = lo - 1;
+			lo -= step;
+			step += step;
+		}
+		lo = lo > 0 ? lo : 0;
+	}
+
+	// Finish with a binary search over the bracketed range: any key left of lo is known
+	// to be <= the search time, and any key right of hi is known to be past it
+	int32_t i = lo - 1;
+	while (lo <= hi)
+	{
+		num_steps++;
+		const int32_t mid = lo + (hi - lo) / 2;
+		if (times[mid] <= at_time)
+		{
+			i = mid;
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+	AD_COUNT(search_iterations, num_steps);
 	return i;
 }
 
+void ad_curve::mark_dirty(float from_time, float to_time)
+{
+	if (dirty_hook)
+	{
+		dirty_hook(dirty_hook_user, *this, from_time, to_time);
+	}
+
+	// Absorb every range that overlaps the new one, keeping the rest in time order
+	ad_time_range ranges[AD_MAX_DIRTY_RANGES + 1];
+	size_t n = 0;
+	ad_time_range added = { from_time, to_time };
+	bool is_added = false;
+	for (size_t j = 0; j < num_dirty_ranges; j++)
+	{
+		const ad_time_range& range = dirty_ranges[j];
+		if (range.to_time < added.from_time)
+		{
+			ranges[n++] = range;
+		}
+		else if (range.from_time > added.to_time)
+		{
+			if (!is_added)
+			{
+				ranges[n++] = added;
+				is_added = true;
+			}
+			ranges[n++] = range;
+		}
+		else
+		{
+			added.from_time = std::min(added.from_time, range.from_time);
+			added.to_time = std::max(added.to_time, range.to_time);
+		}
+	}
+	if (!is_added)
+	{
+		ranges[n++] = added;
+	}
+
+	// If that leaves one range too many, merge the two with the smallest gap between them
+	if (n > AD_MAX_DIRTY_RANGES)
+	{
+		size_t closest_j = 0;
+		for (size_t j = 1; j < n - 1; j++)
+		{
+			if (ranges[j + 1].from_time - ranges[j].to_time < ranges[closest_j + 1].from_time - ranges[closest_j].to_time)
+			{
+				closest_j = j;
+			}
+		}
+		ranges[closest_j].to_time = ranges[closest_j + 1].to_time;
+		memmove(ranges + closest_j + 1, ranges + closest_j + 2, (n - closest_j - 2) * sizeof(ad_time_range));
+		n--;
+	}
+	memcpy(dirty_ranges, ranges, n * sizeof(ad_time_range));
+	num_dirty_ranges = n;
+}
+
+void ad_curve::mark_dirty_keys(size_t key_i, size_t n)
+{
+	// Changing a run of keys changes the curve from the key before them (or from the key
+	// itself, for constant curves, which hold each value until the next key) through to
+	// the key after them: with no key on either side, the change reaches that end of time
+	if (n == 0)
+	{
+		return;
+	}
+	assert(key_i + n <= num_keys);
+	const float from_time = key_i == 0 ? -INFINITY : key_time(interp == ad_interp::constant ? key_i : key_i - 1);
+	const float to_time = key_i + n == num_keys ? INFINITY : key_time(key_i + n);
+	mark_dirty(from_time, to_time);
+}
+
+void ad_curve::note_appended(size_t key_i, size_t n)
+{
+	// Code that writes keys straight into our buffers (e.g. baking) reports them here once
+	// they're written, so that the journal and dirty ranges see them like any other insert
+	note_edit(*this, ad_journal_op::insert, key_i, n);
+}
+
+bool ad_curve::build_search_index() const
+{
+	AD_TRACE_SCOPE("ad_curve::build_search_index");
+	// Uniform curves compute indices directly, with no need for an index, and there's
+	// nothing to do if our index is already current
+	if (uniform)
+	{
+		return false;
+	}
+	if (is_search_index_current(*this))
+	{
+		return true;
+	}
+
+	// Only one thread may build the index: if another already is, we leave it to them,
+	// and our caller can search without the index in the meantime. Whoever built it last
+	// may have finished since we checked, in which case there's nothing left to do.
+	if (search_index_building.exchange(true, std::memory_order_acquire))
+	{
+		return false;
+	}
+	if (search_index_valid.load(std::memory_order_acquire))
+	{
+		search_index_building.store(false, std::memory_order_release);
+		return true;
+	}
+
+	// Store the time of the first key in each block, then publish the index
+	const size_t num_blocks = (times.size + AD_SEARCH_INDEX_STRIDE - 1) / AD_SEARCH_INDEX_STRIDE;
+	bool ok = num_blocks == 0 || search_index.reserve(num_blocks);
+	if (ok)
+	{
+		for (size_t block_i = 0; block_i < num_blocks; block_i++)
+		{
+			search_index.data[block_i] = times.data[block_i * AD_SEARCH_INDEX_STRIDE];
+		}
+		search_index.size = num_blocks;
+		search_index_valid.store(true, std::memory_order_release);
+	}
+	search_index_building.store(false, std::memory_order_release);
+	return ok;
+}
+
+static bool has_search_index(const ad_curve& curve)
+{
+	// Use an index that's been built for our current keys, or build one if we're big
+	// enough to benefit from it
+	if (curve.uniform)
+	{
+		return false;
+	}
+	if (is_search_index_current(curve))
+	{
+		return true;
+	}
+	return curve.times.size >= curve.search_index_threshold && curve.build_search_index();
+}
+
+template <bool inclusive>
+static size_t count_matching(const float* times, size_t num_times, float at_time)
+{
+	// Count the keys with a time <= at_time (or < at_time, if not inclusive) with a
+	// branchless binary search: each step halves the range with a conditional move rather
+	// than a branch, so random lookups don't pay for a mispredict at every step
+	if (num_times == 0)
+	{
+		return 0;
+	}
+	const float* base = times;
+	size_t len = num_times;
+	uint32_t num_steps = 0;
+	while (len > 1)
+	{
+		num_steps++;
+		const size_t half = len / 2;
+		const float time = base[half - 1];
+		base += (inclusive ? time <= at_time : time < at_time) ? half : 0;
+		len -= half;
+	}
+	const bool last_matches = inclusive ? *base <= at_time : *base < at_time;
+	AD_COUNT(search_iterations, num_steps);
+	return static_cast<size_t>(base - times) + (last_matches ? 1 : 0);
+}
+
+template <bool inclusive>
+static int32_t find_indexed(const ad_curve& curve, float at_time)
+{
+	// Find the last key with a time <= at_time (or < at_time, if not inclusive): first
+	// find the last block that starts with such a key, from our index
+	const size_t num_blocks = count_matching<inclusive>(curve.search_index.data, curve.search_index.size, at_time);
+	if (num_blocks == 0)
+	{
+		return -1;
+	}
+
+	// Then search within that block, whose first key is known to match
+	const size_t block_begin = (num_blocks - 1) * AD_SEARCH_INDEX_STRIDE;
+	const size_t block_size = std::min(static_cast<size_t>(AD_SEARCH_INDEX_STRIDE), curve.times.size - block_begin);
+	const size_t num_matching = count_matching<inclusive>(curve.times.data + block_begin, block_size, at_time);
+	return static_cast<int32_t>(block_begin + num_matching) - 1;
+}
+
+static int32_t find_uniform_lte(const ad_curve& curve, float at_time)
+{
+	// Compute the index directly, then nudge it so that it agrees exactly with key_time
+	const int32_t last_i = static_cast<int32_t>(curve.num_keys) - 1;
+	const float f = floorf((at_time - curve.start_time) / curve.time_step);
+	int32_t i = f < 0.0f ? -1 : (f >= static_cast<float>(last_i) ? last_i : static_cast<int32_t>(f));
+	if (i < last_i && curve.key_time(i + 1) <= at_time)
+	{
+		i++;
+	}
+	else if (i >= 0 && curve.key_time(i) > at_time)
+	{
+		i--;
+	}
+	return i;
+}
+
+int32_t ad_curve::find_nearest_lte(float at_time) const
+{
+	if (uniform)
+	{
+		return find_uniform_lte(*this, at_time);
+	}
+	if (has_search_index(*this))
+	{
+		return find_indexed<true>(*this, at_time);
+	}
+	return ad_find_nearest_lte(times.data, times.size, at_time);
+}
+
+int32_t ad_curve::find_nearest_lte_from(float at_time, int32_t hint) const
+{
+	if (uniform)
+	{
+		return find_uniform_lte(*this, at_time);
+	}
+	if ((hint < 0 || static_cast<size_t>(hint) >= times.size) && has_search_index(*this))
+	{
+		return find_indexed<true>(*this, at_time);
+	}
+	return ad_find_nearest_lte_from(times.data, times.size, at_time, hint);
+}
+
 int32_t ad_curve::find_inclusive_range(float from_time, float to_time, int32_t& out_n) const
 {
 	assert(to_time >= from_time);
+	const size_t num_times = uniform ? num_keys : times.size;
+
+	// With an index, the range runs from the key after the last key < from_time, up to
+	// the last key <= to_time: ranges are usually short, so we gallop out to that key
+	// rather than searching the index again
+	if (has_search_index(*this))
+	{
+		const int32_t i_lt_from = find_indexed<false>(*this, from_time);
+		const int32_t i_lte_to = ad_find_nearest_lte_from(times.data, times.size, to_time, i_lt_from >= 0 ? i_lt_from : 0);
+		out_n = i_lte_to > i_lt_from ? i_lte_to - i_lt_from : 0;
+		return out_n > 0 ? i_lt_from + 1 : -1;
+	}
 
 	// Run a binary search to find the rightmost key < from_time
 	int32_t i_lt_from = -1;
 	int32_t lo = 0;
-	int32_t hi = static_cast<int32_t>(times.size) - 1;
+	int32_t hi = static_cast<int32_t>(num_times) - 1;
 	while (lo <= hi)
 	{
 		const int32_t mid = lo + (hi - lo) / 2;
-		const float time = times.data[mid];
+		const float time = key_time(mid);
 		if (time < from_time)
 		{
 			i_lt_from = mid;
@@ -123,7 +1172,7 @@ int32_t ad_curve::find_inclusive_range(float from_time, float to_time, int32_t&
 	}
 
 	// If the next key is > to_time, our range sits between two keys
-	if (i_lt_from >= 0 && static_cast<size_t>(i_lt_from) + 1 < times.size && times.data[i_lt_from + 1] > to_time)
+	if (i_lt_from >= 0 && static_cast<size_t>(i_lt_from) + 1 < num_times && key_time(i_lt_from + 1) > to_time)
 	{
 		out_n = 0;
 		return -1;
@@ -132,11 +1181,11 @@ int32_t ad_curve::find_inclusive_range(float from_time, float to_time, int32_t&
 	// Run another search in the range to the right, to find the leftmost key > to_time
 	int32_t i_gt_to = -1;
 	lo = i_lt_from + 1;
-	hi = static_cast<int32_t>(times.size) - 1;
+	hi = static_cast<int32_t>(num_times) - 1;
 	while (lo <= hi)
 	{
 		const int32_t mid = lo + (hi - lo) / 2;
-		const float time = times.data[mid];
+		const float time = key_time(mid);
 		if (time <= to_time)
 		{
 			i_gt_to = mid + 1;
@@ -158,3 +1207,65 @@ int32_t ad_curve::find_inclusive_range(float from_time, float to_time, int32_t&
 	out_n = i_gt_to - i;
 	return i;
 }
+
+ad_curve_cursor::ad_curve_cursor(const ad_curve& in_curve)
+	: curve(&in_curve)
+	, index(-1)
+{
+}
+
+void ad_curve_cursor::reset()
+{
+	index = -1;
+}
+
+int32_t ad_curve_cursor::seek(float time)
+{
+	index = curve->find_nearest_lte_from(time, index);
+	return index;
+}
+
+bool ad_curve_cursor::evaluate(float time, float* out_value)
+{
+	return curve->evaluate_at(seek(time), time, out_value);
+}
+
+size_t ad_curve::binary_size() const
+{
+	return sizeof(ad_binary_header)
+		+ sizeof(ad_binary_curve_header)
+		+ ad_binary_align(num_keys * sizeof(float))
+		+ ad_binary_align(num_keys * stride * sizeof(float));
+}
+
+size_t ad_curve::write_binary(void* out, size_t out_size) const
+{
+	const size_t size = binary_size();
+	// Every count and size in the blob is 32-bit, so larger curves can't be written
+	if (size > out_size || size > UINT32_MAX || num_keys > UINT32_MAX)
+	{
+		return 0;
+	}
+
+	// Zero the whole blob first, so that padding is deterministic
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(out);
+	memset(bytes, 0, size);
+	ad_binary_write_header(bytes, ad_binary_kind::curve, size);
+	ad_binary_curve_header* curve_header = reinterpret_cast<ad_binary_curve_header*>(bytes + sizeof(ad_binary_header));
+	curve_header->cardinality = static_cast<uint32_t>(cardinality);
+	curve_header->num_keys = static_cast<uint32_t>(num_keys);
+	curve_header->interp = static_cast<uint8_t>(interp);
+
+	const size_t times_offset = sizeof(ad_binary_header) + sizeof(ad_binary_curve_header);
+	const size_t values_offset = times_offset + ad_binary_align(num_keys * sizeof(float));
+	if (num_keys > 0)
+	{
+		float* out_times = reinterpret_cast<float*>(bytes + times_offset);
+		for (size_t i = 0; i < num_keys; i++)
+		{
+			out_times[i] = key_time(i);
+		}
+		memcpy(bytes + values_offset, values.data, num_keys * stride * sizeof(float));
+	}
+	return size;
+}
@@ -0,0 +1,279 @@
+#include "ad_curve_journal.h"
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+
+#include "ad_curve.h"
+#include "ad_instrument.h"
+
+static inline const ad_journal_record* record_at(const uint8_t* data, size_t offset)
+{
+	return reinterpret_cast<const ad_journal_record*>(data + offset);
+}
+
+static inline uint32_t record_size_before(const uint8_t* data, size_t offset)
+{
+	// Each record ends with a copy of its size, so we can step back over it
+	uint32_t size;
+	memcpy(&size, data + offset - sizeof(uint32_t), sizeof(uint32_t));
+	return size;
+}
+
+static size_t record_size_for(size_t num_keys, size_t stride)
+{
+	return sizeof(ad_journal_record) + num_keys * (1 + stride) * sizeof(float) + sizeof(uint32_t);
+}
+
+ad_curve_journal::ad_curve_journal(const ad_allocator* in_allocator)
+	: capacity(0)
+	, size(0)
+	, undo_size(0)
+	, data(nullptr)
+	, next_entry(0)
+	, group_depth(0)
+	, group_entry(0)
+	, group_dropped(false)
+	, curve(nullptr)
+	, allocator(in_allocator)
+{
+	assert(allocator);
+}
+
+ad_curve_journal::~ad_curve_journal()
+{
+	detach();
+	if (data)
+	{
+		allocator->deallocate(data, capacity);
+	}
+}
+
+bool ad_curve_journal::init(size_t in_capacity)
+{
+	// We should not yet be initialized
+	assert(!data);
+	assert(in_capacity > 0);
+	data = reinterpret_cast<uint8_t*>(allocator->allocate(in_capacity));
+	capacity = data ? in_capacity : 0;
+	return data != nullptr;
+}
+
+void ad_curve_journal::attach(ad_curve& in_curve)
+{
+	// A curve records into one journal at a time, and its history starts from here
+	assert(!in_curve.journal);
+	detach();
+	curve = &in_curve;
+	curve->journal = this;
+}
+
+void ad_curve_journal::detach()
+{
+	if (curve)
+	{
+		curve->journal = nullptr;
+		curve = nullptr;
+	}
+	clear();
+}
+
+void ad_curve_journal::clear()
+{
+	size = 0;
+	undo_size = 0;
+}
+
+void ad_curve_journal::begin_group()
+{
+	if (group_depth++ == 0)
+	{
+		group_entry = next_entry++;
+		group_dropped = false;
+	}
+}
+
+void ad_curve_journal::end_group()
+{
+	assert(group_depth > 0);
+	group_depth--;
+}
+
+void ad_curve_journal::record(ad_journal_op op, size_t key_i, size_t num_keys)
+{
+	assert(curve && data);
+	assert(key_i + num_keys <= curve->num_keys);
+	if (num_keys == 0)
+	{
+		return;
+	}
+
+	// If we've already had to forget part of the group we're recording into, the group
+	// can't be undone anyway, so there's no point keeping the rest of it
+	const uint32_t entry = group_depth > 0 ? group_entry : next_entry++;
+	if (group_depth > 0 && group_dropped)
+	{
+		return;
+	}
+
+	// A new edit means that anything we'd undone can no longer be redone
+	size = undo_size;
+
+	// Make room by forgetting the oldest entries: we free an eighth of our capacity
+	// beyond what we need, so that we don't have to shift every record on every edit.
+	// If we'd have to forget part of the group we're recording into, or the record won't
+	// fit at all, we forget everything instead.
+	const size_t record_size = record_size_for(num_keys, curve->stride);
+	if (size + record_size > capacity)
+	{
+		const size_t slack = record_size < capacity ? std::min(capacity / 8, capacity - record_size) : 0;
+		size_t dropped = 0;
+		while (dropped < size && size - dropped + record_size + slack > capacity)
+		{
+			if (record_at(data, dropped)->entry == entry)
+			{
+				break;
+			}
+			dropped += record_at(data, dropped)->size;
+		}
+		if (record_size > capacity || (dropped < size && record_at(data, dropped)->entry == entry))
+		{
+			clear();
+			group_dropped = group_depth > 0;
+			return;
+		}
+
+		// Entries are contiguous, so we only ever drop whole entries from the front
+		memmove(data, data + dropped, size - dropped);
+		size -= dropped;
+	}
+
+	// Write the record's header, then the keys it covers, then its size again
+	ad_journal_record* record = reinterpret_cast<ad_journal_record*>(data + size);
+	record->size = static_cast<uint32_t>(record_size);
+	record->entry = entry;
+	record->key_i = static_cast<uint32_t>(key_i);
+	record->num_keys = static_cast<uint32_t>(num_keys);
+	record->op = op;
+	memset(record->pad, 0, sizeof(record->pad));
+	float* record_times = reinterpret_cast<float*>(record + 1);
+	float* record_values = record_times + num_keys;
+	for (size_t i = 0; i < num_keys; i++)
+	{
+		record_times[i] = curve->key_time(key_i + i);
+	}
+	memcpy(record_values, curve->values.data + key_i * curve->stride, num_keys * curve->stride * sizeof(float));
+	memcpy(data + size + record_size - sizeof(uint32_t), &record->size, sizeof(uint32_t));
+	size += record_size;
+	undo_size = size;
+}
+
+static bool insert_keys(ad_curve& curve, size_t key_i, size_t num_keys, const float* times, const float* values)
+{
+	if (!curve.reserve(curve.num_keys + num_keys))
+	{
+		return false;
+	}
+	float* dst_times = curve.times.resize_for_edit(key_i, static_cast<int32_t>(num_keys));
+	float* dst_values = curve.values.resize_for_edit(key_i * curve.stride, static_cast<int32_t>(num_keys * curve.stride));
+	memcpy(dst_times, times, num_keys * sizeof(float));
+	memcpy(dst_values, values, num_keys * curve.stride * sizeof(float));
+	curve.num_keys += num_keys;
+	curve.mark_dirty_keys(key_i, num_keys);
+	return true;
+}
+
+static void remove_keys(ad_curve& curve, size_t key_i, size_t num_keys)
+{
+	curve.mark_dirty_keys(key_i, num_keys);
+	curve.times.resize_for_edit(key_i, -static_cast<int32_t>(num_keys));
+	curve.values.resize_for_edit(key_i * curve.stride, -static_cast<int32_t>(num_keys * curve.stride));
+	curve.num_keys -= num_keys;
+}
+
+static bool apply(ad_curve& curve, ad_journal_record* record, bool undoing)
+{
+	// Undoing an insert removes the keys it inserted, and undoing a remove puts its keys
+	// back: redoing does the opposite. Modifies just swap the record's keys with the
+	// curve's, so the record always holds whichever version isn't in the curve.
+	float* record_times = reinterpret_cast<float*>(record + 1);
+	float* record_values = record_times + record->num_keys;
+	switch (record->op)
+	{
+	case ad_journal_op::insert:
+	case ad_journal_op::remove:
+		if ((record->op == ad_journal_op::insert) == undoing)
+		{
+			remove_keys(curve, record->key_i, record->num_keys);
+			return true;
+		}
+		return insert_keys(curve, record->key_i, record->num_keys, record_times, record_values);
+	case ad_journal_op::modify:
+		curve.mark_dirty_keys(record->key_i, record->num_keys);
+		std::swap_ranges(record_times, record_times + record->num_keys, curve.times.data + record->key_i);
+		std::swap_ranges(record_values, record_values + record->num_keys * curve.stride, curve.values.data + record->key_i * curve.stride);
+		return true;
+	default:
+		assert(false);
+		return false;
+	}
+}
+
+bool ad_curve_journal::undo()
+{
+	AD_TRACE_SCOPE("ad_curve_journal::undo");
+	assert(curve);
+	assert(group_depth == 0);
+	if (!can_undo() || curve->is_borrowed() || !curve->make_explicit())
+	{
+		return false;
+	}
+	curve->invalidate_search_index();
+
+	// Undo the records of the last entry, starting from the last record
+	const uint32_t entry = record_at(data, undo_size - record_size_before(data, undo_size))->entry;
+	while (undo_size > 0)
+	{
+		const size_t record_offset = undo_size - record_size_before(data, undo_size);
+		ad_journal_record* record = reinterpret_cast<ad_journal_record*>(data + record_offset);
+		if (record->entry != entry)
+		{
+			break;
+		}
+		if (!apply(*curve, record, true))
+		{
+			return false;
+		}
+		undo_size = record_offset;
+	}
+	return true;
+}
+
+bool ad_curve_journal::redo()
+{
+	AD_TRACE_SCOPE("ad_curve_journal::redo");
+	assert(curve);
+	assert(group_depth == 0);
+	if (!can_redo() || curve->is_borrowed() || !curve->make_explicit())
+	{
+		return false;
+	}
+	curve->invalidate_search_index();
+
+	// Redo the records of the next entry, starting from its first record
+	const uint32_t entry = record_at(data, undo_size)->entry;
+	while (undo_size < size)
+	{
+		ad_journal_record* record = reinterpret_cast<ad_journal_record*>(data + undo_size);
+		if (record->entry != entry)
+		{
+			break;
+		}
+		if (!apply(*curve, record, false))
+		{
+			return false;
+		}
+		undo_size += record->size;
+	}
+	return true;
+}
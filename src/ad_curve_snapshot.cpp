@@ -0,0 +1,90 @@
+#include "ad_curve_snapshot.h"
+
+#include <cassert>
+#include <thread>
+
+ad_shared_curve::ad_shared_curve(size_t in_cardinality, ad_interp in_interp, const ad_allocator* in_allocator)
+	: editor(in_cardinality, in_interp, in_allocator)
+	, current(nullptr)
+	, acquiring_slot(0)
+{
+	num_acquiring[0].store(0, std::memory_order_relaxed);
+	num_acquiring[1].store(0, std::memory_order_relaxed);
+}
+
+ad_shared_curve::~ad_shared_curve()
+{
+	// Readers may still hold snapshots: they'll be freed when the last one is released
+	const ad_curve_snapshot* snapshot = current.load(std::memory_order_relaxed);
+	if (snapshot)
+	{
+		snapshot->release();
+	}
+}
+
+bool ad_shared_curve::init()
+{
+	// Start out with an empty curve published
+	assert(!current.load(std::memory_order_relaxed));
+	if (!editor.init())
+	{
+		return false;
+	}
+	current.store(editor.snapshot(), std::memory_order_release);
+	return true;
+}
+
+bool ad_shared_curve::set(float time, const float* value, const float* tangent)
+{
+	return editor.set(time, value, tangent);
+}
+
+bool ad_shared_curve::remove_at(float time)
+{
+	return editor.remove_at(time);
+}
+
+static void wait_for_acquiring(const std::atomic<uint32_t>& num_acquiring)
+{
+	while (num_acquiring.load(std::memory_order_seq_cst) != 0)
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool ad_shared_curve::publish()
+{
+	// Nothing to do if nothing's been edited since we last published: any edit would
+	// have forked the table we published
+	if (editor.table == current.load(std::memory_order_relaxed))
+	{
+		return true;
+	}
+
+	// Swap in a snapshot: a reader that loads current from here on sees the new version
+	const ad_curve_snapshot* previous = current.exchange(editor.snapshot(), std::memory_order_seq_cst);
+
+	// A reader that loaded the previous version may not have retained it yet, and it may
+	// be counted in either slot, so we wait for both slots to drain before releasing our
+	// own reference. New readers always join the slot we're not waiting on: the other
+	// slot can only hold stragglers that read acquiring_slot before our last switch, and
+	// each of those will be done within a few instructions, so neither wait can starve.
+	const uint32_t slot = acquiring_slot.load(std::memory_order_relaxed);
+	wait_for_acquiring(num_acquiring[slot ^ 1]);
+	acquiring_slot.store(slot ^ 1, std::memory_order_seq_cst);
+	wait_for_acquiring(num_acquiring[slot]);
+	previous->release();
+	return true;
+}
+
+const ad_curve_snapshot* ad_shared_curve::acquire() const
+{
+	// Announce ourselves before loading current, so that the writer can't free the
+	// snapshot we load before we've retained it
+	const uint32_t slot = acquiring_slot.load(std::memory_order_seq_cst);
+	num_acquiring[slot].fetch_add(1, std::memory_order_seq_cst);
+	const ad_curve_snapshot* snapshot = current.load(std::memory_order_seq_cst);
+	snapshot->retain();
+	num_acquiring[slot].fetch_sub(1, std::memory_order_release);
+	return snapshot;
+}
@@ -0,0 +1,230 @@
+#include "ad_curve_t.h"
+
+#include <cassert>
+
+#include "ad_blend.h"
+
+template <typename TValue, size_t N>
+static inline void copy_value(TValue* dst, const TValue* src)
+{
+	// A fixed-length loop, which the compiler can unroll in place of a memcpy call
+	for (size_t k = 0; k < N; k++)
+	{
+		dst[k] = src[k];
+	}
+}
+
+template <typename TTime>
+static inline float segment_alpha(TTime time_a, TTime time_b, TTime time)
+{
+	// Take differences in the time type before converting, so that double and tick times
+	// keep their precision far from zero
+	return static_cast<float>(static_cast<double>(time - time_a) / static_cast<double>(time_b - time_a));
+}
+
+template <typename TTime, typename TValue, size_t N>
+ad_curve_t<TTime, TValue, N>::ad_curve_t(ad_interp in_interp, const ad_allocator* in_allocator)
+	: stride(in_interp == ad_interp::hermite ? N * 2 : N)
+	, interp(in_interp)
+	, times(in_allocator)
+	, values(in_allocator)
+{
+	// Quaternion blends only make sense for 4-component values
+	assert(N == 4 || (in_interp != ad_interp::nlerp && in_interp != ad_interp::slerp));
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::init(size_t initial_capacity)
+{
+	return times.init(initial_capacity) && values.init(initial_capacity * stride);
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::reserve(size_t num_keys_to_fit)
+{
+	return times.reserve(num_keys_to_fit) && values.reserve(num_keys_to_fit * stride);
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::set(TTime time, const TValue* value, const TValue* tangent)
+{
+	// Overwrite an existing key at this time, or insert a new key after the last one before it
+	const int32_t i = find_nearest_lte(time);
+	TValue* dst;
+	if (i >= 0 && times.data[i] == time)
+	{
+		dst = values.data + i * stride;
+	}
+	else
+	{
+		const size_t times_i = static_cast<size_t>(i + 1);
+		TTime* time_ptr = times.resize_for_edit(times_i, 1);
+		if (!time_ptr)
+		{
+			return false;
+		}
+		dst = values.resize_for_edit(times_i * stride, static_cast<int32_t>(stride));
+		if (!dst)
+		{
+			times.resize_for_edit(times_i, -1);
+			return false;
+		}
+		*time_ptr = time;
+	}
+
+	// Each key stores its value, followed by its tangent if the curve has room for one
+	copy_value<TValue, N>(dst, value);
+	if (stride > N)
+	{
+		for (size_t k = 0; k < N; k++)
+		{
+			dst[N + k] = tangent ? tangent[k] : TValue(0);
+		}
+	}
+	return true;
+}
+
+template <typename TTime, typename TValue, size_t N>
+void ad_curve_t<TTime, TValue, N>::remove_at(TTime time)
+{
+	const int32_t i = find_nearest_lte(time);
+	if (i >= 0 && times.data[i] == time)
+	{
+		times.resize_for_edit(i, -1);
+		values.resize_for_edit(i * stride, -static_cast<int32_t>(stride));
+	}
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::evaluate(TTime time, TValue* out_value) const
+{
+	return evaluate_at(find_nearest_lte(time), time, out_value);
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::evaluate_many(const TTime* in_times, size_t n, TValue* out_values) const
+{
+	// Carry each result forward as a hint, so that sorted times step through the keys
+	int32_t times_i = -1;
+	for (size_t i = 0; i < n; i++)
+	{
+		times_i = find_nearest_lte_from(in_times[i], times_i);
+		if (!evaluate_at(times_i, in_times[i], out_values + i * N))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+template <typename TTime, typename TValue, size_t N>
+bool ad_curve_t<TTime, TValue, N>::evaluate_at(int32_t times_i, TTime time, TValue* out_value) const
+{
+	// An empty curve has no value at any time
+	if (times.size == 0)
+	{
+		return false;
+	}
+
+	// Before the first key or at/after the last key, hold the value of the nearest key
+	const int32_t last_i = static_cast<int32_t>(times.size) - 1;
+	if (times_i < 0 || times_i >= last_i || interp == ad_interp::constant)
+	{
+		copy_value<TValue, N>(out_value, values.data + (times_i >= 0 ? times_i : 0) * stride);
+		return true;
+	}
+
+	// Otherwise, blend between the key at times_i and the key that follows it
+	const float alpha = segment_alpha(times.data[times_i], times.data[times_i + 1], time);
+	const TValue* value_a = values.data + times_i * stride;
+	const TValue* value_b = value_a + stride;
+	switch (interp)
+	{
+	case ad_interp::linear:
+		for (size_t k = 0; k < N; k++)
+		{
+			out_value[k] = value_a[k] + (value_b[k] - value_a[k]) * alpha;
+		}
+		break;
+	case ad_interp::hermite:
+	{
+		// Tangents are scaled to the duration of the segment, as in ad_curve
+		const float duration = static_cast<float>(times.data[times_i + 1] - times.data[times_i]);
+		const float alpha2 = alpha * alpha;
+		const float alpha3 = alpha2 * alpha;
+		const float w0 = 2.0f * alpha3 - 3.0f * alpha2 + 1.0f;
+		const float w1 = (alpha3 - 2.0f * alpha2 + alpha) * duration;
+		const float w2 = -2.0f * alpha3 + 3.0f * alpha2;
+		const float w3 = (alpha3 - alpha2) * duration;
+		for (size_t k = 0; k < N; k++)
+		{
+			out_value[k] = w0 * value_a[k] + w1 * value_a[N + k] + w2 * value_b[k] + w3 * value_b[N + k];
+		}
+		break;
+	}
+	case ad_interp::nlerp:
+	case ad_interp::slerp:
+		ad_blend_quat(value_a, value_b, alpha, interp == ad_interp::slerp, out_value);
+		break;
+	default:
+		assert(false);
+		return false;
+	}
+	return true;
+}
+
+template <typename TTime, typename TValue, size_t N>
+int32_t ad_curve_t<TTime, TValue, N>::find_nearest_lte(TTime at_time) const
+{
+	// Binary search for the last key at or before at_time, or -1 if there is none
+	int32_t i = -1;
+	int32_t lo = 0;
+	int32_t hi = static_cast<int32_t>(times.size) - 1;
+	while (lo <= hi)
+	{
+		const int32_t mid = lo + (hi - lo) / 2;
+		if (times.data[mid] <= at_time)
+		{
+			i = mid;
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+	return i;
+}
+
+template <typename TTime, typename TValue, size_t N>
+int32_t ad_curve_t<TTime, TValue, N>::find_nearest_lte_from(TTime at_time, int32_t hint) const
+{
+	// Sorted lookups usually land on the hinted key or the one after it: check those
+	// first, and fall back to a full search otherwise
+	const int32_t n = static_cast<int32_t>(times.size);
+	if (hint >= 0 && hint < n && times.data[hint] <= at_time)
+	{
+		if (hint + 1 == n || times.data[hint + 1] > at_time)
+		{
+			return hint;
+		}
+		if (hint + 2 == n || times.data[hint + 2] > at_time)
+		{
+			return hint + 1;
+		}
+	}
+	return find_nearest_lte(at_time);
+}
+
+template struct ad_curve_t<float, float, 1>;
+template struct ad_curve_t<float, float, 2>;
+template struct ad_curve_t<float, float, 3>;
+template struct ad_curve_t<float, float, 4>;
+template struct ad_curve_t<double, float, 1>;
+template struct ad_curve_t<double, float, 2>;
+template struct ad_curve_t<double, float, 3>;
+template struct ad_curve_t<double, float, 4>;
+template struct ad_curve_t<int64_t, float, 1>;
+template struct ad_curve_t<int64_t, float, 2>;
+template struct ad_curve_t<int64_t, float, 3>;
+template struct ad_curve_t<int64_t, float, 4>;
@@ -1,61 +1,92 @@
 #include "ad_input_recorder.h"
 
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
+#include <new>
+#include <algorithm>
 
-ad_input_record_chunk::ad_input_record_chunk(size_t in_capacity)
+#include "ad_curve_journal.h"
+#include "ad_instrument.h"
+
+ad_input_record_chunk::ad_input_record_chunk(size_t in_capacity, ad_input_sample* in_data)
     : capacity(in_capacity)
     , size(0)
-    , data(nullptr)
+    , data(in_data)
     , next(nullptr)
 {
 }
 
-ad_input_record_chunk::~ad_input_record_chunk()
+ad_input_record_chunk* ad_input_record_chunk::create(size_t capacity, const ad_allocator* allocator)
 {
-    free(data);
+    // Allocate the chunk header and its samples in a single block, with the samples
+    // following the header
+    const size_t header_size = sizeof(ad_input_record_chunk);
+    static_assert(sizeof(ad_input_record_chunk) % alignof(ad_input_sample) == 0, "samples must be aligned");
+    uint8_t* block = reinterpret_cast<uint8_t*>(allocator->allocate(header_size + capacity * sizeof(ad_input_sample)));
+    if (!block)
+    {
+        return nullptr;
+    }
+    ad_input_sample* data = reinterpret_cast<ad_input_sample*>(block + header_size);
+    return new (block) ad_input_record_chunk(capacity, data);
 }
 
-bool ad_input_record_chunk::init()
+void ad_input_record_chunk::destroy(ad_input_record_chunk* chunk, const ad_allocator* allocator)
 {
-    data = reinterpret_cast<ad_input_sample*>(malloc(capacity * sizeof(ad_input_sample)));
-    return data != nullptr;
+    const size_t block_size = sizeof(ad_input_record_chunk) + chunk->capacity * sizeof(ad_input_sample);
+    chunk->~ad_input_record_chunk();
+    allocator->deallocate(chunk, block_size);
 }
 
-ad_input_recorder::ad_input_recorder(size_t in_chunk_size, size_t in_num_initial_chunks)
+ad_input_recorder::ad_input_recorder(size_t in_chunk_size, size_t in_num_initial_chunks, const ad_allocator* in_allocator, ad_input_record_mode in_mode)
     : chunk_size(in_chunk_size)
     , num_initial_chunks(in_num_initial_chunks)
     , first(nullptr)
     , write_head(nullptr)
+    , free_chunks(nullptr)
+    , num_free_chunks(0)
+    , allocator(in_allocator)
+    , mode(in_mode)
+    , tolerance(0.0f)
+    , slope_min(-INFINITY)
+    , slope_max(INFINITY)
     , last_value_recorded(0.0f)
     , last_time_recorded(-1.0f)
+    , last_value_seen(0.0f)
     , last_time_seen(-1.0f)
 {
 }
 
 ad_input_recorder::~ad_input_recorder()
 {
-    ad_input_record_chunk* chunk = first;
-    while (chunk)
+    ad_input_record_chunk* lists[] = { first, free_chunks };
+    for (ad_input_record_chunk* chunk : lists)
     {
-        ad_input_record_chunk* next = chunk->next;
-        delete chunk;
-        chunk = next;
+        while (chunk)
+        {
+            ad_input_record_chunk* next = chunk->next;
+            ad_input_record_chunk::destroy(chunk, allocator);
+            chunk = next;
+        }
     }
 }
 
 bool ad_input_recorder::init()
 {
-    // We should be properly constructed and not yet initialized
+    // We should be properly constructed and not yet initialized: a ring needs at least two
+    // chunks, so that it can recycle one while still holding onto recent samples
     assert(chunk_size > 0);
     assert(num_initial_chunks > 0);
+    assert(mode != ad_input_record_mode::ring || num_initial_chunks > 1);
     assert(!first);
     assert(!write_head);
 
     // Allocate our initial chunk to contain the start of our recorded data
-    first = new ad_input_record_chunk(chunk_size);
-    if (!first || !first->init())
+    first = new_chunk();
+    if (!first)
     {
         return false;
     }
@@ -66,8 +97,8 @@ bool ad_input_recorder::init()
     for (size_t i = 1; i < num_initial_chunks; i++)
     {
         // Halt on any allocation failures
-        ad_input_record_chunk* chunk = new ad_input_record_chunk(chunk_size);
-        if (!chunk || !chunk->init())
+        ad_input_record_chunk* chunk = new_chunk();
+        if (!chunk)
         {
             return false;
         }
@@ -79,12 +110,96 @@ bool ad_input_recorder::init()
     return true;
 }
 
+void ad_input_recorder::reset()
+{
+    // We should already be initialized
+    assert(first);
+
+    // A ring keeps its chunks linked in place; otherwise, we keep only our first chunk
+    // and return the rest to our free list, to be reused as we record again
+    ad_input_record_chunk* chunk = first;
+    if (mode != ad_input_record_mode::ring)
+    {
+        chunk = first->next;
+        first->next = nullptr;
+        first->size.store(0, std::memory_order_relaxed);
+        while (chunk)
+        {
+            ad_input_record_chunk* next = chunk->next;
+            free_chunk(chunk);
+            chunk = next;
+        }
+    }
+    while (chunk)
+    {
+        chunk->size.store(0, std::memory_order_relaxed);
+        chunk = chunk->next;
+    }
+
+    write_head = first;
+    slope_min = -INFINITY;
+    slope_max = INFINITY;
+    last_value_recorded = 0.0f;
+    last_time_recorded = -1.0f;
+    last_value_seen = 0.0f;
+    last_time_seen = -1.0f;
+}
+
+void ad_input_recorder::release_read_chunks(const ad_input_record_reader& reader)
+{
+    // Every chunk before the reader's current chunk has been read in full: those chunks
+    // can be returned to our free list, to be reused as we continue recording. Acquiring
+    // the reader's published position ensures that it's done with them before we reuse
+    // them, and we never touch the reader's own cursor, which it's free to keep moving.
+    assert(mode != ad_input_record_mode::ring);
+    const ad_input_record_chunk* read_chunk = reader.published_chunk.load(std::memory_order_acquire);
+    while (first != read_chunk)
+    {
+        assert(first != write_head);
+        ad_input_record_chunk* chunk = first;
+        first = first->next;
+        free_chunk(chunk);
+    }
+}
+
 bool ad_input_recorder::handle_sample(float time, float value)
 {
     // Sample times are relative to the start of recording and should always increase
     assert(time >= 0.0f);
     assert(last_time_seen == -1.0f || time > last_time_seen);
 
+    // With a tolerance, we can skip any sample that keeps our swinging door open
+    if (tolerance > 0.0f && last_time_seen >= 0.0f)
+    {
+        // Narrow the range of slopes from our last recorded sample to those that pass
+        // within tolerance of this sample, as well as every sample we've skipped so far
+        const float dt = time - last_time_recorded;
+        const float new_slope_min = std::max(slope_min, (value - tolerance - last_value_recorded) / dt);
+        const float new_slope_max = std::min(slope_max, (value + tolerance - last_value_recorded) / dt);
+        if (new_slope_min <= new_slope_max)
+        {
+            slope_min = new_slope_min;
+            slope_max = new_slope_max;
+            last_time_seen = time;
+            last_value_seen = value;
+            AD_COUNT(samples_dropped, 1);
+            return true;
+        }
+
+        // The door has closed: record the last sample we skipped, then reopen the door
+        // from there with this sample
+        if (!flush())
+        {
+            return false;
+        }
+        const float new_dt = time - last_time_recorded;
+        slope_min = (value - tolerance - last_value_recorded) / new_dt;
+        slope_max = (value + tolerance - last_value_recorded) / new_dt;
+        last_time_seen = time;
+        last_value_seen = value;
+        return true;
+    }
+
     // If this new sample maintains the same value as the last sample we recorded,
     // don't record a new sample
     const bool value_is_unchanged = last_time_seen >= 0.0f && last_value_recorded == value;
@@ -95,6 +210,8 @@ bool ad_input_recorder::handle_sample(float time, float value)
         // this time is the same as last_value_recorded, and we don't have to modify
         // our actual buffered data at all
         last_time_seen = time;
+        last_value_seen = value;
+        AD_COUNT(samples_dropped, 1);
         return true;
     }
 
@@ -102,12 +219,9 @@ bool ad_input_recorder::handle_sample(float time, float value)
     // skipped recording any prior samples because their value was unchanged from the
     // last sample we recorded, we need to insert another sample to ensure that our
     // value will remain constant during that time span with linear interpolation
-    if (last_time_seen > last_time_recorded)
+    if (!flush())
     {
-        if (!write(last_time_seen, last_value_recorded))
-        {
-            return false;
-        }
+        return false;
     }
 
     // Write the sample we're currently handling into our current write chunk
@@ -116,44 +230,246 @@ bool ad_input_recorder::handle_sample(float time, float value)
         return false;
     }
     last_time_seen = time;
-    last_time_recorded = time;
-    last_value_recorded = value;
+    last_value_seen = value;
+    return true;
+}
+
+bool ad_input_recorder::flush()
+{
+    // If we've skipped any samples since we last recorded one, record the key that we'd
+    // otherwise only write once the value changes, so that everything we've seen so far
+    // is committed and readable
+    if (last_time_seen > last_time_recorded)
+    {
+        // Without a tolerance, this is just the held value; otherwise, we pick a value on
+        // a line within the swinging door, so that every skipped sample stays in tolerance
+        float value = last_value_seen;
+        if (tolerance > 0.0f)
+        {
+            const float dt = last_time_seen - last_time_recorded;
+            const float slope = std::min(std::max((last_value_seen - last_value_recorded) / dt, slope_min), slope_max);
+            value = last_value_recorded + slope * dt;
+        }
+        if (!write(last_time_seen, value))
+        {
+            return false;
+        }
+        slope_min = -INFINITY;
+        slope_max = INFINITY;
+    }
     return true;
 }
 
 bool ad_input_recorder::write(float time, float value)
 {
-    // We should have a valid chunk to write to, with space available
+    // We should have a valid chunk to write to, with space available: we're the only
+    // thread that modifies size, so we don't need any ordering to read it
     assert(write_head);
     assert(write_head->data);
-    assert(write_head->size < write_head->capacity);
+    const size_t write_index = write_head->size.load(std::memory_order_relaxed);
+    assert(write_index < write_head->capacity);
 
     // Write our new sample into the current write chunk
-    const size_t write_index = write_head->size;
     write_head->data[write_index].time = time;
     write_head->data[write_index].value = value;
-    write_head->size++;
     last_time_recorded = time;
     last_value_recorded = value;
 
-    // If we've now filled that chunk, advance our write head to the next chunk
-    if (write_head->size == write_head->capacity)
+    // If this sample fills the chunk and it was the last chunk we had allocated, allocate
+    // and link a new one before publishing the sample, so that any reader who sees a full
+    // chunk will also see its successor
+    const bool is_full = write_index + 1 == write_head->capacity;
+    bool ok = true;
+    if (is_full && !write_head->next)
+    {
+        if (mode == ad_input_record_mode::ring)
+        {
+            // A ring recycles its oldest chunk rather than allocating: we only ever get
+            // here once every chunk is full
+            ad_input_record_chunk* oldest = first;
+            first = first->next;
+            oldest->next = nullptr;
+            oldest->size.store(0, std::memory_order_relaxed);
+            write_head->next = oldest;
+        }
+        else
+        {
+            // If allocation fails (our only error case), the sample is still published
+            write_head->next = new_chunk();
+            ok = write_head->next != nullptr;
+        }
+    }
+
+    // Publish the sample to readers
+    write_head->size.store(write_index + 1, std::memory_order_release);
+
+    // If we've now filled that chunk, subsequent writes should target the next chunk
+    if (is_full && ok)
+    {
+        assert(write_head->next->size.load(std::memory_order_relaxed) == 0);
+        write_head = write_head->next;
+    }
+    return ok;
+}
+
+ad_input_record_chunk* ad_input_recorder::new_chunk()
+{
+    // Reuse a chunk from our free list if we have one, or allocate a new one otherwise
+    if (free_chunks)
     {
-        // If this was the last chunk we had allocated, allocate a new one
-        if (!write_head->next)
+        ad_input_record_chunk* chunk = free_chunks;
+        free_chunks = chunk->next;
+        num_free_chunks--;
+        chunk->next = nullptr;
+        chunk->size.store(0, std::memory_order_relaxed);
+        return chunk;
+    }
+    ad_input_record_chunk* chunk = ad_input_record_chunk::create(chunk_size, allocator);
+    AD_COUNT(chunk_allocations, chunk ? 1 : 0);
+    return chunk;
+}
+
+void ad_input_recorder::free_chunk(ad_input_record_chunk* chunk)
+{
+    chunk->next = free_chunks;
+    free_chunks = chunk;
+    num_free_chunks++;
+}
+
+ad_input_record_reader::ad_input_record_reader(const ad_input_recorder& recorder)
+    : chunk(recorder.first)
+    , index(0)
+    , published_chunk(recorder.first)
+{
+    // The recorder should already be initialized
+    assert(chunk);
+}
+
+size_t ad_input_record_reader::peek(const ad_input_sample*& out_samples)
+{
+    // If we've read everything in a full chunk, move on to the next one: it's always
+    // linked before the chunk's final sample is published
+    size_t committed = chunk->size.load(std::memory_order_acquire);
+    if (index == chunk->capacity && chunk->next)
+    {
+        chunk = chunk->next;
+        index = 0;
+        published_chunk.store(chunk, std::memory_order_release);
+        committed = chunk->size.load(std::memory_order_acquire);
+    }
+
+    // Every sample before the published size is safe to read
+    out_samples = chunk->data + index;
+    return committed - index;
+}
+
+void ad_input_record_reader::consume(size_t n)
+{
+    assert(index + n <= chunk->capacity);
+    index += n;
+}
+
+size_t ad_input_record_reader::read(ad_input_sample* out_samples, size_t max_samples)
+{
+    // Copy out as many committed samples as we can, crossing chunks as needed
+    size_t num_read = 0;
+    while (num_read < max_samples)
+    {
+        const ad_input_sample* samples = nullptr;
+        size_t available = peek(samples);
+        if (available == 0)
+        {
+            break;
+        }
+        if (available > max_samples - num_read)
         {
-            write_head->next = new ad_input_record_chunk(chunk_size);
-            if (!write_head->next || !write_head->next->init())
+            available = max_samples - num_read;
+        }
+        memcpy(out_samples + num_read, samples, available * sizeof(ad_input_sample));
+        consume(available);
+        num_read += available;
+    }
+    return num_read;
+}
+
+static bool bake_chunks(ad_input_record_reader& reader, ad_curve& curve)
+{
+    const ad_input_sample* samples = nullptr;
+    size_t available;
+    while ((available = reader.peek(samples)) > 0)
+    {
+        // A sample at or before the curve's last key can't simply be appended: merge it
+        // in the usual way, which should only happen for the first sample baked
+        size_t num_merged = 0;
+        while (num_merged < available && curve.num_keys > 0 && samples[num_merged].time <= curve.times.data[curve.num_keys - 1])
+        {
+            if (!curve.set(samples[num_merged].time, &samples[num_merged].value))
             {
-                // Allocation failed: this is the only error case
                 return false;
             }
+            num_merged++;
         }
+        const size_t n = available - num_merged;
 
-        // Subsequent writes should target the next chunk in line
-        assert(write_head->next);
-        assert(write_head->next->size == 0);
-        write_head = write_head->next;
+        // Grow geometrically as we bake chunk after chunk, so that incremental baking of
+        // a long recording doesn't reallocate for every chunk
+        const size_t num_keys = curve.num_keys + n;
+        if (num_keys > curve.times.capacity)
+        {
+            const size_t grown = static_cast<size_t>(curve.times.capacity * curve.times.growth_factor);
+            if (!curve.reserve(grown > num_keys ? grown : num_keys))
+            {
+                return false;
+            }
+        }
+
+        // Append every remaining sample to our pre-reserved buffers, then record them as
+        // inserted for the curve's journal and dirty ranges
+        const size_t first_key = curve.num_keys;
+        float* out_times = curve.times.data + curve.num_keys;
+        float* out_values = curve.values.data + curve.num_keys;
+        for (size_t i = 0; i < n; i++)
+        {
+            out_times[i] = samples[num_merged + i].time;
+            out_values[i] = samples[num_merged + i].value;
+        }
+        curve.num_keys = num_keys;
+        curve.times.size = num_keys;
+        curve.values.size = num_keys;
+        curve.note_appended(first_key, n);
+        reader.consume(available);
     }
     return true;
 }
+
+bool ad_bake_to_curve(ad_input_record_reader& reader, ad_curve& curve)
+{
+    // Recorded samples are scalar, with no tangents
+    assert(curve.cardinality == 1);
+    assert(curve.stride == 1);
+    AD_TRACE_SCOPE("ad_bake_to_curve");
+    if (curve.is_borrowed() || !curve.make_explicit())
+    {
+        return false;
+    }
+    curve.invalidate_search_index();
+
+    // Every sample merged or chunk appended is journaled separately, so group them into
+    // a single undo step for the whole bake
+    if (curve.journal)
+    {
+        curve.journal->begin_group();
+    }
+    const bool baked = bake_chunks(reader, curve);
+    if (curve.journal)
+    {
+        curve.journal->end_group();
+    }
+    return baked;
+}
+
+bool ad_bake_to_curve(const ad_input_recorder& recorder, ad_curve& curve)
+{
+    ad_input_record_reader reader(recorder);
+    return ad_bake_to_curve(reader, curve);
+}
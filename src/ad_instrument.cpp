@@ -0,0 +1,157 @@
+#include "ad_instrument.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+
+static ad_counters g_counters;
+static std::atomic<ad_trace_fn> g_trace_fn(nullptr);
+static std::atomic<void*> g_trace_user(nullptr);
+static std::atomic<uint32_t> g_next_thread_id(1);
+
+ad_counters& ad_get_counters()
+{
+	return g_counters;
+}
+
+void ad_reset_counters()
+{
+	g_counters.search_iterations.store(0, std::memory_order_relaxed);
+	g_counters.bytes_moved.store(0, std::memory_order_relaxed);
+	g_counters.reallocations.store(0, std::memory_order_relaxed);
+	g_counters.chunk_allocations.store(0, std::memory_order_relaxed);
+	g_counters.samples_dropped.store(0, std::memory_order_relaxed);
+}
+
+void ad_set_trace_hook(ad_trace_fn fn, void* user)
+{
+	// Set the user pointer first, so that a scope that sees the new hook sees its user too
+	g_trace_user.store(user, std::memory_order_release);
+	g_trace_fn.store(fn, std::memory_order_release);
+}
+
+uint64_t ad_trace_now_ns()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint32_t ad_trace_thread_id()
+{
+	// Give each thread a small, stable id the first time it asks for one
+	static thread_local uint32_t thread_id = g_next_thread_id.fetch_add(1, std::memory_order_relaxed);
+	return thread_id;
+}
+
+ad_trace_scope::ad_trace_scope(const char* in_name)
+	: name(in_name)
+	, begin_ns(g_trace_fn.load(std::memory_order_acquire) ? ad_trace_now_ns() : 0)
+{
+}
+
+ad_trace_scope::~ad_trace_scope()
+{
+	// Scopes that open with no hook set don't read the clock at all
+	const ad_trace_fn fn = g_trace_fn.load(std::memory_order_acquire);
+	if (fn && begin_ns != 0)
+	{
+		fn(g_trace_user.load(std::memory_order_acquire), name, ad_trace_thread_id(), begin_ns, ad_trace_now_ns());
+	}
+}
+
+struct ad_trace_log_lock
+{
+	std::mutex mutex;
+};
+
+ad_trace_log::ad_trace_log()
+	: capacity(0)
+	, size(0)
+	, events(nullptr)
+	, lock(nullptr)
+{
+}
+
+ad_trace_log::~ad_trace_log()
+{
+	free(events);
+	delete lock;
+}
+
+bool ad_trace_log::init(size_t initial_capacity)
+{
+	assert(!events);
+	assert(initial_capacity > 0);
+	events = reinterpret_cast<ad_trace_event*>(malloc(initial_capacity * sizeof(ad_trace_event)));
+	if (!events)
+	{
+		return false;
+	}
+	capacity = initial_capacity;
+	lock = new ad_trace_log_lock();
+	return true;
+}
+
+void ad_trace_log::add(const char* name, uint32_t thread_id, uint64_t begin_ns, uint64_t end_ns)
+{
+	// Grow as needed: if we can't, or if init never succeeded, the event is dropped rather
+	// than failing the caller
+	if (!lock)
+	{
+		return;
+	}
+	std::lock_guard<std::mutex> guard(lock->mutex);
+	if (!events)
+	{
+		return;
+	}
+	if (size == capacity)
+	{
+		const size_t new_capacity = capacity > 0 ? capacity * 2 : 16;
+		ad_trace_event* new_events = reinterpret_cast<ad_trace_event*>(realloc(events, new_capacity * sizeof(ad_trace_event)));
+		if (!new_events)
+		{
+			return;
+		}
+		events = new_events;
+		capacity = new_capacity;
+	}
+	events[size++] = { name, thread_id, begin_ns, end_ns };
+}
+
+bool ad_trace_log::write_chrome_json(const char* path) const
+{
+	if (!lock)
+	{
+		return false;
+	}
+	FILE* fp = fopen(path, "w");
+	if (!fp)
+	{
+		return false;
+	}
+
+	// Complete ("X") events, with timestamps in microseconds relative to the first event
+	std::lock_guard<std::mutex> guard(lock->mutex);
+	uint64_t origin_ns = size > 0 ? events[0].begin_ns : 0;
+	for (size_t i = 1; i < size; i++)
+	{
+		origin_ns = events[i].begin_ns < origin_ns ? events[i].begin_ns : origin_ns;
+	}
+	fprintf(fp, "{\"traceEvents\": [\n");
+	for (size_t i = 0; i < size; i++)
+	{
+		const ad_trace_event& event = events[i];
+		const char* separator = i + 1 < size ? "," : "";
+		fprintf(fp, "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}%s\n",
+			event.name, event.thread_id, (event.begin_ns - origin_ns) / 1000.0, (event.end_ns - event.begin_ns) / 1000.0, separator);
+	}
+	fprintf(fp, "]}\n");
+	return fclose(fp) == 0;
+}
+
+void ad_trace_log::hook(void* user, const char* name, uint32_t thread_id, uint64_t begin_ns, uint64_t end_ns)
+{
+	reinterpret_cast<ad_trace_log*>(user)->add(name, thread_id, begin_ns, end_ns);
+}
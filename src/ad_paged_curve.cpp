@@ -0,0 +1,521 @@
+#include "ad_paged_curve.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <algorithm>
+
+#include "ad_instrument.h"
+
+static size_t page_block_size(size_t stride)
+{
+	return sizeof(ad_curve_page) + AD_CURVE_PAGE_KEYS * (1 + stride) * sizeof(float);
+}
+
+static size_t snapshot_block_size(size_t page_capacity)
+{
+	return sizeof(ad_curve_snapshot) + page_capacity * (sizeof(ad_curve_page*) + sizeof(float));
+}
+
+ad_curve_page::ad_curve_page(float* in_times, float* in_values)
+	: refcount(1)
+	, num_keys(0)
+	, times(in_times)
+	, values(in_values)
+{
+}
+
+ad_curve_page* ad_curve_page::create(size_t stride, const ad_allocator* allocator)
+{
+	// Allocate the page header, times and values in a single block
+	static_assert(sizeof(ad_curve_page) % alignof(float) == 0, "times must be aligned");
+	uint8_t* block = reinterpret_cast<uint8_t*>(allocator->allocate(page_block_size(stride)));
+	if (!block)
+	{
+		return nullptr;
+	}
+	float* times = reinterpret_cast<float*>(block + sizeof(ad_curve_page));
+	return new (block) ad_curve_page(times, times + AD_CURVE_PAGE_KEYS);
+}
+
+ad_curve_page* ad_curve_page::clone(const ad_curve_page* source, size_t stride, const ad_allocator* allocator)
+{
+	ad_curve_page* page = create(stride, allocator);
+	if (page)
+	{
+		page->num_keys = source->num_keys;
+		memcpy(page->times, source->times, source->num_keys * sizeof(float));
+		memcpy(page->values, source->values, source->num_keys * stride * sizeof(float));
+	}
+	return page;
+}
+
+void ad_curve_page::release(ad_curve_page* page, size_t stride, const ad_allocator* allocator)
+{
+	// Whoever drops the last reference frees the page, having seen every write to it
+	if (page->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		page->~ad_curve_page();
+		allocator->deallocate(page, page_block_size(stride));
+	}
+}
+
+ad_curve_snapshot::ad_curve_snapshot(size_t in_cardinality, size_t in_stride, ad_interp in_interp, size_t in_page_capacity, const ad_allocator* in_allocator)
+	: refcount(1)
+	, cardinality(in_cardinality)
+	, stride(in_stride)
+	, interp(in_interp)
+	, num_keys(0)
+	, num_pages(0)
+	, page_capacity(in_page_capacity)
+	, pages(nullptr)
+	, page_first_times(nullptr)
+	, allocator(in_allocator)
+{
+}
+
+ad_curve_snapshot* ad_curve_snapshot::create(size_t cardinality, size_t stride, ad_interp interp, size_t page_capacity, const ad_allocator* allocator)
+{
+	// Allocate the snapshot header and its page table in a single block
+	assert(page_capacity > 0);
+	static_assert(sizeof(ad_curve_snapshot) % alignof(ad_curve_page*) == 0, "pages must be aligned");
+	uint8_t* block = reinterpret_cast<uint8_t*>(allocator->allocate(snapshot_block_size(page_capacity)));
+	if (!block)
+	{
+		return nullptr;
+	}
+	ad_curve_snapshot* snapshot = new (block) ad_curve_snapshot(cardinality, stride, interp, page_capacity, allocator);
+	snapshot->pages = reinterpret_cast<ad_curve_page**>(block + sizeof(ad_curve_snapshot));
+	snapshot->page_first_times = reinterpret_cast<float*>(snapshot->pages + page_capacity);
+	return snapshot;
+}
+
+void ad_curve_snapshot::destroy(ad_curve_snapshot* snapshot)
+{
+	// Frees the snapshot's own block, without touching the pages it refers to
+	const ad_allocator* allocator = snapshot->allocator;
+	const size_t block_size = snapshot_block_size(snapshot->page_capacity);
+	snapshot->~ad_curve_snapshot();
+	allocator->deallocate(snapshot, block_size);
+}
+
+void ad_curve_snapshot::retain() const
+{
+	refcount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ad_curve_snapshot::release() const
+{
+	if (refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		for (size_t i = 0; i < num_pages; i++)
+		{
+			ad_curve_page::release(pages[i], stride, allocator);
+		}
+		destroy(const_cast<ad_curve_snapshot*>(this));
+	}
+}
+
+int32_t ad_curve_snapshot::find_page(float at_time) const
+{
+	return ad_find_nearest_lte(page_first_times, num_pages, at_time);
+}
+
+bool ad_curve_snapshot::evaluate(float time, float* out_value) const
+{
+	const int32_t page_i = find_page(time);
+	const int32_t key_i = page_i >= 0 ? ad_find_nearest_lte(pages[page_i]->times, pages[page_i]->num_keys, time) : -1;
+	return evaluate_at(page_i, key_i, time, out_value);
+}
+
+bool ad_curve_snapshot::evaluate_many(const float* in_times, size_t n, float* out_values) const
+{
+	// Walk a cursor through the requested times: if they're sorted, each lookup only
+	// needs to step forward from the last key we found, which is usually on the same page
+	int32_t page_i = -1;
+	int32_t key_i = -1;
+	for (size_t i = 0; i < n; i++)
+	{
+		const float time = in_times[i];
+		const bool same_page = page_i >= 0 && page_first_times[page_i] <= time && (static_cast<size_t>(page_i) + 1 == num_pages || page_first_times[page_i + 1] > time);
+		if (!same_page)
+		{
+			page_i = find_page(time);
+			key_i = -1;
+		}
+		if (page_i >= 0)
+		{
+			const ad_curve_page* page = pages[page_i];
+			key_i = ad_find_nearest_lte_from(page->times, page->num_keys, time, key_i);
+		}
+		if (!evaluate_at(page_i, key_i, time, out_values + i * cardinality))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ad_curve_snapshot::evaluate_at(int32_t page_i, int32_t key_i, float time, float* out_value) const
+{
+	// An empty curve has no value at any time, and before the first key, we hold its value
+	if (num_keys == 0)
+	{
+		return false;
+	}
+	if (page_i < 0)
+	{
+		memcpy(out_value, pages[0]->values, sizeof(float) * cardinality);
+		return true;
+	}
+
+	// The following key may start the next page: past the last key, hold its value
+	const ad_curve_page* page = pages[page_i];
+	const float* value_a = page->values + key_i * stride;
+	const ad_curve_page* next_page = page;
+	int32_t next_i = key_i + 1;
+	if (next_i == static_cast<int32_t>(page->num_keys))
+	{
+		if (static_cast<size_t>(page_i) + 1 == num_pages)
+		{
+			memcpy(out_value, value_a, sizeof(float) * cardinality);
+			return true;
+		}
+		next_page = pages[page_i + 1];
+		next_i = 0;
+	}
+	return ad_evaluate_segment(interp, cardinality, page->times[key_i], value_a, next_page->times[next_i], next_page->values + next_i * stride, time, out_value);
+}
+
+ad_paged_curve::ad_paged_curve(size_t in_cardinality, ad_interp in_interp, const ad_allocator* in_allocator)
+	: cardinality(in_cardinality)
+	, stride(in_interp == ad_interp::hermite ? in_cardinality * 2 : in_cardinality)
+	, interp(in_interp)
+	, allocator(in_allocator)
+	, table(nullptr)
+{
+	assert(cardinality > 0);
+	assert(allocator);
+}
+
+ad_paged_curve::~ad_paged_curve()
+{
+	// Snapshots we've handed out hold their own references, and outlive us if need be
+	if (table)
+	{
+		table->release();
+	}
+}
+
+bool ad_paged_curve::init()
+{
+	assert(!table);
+	table = ad_curve_snapshot::create(cardinality, stride, interp, 1, allocator);
+	return table != nullptr;
+}
+
+bool ad_paged_curve::assign(const ad_curve& source)
+{
+	// Replace our keys with a copy of the source curve's, packed into full pages
+	assert(table);
+	assert(source.cardinality == cardinality && source.stride == stride);
+	const size_t num_pages = (source.num_keys + AD_CURVE_PAGE_KEYS - 1) / AD_CURVE_PAGE_KEYS;
+	ad_curve_snapshot* new_table = ad_curve_snapshot::create(cardinality, stride, interp, num_pages > 0 ? num_pages : 1, allocator);
+	if (!new_table)
+	{
+		return false;
+	}
+	for (size_t page_i = 0; page_i < num_pages; page_i++)
+	{
+		ad_curve_page* page = ad_curve_page::create(stride, allocator);
+		if (!page)
+		{
+			new_table->release();
+			return false;
+		}
+		const size_t first_key = page_i * AD_CURVE_PAGE_KEYS;
+		page->num_keys = static_cast<uint32_t>(std::min(static_cast<size_t>(AD_CURVE_PAGE_KEYS), source.num_keys - first_key));
+		for (size_t i = 0; i < page->num_keys; i++)
+		{
+			page->times[i] = source.key_time(first_key + i);
+		}
+		memcpy(page->values, source.values.data + first_key * stride, page->num_keys * stride * sizeof(float));
+		new_table->pages[page_i] = page;
+		new_table->page_first_times[page_i] = page->times[0];
+		new_table->num_pages++;
+		new_table->num_keys += page->num_keys;
+	}
+	table->release();
+	table = new_table;
+	return true;
+}
+
+bool ad_paged_curve::evaluate(float time, float* out_value) const
+{
+	return table->evaluate(time, out_value);
+}
+
+bool ad_paged_curve::evaluate_many(const float* in_times, size_t n, float* out_values) const
+{
+	AD_TRACE_SCOPE("ad_paged_curve::evaluate_many");
+	return table->evaluate_many(in_times, n, out_values);
+}
+
+const ad_curve_snapshot* ad_paged_curve::snapshot() const
+{
+	// Once shared, our table is immutable: our next edit will fork it
+	table->retain();
+	return table;
+}
+
+static bool fork_table(ad_paged_curve& curve)
+{
+	// If our table has been shared as a snapshot, it's immutable: fork a private copy of
+	// it, which shares all of its pages (and never touches the original's refcounts, so
+	// this is safe whether or not readers still hold the original)
+	const ad_curve_snapshot* source = curve.table;
+	if (source->refcount.load(std::memory_order_acquire) == 1)
+	{
+		return true;
+	}
+	ad_curve_snapshot* table = ad_curve_snapshot::create(curve.cardinality, curve.stride, curve.interp, source->num_pages + 1, curve.allocator);
+	if (!table)
+	{
+		return false;
+	}
+	table->num_keys = source->num_keys;
+	table->num_pages = source->num_pages;
+	memcpy(table->pages, source->pages, source->num_pages * sizeof(ad_curve_page*));
+	memcpy(table->page_first_times, source->page_first_times, source->num_pages * sizeof(float));
+	for (size_t i = 0; i < table->num_pages; i++)
+	{
+		table->pages[i]->refcount.fetch_add(1, std::memory_order_relaxed);
+	}
+	source->release();
+	curve.table = table;
+	return true;
+}
+
+static ad_curve_page* make_page_writable(ad_paged_curve& curve, size_t page_i)
+{
+	// A page that only our table refers to can be edited in place: otherwise, it may be
+	// in use by readers, so we clone it before releasing our reference to the original
+	ad_curve_page* page = curve.table->pages[page_i];
+	if (page->refcount.load(std::memory_order_acquire) == 1)
+	{
+		return page;
+	}
+	ad_curve_page* copy = ad_curve_page::clone(page, curve.stride, curve.allocator);
+	if (copy)
+	{
+		ad_curve_page::release(page, curve.stride, curve.allocator);
+		curve.table->pages[page_i] = copy;
+	}
+	return copy;
+}
+
+static bool reserve_page(ad_paged_curve& curve)
+{
+	// Grow our page table if it's full: it's private, so we can move its page references
+	// to a larger table without touching their refcounts
+	ad_curve_snapshot* table = curve.table;
+	if (table->num_pages == table->page_capacity)
+	{
+		ad_curve_snapshot* grown = ad_curve_snapshot::create(curve.cardinality, curve.stride, curve.interp, table->page_capacity * 2, curve.allocator);
+		if (!grown)
+		{
+			return false;
+		}
+		grown->num_keys = table->num_keys;
+		grown->num_pages = table->num_pages;
+		memcpy(grown->pages, table->pages, table->num_pages * sizeof(ad_curve_page*));
+		memcpy(grown->page_first_times, table->page_first_times, table->num_pages * sizeof(float));
+		ad_curve_snapshot::destroy(table);
+		curve.table = grown;
+	}
+	return true;
+}
+
+static void insert_page(ad_paged_curve& curve, size_t page_i, ad_curve_page* page)
+{
+	// Shift the following pages right to make room, which reserve_page must have ensured
+	ad_curve_snapshot* table = curve.table;
+	assert(table->num_pages < table->page_capacity);
+	const size_t num_after = table->num_pages - page_i;
+	memmove(table->pages + page_i + 1, table->pages + page_i, num_after * sizeof(ad_curve_page*));
+	memmove(table->page_first_times + page_i + 1, table->page_first_times + page_i, num_after * sizeof(float));
+	table->pages[page_i] = page;
+	table->page_first_times[page_i] = page->num_keys > 0 ? page->times[0] : 0.0f;
+	table->num_pages++;
+}
+
+static void write_page_key(ad_curve_page* page, size_t key_i, size_t cardinality, size_t stride, const float* value, const float* tangent)
+{
+	// Each key stores its value, followed by its tangent if the curve has room for one
+	float* dst = page->values + key_i * stride;
+	memcpy(dst, value, sizeof(float) * cardinality);
+	if (stride > cardinality)
+	{
+		if (tangent)
+		{
+			memcpy(dst + cardinality, tangent, sizeof(float) * cardinality);
+		}
+		else
+		{
+			memset(dst + cardinality, 0, sizeof(float) * cardinality);
+		}
+	}
+}
+
+bool ad_paged_curve::set(float time, const float* value, const float* tangent)
+{
+	AD_TRACE_SCOPE("ad_paged_curve::set");
+	if (!fork_table(*this))
+	{
+		return false;
+	}
+
+	// The first key in an empty curve gets a page of its own
+	if (table->num_pages == 0)
+	{
+		ad_curve_page* page = ad_curve_page::create(stride, allocator);
+		if (!page || !reserve_page(*this))
+		{
+			if (page)
+			{
+				ad_curve_page::release(page, stride, allocator);
+			}
+			return false;
+		}
+		insert_page(*this, 0, page);
+	}
+
+	// Find the page this time belongs to: any time before the first key goes in page 0
+	const int32_t found_page_i = table->find_page(time);
+	size_t page_i = found_page_i >= 0 ? static_cast<size_t>(found_page_i) : 0;
+	ad_curve_page* page = table->pages[page_i];
+	const int32_t key_i = ad_find_nearest_lte(page->times, page->num_keys, time);
+
+	// Overwrite an existing key at this exact time
+	if (key_i >= 0 && page->times[key_i] == time)
+	{
+		page = make_page_writable(*this, page_i);
+		if (!page)
+		{
+			return false;
+		}
+		write_page_key(page, key_i, cardinality, stride, value, tangent);
+		return true;
+	}
+
+	// If the page is full, make room: appending past the end of the last page starts a
+	// new page, so that keys recorded in order fill each page, and otherwise we split the
+	// page in half, moving its upper half to a new page that follows it
+	size_t insert_i = static_cast<size_t>(key_i + 1);
+	if (page->num_keys == AD_CURVE_PAGE_KEYS)
+	{
+		const size_t half = AD_CURVE_PAGE_KEYS / 2;
+		const bool is_append = insert_i == AD_CURVE_PAGE_KEYS && page_i + 1 == table->num_pages;
+		ad_curve_page* new_page = ad_curve_page::create(stride, allocator);
+		if (!new_page)
+		{
+			return false;
+		}
+
+		// Make room in the table before we truncate the original page, so that nothing
+		// can fail once its upper half lives only in the new page
+		if (!reserve_page(*this))
+		{
+			ad_curve_page::release(new_page, stride, allocator);
+			return false;
+		}
+		if (!is_append)
+		{
+			// Copy the upper half before we release our reference to the original page
+			new_page->num_keys = AD_CURVE_PAGE_KEYS - half;
+			memcpy(new_page->times, page->times + half, new_page->num_keys * sizeof(float));
+			memcpy(new_page->values, page->values + half * stride, new_page->num_keys * stride * sizeof(float));
+			page = make_page_writable(*this, page_i);
+			if (!page)
+			{
+				ad_curve_page::release(new_page, stride, allocator);
+				return false;
+			}
+			page->num_keys = half;
+		}
+		insert_page(*this, page_i + 1, new_page);
+		if (is_append || insert_i > half)
+		{
+			insert_i -= is_append ? AD_CURVE_PAGE_KEYS : half;
+			page_i++;
+			page = new_page;
+		}
+	}
+	else
+	{
+		page = make_page_writable(*this, page_i);
+		if (!page)
+		{
+			return false;
+		}
+	}
+
+	// Shift the keys after the insertion point right, and write the new key in their place
+	const size_t num_after = page->num_keys - insert_i;
+	memmove(page->times + insert_i + 1, page->times + insert_i, num_after * sizeof(float));
+	memmove(page->values + (insert_i + 1) * stride, page->values + insert_i * stride, num_after * stride * sizeof(float));
+	page->times[insert_i] = time;
+	write_page_key(page, insert_i, cardinality, stride, value, tangent);
+	page->num_keys++;
+	table->page_first_times[page_i] = page->times[0];
+	table->num_keys++;
+	return true;
+}
+
+bool ad_paged_curve::remove_at(float time)
+{
+	AD_TRACE_SCOPE("ad_paged_curve::remove_at");
+
+	// Look for the key before forking our table, so that a remove that doesn't find a
+	// key won't copy anything
+	const int32_t page_i = table->find_page(time);
+	if (page_i < 0)
+	{
+		return true;
+	}
+	const ad_curve_page* found_page = table->pages[page_i];
+	const int32_t key_i = ad_find_nearest_lte(found_page->times, found_page->num_keys, time);
+	if (found_page->times[key_i] != time)
+	{
+		return true;
+	}
+
+	// A forked table has the same page layout as the original
+	if (!fork_table(*this))
+	{
+		return false;
+	}
+	ad_curve_page* page = make_page_writable(*this, page_i);
+	if (!page)
+	{
+		return false;
+	}
+
+	// Shift the following keys left over the removed key, dropping the page if it's empty
+	const size_t num_after = page->num_keys - key_i - 1;
+	memmove(page->times + key_i, page->times + key_i + 1, num_after * sizeof(float));
+	memmove(page->values + key_i * stride, page->values + (key_i + 1) * stride, num_after * stride * sizeof(float));
+	page->num_keys--;
+	table->num_keys--;
+	if (page->num_keys > 0)
+	{
+		table->page_first_times[page_i] = page->times[0];
+		return true;
+	}
+	ad_curve_page::release(page, stride, allocator);
+	const size_t num_pages_after = table->num_pages - page_i - 1;
+	memmove(table->pages + page_i, table->pages + page_i + 1, num_pages_after * sizeof(ad_curve_page*));
+	memmove(table->page_first_times + page_i, table->page_first_times + page_i + 1, num_pages_after * sizeof(float));
+	table->num_pages--;
+	return true;
+}
@@ -0,0 +1,390 @@
+#include "ad_thread_pool.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+#if AD_THREADS
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+#include "ad_instrument.h"
+
+static inline uint64_t pack_range(uint64_t begin, uint64_t end)
+{
+	return (begin << 32) | end;
+}
+
+struct ad_thread_pool_state
+{
+	ad_task_range* ranges; // One per participating thread: the caller's is at index 0
+	void* ranges_block; // Allocation holding ranges, padded so they can be cache-aligned
+	ad_task_fn fn;
+	void* user;
+	std::atomic<size_t> num_busy; // Workers that haven't yet finished the current run
+#if AD_THREADS
+	std::thread* threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	uint64_t generation; // Incremented (under mutex) to start each run
+	bool stopping;
+#endif
+};
+
+static bool pop_task(ad_task_range& slot, size_t& out_task_i)
+{
+	// Take the task at the front of our own range
+	uint64_t range = slot.range.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const uint64_t begin = range >> 32;
+		const uint64_t end = range & 0xffffffffu;
+		if (begin >= end)
+		{
+			return false;
+		}
+		if (slot.range.compare_exchange_weak(range, pack_range(begin + 1, end), std::memory_order_acq_rel))
+		{
+			out_task_i = static_cast<size_t>(begin);
+			return true;
+		}
+	}
+}
+
+static bool steal_tasks(ad_task_range& victim, uint64_t& out_begin, uint64_t& out_end)
+{
+	// Take the back half of another thread's range, rounding up so we can steal its last task
+	uint64_t range = victim.range.load(std::memory_order_acquire);
+	for (;;)
+	{
+		const uint64_t begin = range >> 32;
+		const uint64_t end = range & 0xffffffffu;
+		if (begin >= end)
+		{
+			return false;
+		}
+		const uint64_t num_taken = (end - begin + 1) / 2;
+		if (victim.range.compare_exchange_weak(range, pack_range(begin, end - num_taken), std::memory_order_acq_rel))
+		{
+			out_begin = end - num_taken;
+			out_end = end;
+			return true;
+		}
+	}
+}
+
+static void work(ad_thread_pool_state* state, size_t num_slots, size_t slot_i)
+{
+	ad_task_range& own = state->ranges[slot_i];
+	for (;;)
+	{
+		// Run everything in our own range
+		size_t task_i;
+		while (pop_task(own, task_i))
+		{
+			state->fn(state->user, task_i);
+		}
+
+		// Then look for another thread with tasks left, starting with our neighbor, and
+		// move what we steal into our own range, where it can be stolen from us in turn
+		bool stole = false;
+		for (size_t offset = 1; offset < num_slots && !stole; offset++)
+		{
+			uint64_t begin;
+			uint64_t end;
+			if (steal_tasks(state->ranges[(slot_i + offset) % num_slots], begin, end))
+			{
+				own.range.store(pack_range(begin, end), std::memory_order_release);
+				stole = true;
+			}
+		}
+		if (!stole)
+		{
+			return;
+		}
+	}
+}
+
+#if AD_THREADS
+static void worker_main(ad_thread_pool_state* state, size_t num_slots, size_t slot_i)
+{
+	uint64_t seen_generation = 0;
+	for (;;)
+	{
+		// Sleep until there's a new run to take part in, or we're told to stop
+		{
+			std::unique_lock<std::mutex> lock(state->mutex);
+			state->wake.wait(lock, [state, seen_generation]() { return state->stopping || state->generation != seen_generation; });
+			if (state->stopping)
+			{
+				return;
+			}
+			seen_generation = state->generation;
+		}
+
+		work(state, num_slots, slot_i);
+		state->num_busy.fetch_sub(1, std::memory_order_acq_rel);
+	}
+}
+#endif
+
+size_t ad_default_num_workers()
+{
+#if AD_THREADS
+	const size_t num_hardware_threads = std::thread::hardware_concurrency();
+	return num_hardware_threads > 1 ? num_hardware_threads - 1 : 0;
+#else
+	return 0;
+#endif
+}
+
+ad_thread_pool::ad_thread_pool(size_t in_num_workers, const ad_allocator* in_allocator)
+	: num_workers(AD_THREADS ? in_num_workers : 0)
+	, allocator(in_allocator)
+	, state(nullptr)
+{
+}
+
+ad_thread_pool::~ad_thread_pool()
+{
+	if (!state)
+	{
+		return;
+	}
+
+#if AD_THREADS
+	// Wake every worker so that it can exit, then wait for each one
+	if (state->threads)
+	{
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->stopping = true;
+		}
+		state->wake.notify_all();
+		for (size_t i = 0; i < num_workers; i++)
+		{
+			if (state->threads[i].joinable())
+			{
+				state->threads[i].join();
+			}
+			state->threads[i].~thread();
+		}
+		allocator->deallocate(state->threads, num_workers * sizeof(std::thread));
+	}
+#endif
+	if (state->ranges_block)
+	{
+		allocator->deallocate(state->ranges_block, (num_workers + 1) * sizeof(ad_task_range) + AD_CACHE_LINE_SIZE);
+	}
+	state->~ad_thread_pool_state();
+	allocator->deallocate(state, sizeof(ad_thread_pool_state));
+}
+
+bool ad_thread_pool::init()
+{
+	// We should not yet be initialized
+	assert(!state);
+	void* state_block = allocator->allocate(sizeof(ad_thread_pool_state));
+	if (!state_block)
+	{
+		return false;
+	}
+	state = new (state_block) ad_thread_pool_state();
+	state->ranges = nullptr;
+	state->ranges_block = nullptr;
+	state->fn = nullptr;
+	state->user = nullptr;
+	state->num_busy.store(0);
+#if AD_THREADS
+	state->threads = nullptr;
+	state->generation = 0;
+	state->stopping = false;
+#endif
+
+	// Each range gets a cache line of its own, so that threads don't contend for them
+	// except when stealing: allocators needn't return cache-aligned blocks, so we pad
+	// the block and align within it
+	const size_t num_slots = num_workers + 1;
+	state->ranges_block = allocator->allocate(num_slots * sizeof(ad_task_range) + AD_CACHE_LINE_SIZE);
+	if (!state->ranges_block)
+	{
+		return false;
+	}
+	const uintptr_t block_address = reinterpret_cast<uintptr_t>(state->ranges_block);
+	const uintptr_t aligned_address = (block_address + AD_CACHE_LINE_SIZE - 1) & ~static_cast<uintptr_t>(AD_CACHE_LINE_SIZE - 1);
+	state->ranges = reinterpret_cast<ad_task_range*>(aligned_address);
+	for (size_t i = 0; i < num_slots; i++)
+	{
+		new (&state->ranges[i]) ad_task_range();
+		state->ranges[i].range.store(0);
+	}
+
+#if AD_THREADS
+	if (num_workers > 0)
+	{
+		state->threads = reinterpret_cast<std::thread*>(allocator->allocate(num_workers * sizeof(std::thread)));
+		if (!state->threads)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < num_workers; i++)
+		{
+			new (&state->threads[i]) std::thread(worker_main, state, num_slots, i + 1);
+		}
+	}
+#endif
+	return true;
+}
+
+void ad_thread_pool::run(ad_task_fn fn, void* user, size_t num_tasks)
+{
+	AD_TRACE_SCOPE("ad_thread_pool::run");
+	assert(state);
+	assert(num_tasks <= UINT32_MAX);
+	if (num_tasks == 0)
+	{
+		return;
+	}
+
+	// With no workers (or only one task), there's nothing to coordinate
+	if (num_workers == 0 || num_tasks == 1)
+	{
+		for (size_t task_i = 0; task_i < num_tasks; task_i++)
+		{
+			fn(user, task_i);
+		}
+		return;
+	}
+
+#if AD_THREADS
+	// Deal out an even share of tasks to each thread, then start the workers
+	const size_t num_slots = num_workers + 1;
+	state->fn = fn;
+	state->user = user;
+	for (size_t slot_i = 0; slot_i < num_slots; slot_i++)
+	{
+		const uint64_t begin = num_tasks * slot_i / num_slots;
+		const uint64_t end = num_tasks * (slot_i + 1) / num_slots;
+		state->ranges[slot_i].range.store(pack_range(begin, end), std::memory_order_relaxed);
+	}
+	state->num_busy.store(num_workers, std::memory_order_relaxed);
+	{
+		std::lock_guard<std::mutex> lock(state->mutex);
+		state->generation++;
+	}
+	state->wake.notify_all();
+
+	// Work alongside the workers, then wait for the last of them to finish: once our own
+	// stealing comes up empty, every remaining task is already running on some worker
+	work(state, num_slots, 0);
+	while (state->num_busy.load(std::memory_order_acquire) > 0)
+	{
+		std::this_thread::yield();
+	}
+#endif
+}
+
+struct ad_eval_batches
+{
+	const ad_eval_job* jobs;
+	const size_t* boundaries; // Index of the first job in each batch, plus num_jobs
+	std::atomic<bool> ok;
+};
+
+static void evaluate_batch(void* user, size_t batch_i)
+{
+	AD_TRACE_SCOPE("evaluate_batch");
+	ad_eval_batches* batches = reinterpret_cast<ad_eval_batches*>(user);
+	bool ok = true;
+	for (size_t job_i = batches->boundaries[batch_i]; job_i < batches->boundaries[batch_i + 1]; job_i++)
+	{
+		const ad_eval_job& job = batches->jobs[job_i];
+		ok = job.curve->evaluate(job.time, job.out_value) && ok;
+	}
+	if (!ok)
+	{
+		batches->ok.store(false, std::memory_order_relaxed);
+	}
+}
+
+static uintptr_t cache_line_of(const float* ptr)
+{
+	return reinterpret_cast<uintptr_t>(ptr) / AD_CACHE_LINE_SIZE;
+}
+
+bool ad_evaluate_jobs(ad_thread_pool* pool, const ad_eval_job* jobs, size_t num_jobs, size_t batch_size)
+{
+	AD_TRACE_SCOPE("ad_evaluate_jobs");
+	assert(batch_size > 0);
+	if (num_jobs == 0)
+	{
+		return true;
+	}
+
+	// Build any search indexes that lookups would need up front: lookups on several
+	// threads can build them safely, but until one thread finishes, the rest search the
+	// slower way
+	for (size_t job_i = 0; job_i < num_jobs; job_i++)
+	{
+		const ad_curve* curve = jobs[job_i].curve;
+		if (!curve->uniform && curve->times.size >= curve->search_index_threshold)
+		{
+			curve->build_search_index();
+		}
+	}
+
+	// Split the jobs into batches, nudging each boundary forward until the jobs on either
+	// side write to different cache lines
+	const size_t max_batches = (num_jobs + batch_size - 1) / batch_size;
+	size_t* boundaries = reinterpret_cast<size_t*>(malloc((max_batches + 1) * sizeof(size_t)));
+	if (!boundaries)
+	{
+		return false;
+	}
+	size_t num_batches = 0;
+	boundaries[0] = 0;
+	for (size_t batch_i = 1; batch_i < max_batches; batch_i++)
+	{
+		size_t boundary = batch_i * batch_size;
+		if (boundary <= boundaries[num_batches])
+		{
+			continue;
+		}
+		while (boundary < num_jobs)
+		{
+			const ad_eval_job& prev = jobs[boundary - 1];
+			const float* prev_last = prev.out_value + prev.curve->cardinality - 1;
+			if (cache_line_of(prev_last) != cache_line_of(jobs[boundary].out_value))
+			{
+				break;
+			}
+			boundary++;
+		}
+		if (boundary >= num_jobs)
+		{
+			break;
+		}
+		boundaries[++num_batches] = boundary;
+	}
+	boundaries[++num_batches] = num_jobs;
+
+	ad_eval_batches batches;
+	batches.jobs = jobs;
+	batches.boundaries = boundaries;
+	batches.ok.store(true);
+	if (pool)
+	{
+		pool->run(evaluate_batch, &batches, num_batches);
+	}
+	else
+	{
+		for (size_t batch_i = 0; batch_i < num_batches; batch_i++)
+		{
+			evaluate_batch(&batches, batch_i);
+		}
+	}
+
+	free(boundaries);
+	return batches.ok.load();
+}
@@ -1,15 +1,140 @@
 #ifdef __EMSCRIPTEN__
 
 #include <emscripten/bind.h>
+#include <emscripten/val.h>
 
 #include "ad_buffer.h"
+#include "ad_curve.h"
+#include "ad_input_recorder.h"
+
+// Typed arrays returned from these bindings are views directly into the wasm heap, so
+// they're only valid until the memory they view is reallocated: re-fetch a view after any
+// edit that may grow the underlying buffer, or after the heap itself grows. Batched calls
+// take heap addresses (e.g. from ad_buffer.ptr()) rather than JS arrays, so that data can
+// be written into the heap once and handed over without any per-element calls.
+
+static emscripten::val float_view(const float* data, size_t n)
+{
+	return emscripten::val(emscripten::typed_memory_view(n, data));
+}
+
+static const float* heap_floats(uintptr_t address)
+{
+	return reinterpret_cast<const float*>(address);
+}
+
+static emscripten::val buffer_view(const ad_buffer& buffer)
+{
+	// The full capacity is writable, so that JS can fill a reserved buffer before use
+	return float_view(buffer.data, buffer.capacity);
+}
+
+static uintptr_t buffer_ptr(const ad_buffer& buffer)
+{
+	return reinterpret_cast<uintptr_t>(buffer.data);
+}
+
+static emscripten::val curve_times(const ad_curve& curve)
+{
+	return float_view(curve.times.data, curve.uniform ? 0 : curve.num_keys);
+}
+
+static emscripten::val curve_values(const ad_curve& curve)
+{
+	return float_view(curve.values.data, curve.num_keys * curve.stride);
+}
+
+static bool curve_set(ad_curve& curve, float time, uintptr_t value)
+{
+	return curve.set(time, heap_floats(value));
+}
+
+static bool curve_set_many(ad_curve& curve, uintptr_t times, uintptr_t values, size_t n, ad_merge_policy policy)
+{
+	return curve.set_many(heap_floats(times), heap_floats(values), n, policy);
+}
+
+static bool curve_evaluate(const ad_curve& curve, float time, uintptr_t out_value)
+{
+	return curve.evaluate(time, reinterpret_cast<float*>(out_value));
+}
+
+static bool curve_evaluate_many(const ad_curve& curve, uintptr_t times, size_t n, uintptr_t out_values)
+{
+	return curve.evaluate_many(heap_floats(times), n, reinterpret_cast<float*>(out_values));
+}
+
+static emscripten::val reader_peek(ad_input_record_reader& reader)
+{
+	// Each sample is a (time, value) pair of floats, so samples read as an interleaved
+	// Float32Array of twice as many floats
+	static_assert(sizeof(ad_input_sample) == 2 * sizeof(float), "samples must be two packed floats");
+	const ad_input_sample* samples = nullptr;
+	const size_t n = reader.peek(samples);
+	return float_view(reinterpret_cast<const float*>(samples), n * 2);
+}
+
+static bool bake_reader_to_curve(ad_input_record_reader& reader, ad_curve& curve)
+{
+	return ad_bake_to_curve(reader, curve);
+}
 
 EMSCRIPTEN_BINDINGS(animdata) {
+	emscripten::enum_<ad_interp>("ad_interp")
+        .value("constant", ad_interp::constant)
+        .value("linear", ad_interp::linear)
+        .value("hermite", ad_interp::hermite)
+        .value("nlerp", ad_interp::nlerp)
+        .value("slerp", ad_interp::slerp)
+    ;
+
+	emscripten::enum_<ad_merge_policy>("ad_merge_policy")
+        .value("replace", ad_merge_policy::replace)
+        .value("keep", ad_merge_policy::keep)
+    ;
+
 	emscripten::class_<ad_buffer>("ad_buffer")
         .constructor()
         .property("size", &ad_buffer::size)
         .property("capacity", &ad_buffer::capacity)
         .function("init", &ad_buffer::init)
+        .function("reserve", &ad_buffer::reserve)
+        .function("view", &buffer_view)
+        .function("ptr", &buffer_ptr)
+    ;
+
+	emscripten::class_<ad_curve>("ad_curve")
+        .constructor<size_t, ad_interp>()
+        .property("cardinality", &ad_curve::cardinality)
+        .property("stride", &ad_curve::stride)
+        .property("num_keys", &ad_curve::num_keys)
+        .function("init", &ad_curve::init)
+        .function("reserve", &ad_curve::reserve)
+        .function("times", &curve_times)
+        .function("values", &curve_values)
+        .function("set", &curve_set)
+        .function("set_many", &curve_set_many)
+        .function("remove_at", &ad_curve::remove_at)
+        .function("remove_range", &ad_curve::remove_range)
+        .function("evaluate", &curve_evaluate)
+        .function("evaluate_many", &curve_evaluate_many)
+        .function("find_nearest_lte", &ad_curve::find_nearest_lte)
+    ;
+
+	emscripten::class_<ad_input_recorder>("ad_input_recorder")
+        .constructor<size_t, size_t>()
+        .property("tolerance", &ad_input_recorder::tolerance)
+        .function("init", &ad_input_recorder::init)
+        .function("reset", &ad_input_recorder::reset)
+        .function("handle_sample", &ad_input_recorder::handle_sample)
+        .function("flush", &ad_input_recorder::flush)
+    ;
+
+	emscripten::class_<ad_input_record_reader>("ad_input_record_reader")
+        .constructor<const ad_input_recorder&>()
+        .function("peek", &reader_peek)
+        .function("consume", &ad_input_record_reader::consume)
+        .function("bake_to_curve", &bake_reader_to_curve)
     ;
 }
 
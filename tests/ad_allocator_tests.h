@@ -0,0 +1,183 @@
+#pragma once
+
+#include "testing.h"
+#include "ad_allocator.h"
+#include "ad_buffer.h"
+#include "ad_curve.h"
+#include "ad_input_recorder.h"
+
+// A user allocator that forwards to malloc, counting outstanding blocks and bytes
+struct counting_allocator_state
+{
+	int num_blocks;
+	size_t num_bytes;
+};
+
+static void* counting_allocate(void* user, size_t size)
+{
+	counting_allocator_state* state = reinterpret_cast<counting_allocator_state*>(user);
+	state->num_blocks++;
+	state->num_bytes += size;
+	return malloc(size);
+}
+
+static void* counting_reallocate(void* user, void* ptr, size_t old_size, size_t new_size)
+{
+	counting_allocator_state* state = reinterpret_cast<counting_allocator_state*>(user);
+	state->num_blocks += ptr ? 0 : 1;
+	state->num_bytes += new_size - old_size;
+	return realloc(ptr, new_size);
+}
+
+static void counting_deallocate(void* user, void* ptr, size_t size)
+{
+	counting_allocator_state* state = reinterpret_cast<counting_allocator_state*>(user);
+	state->num_blocks--;
+	state->num_bytes -= size;
+	free(ptr);
+}
+
+const char* test_allocator_default()
+{
+	const ad_allocator* allocator = ad_default_allocator();
+	t_assert(allocator != nullptr);
+	t_assert(allocator == ad_default_allocator());
+
+	ad_buffer buf;
+	t_assert(buf.allocator == allocator);
+
+	float* ptr = reinterpret_cast<float*>(allocator->allocate(4 * sizeof(float)));
+	t_assert(ptr != nullptr);
+	ptr[3] = 42.f;
+	ptr = reinterpret_cast<float*>(allocator->reallocate(ptr, 4 * sizeof(float), 8 * sizeof(float)));
+	t_assert(ptr != nullptr);
+	t_assert(ptr[3] == 42.f);
+	allocator->deallocate(ptr, 8 * sizeof(float));
+
+	return nullptr;
+}
+
+const char* test_allocator_arena()
+{
+	ad_arena arena;
+	t_assert(arena.init(256));
+	t_assert(arena.capacity == 256);
+	t_assert(arena.used == 0);
+
+	// Blocks should be carved out in order, each aligned to 16 bytes
+	uint8_t* a = reinterpret_cast<uint8_t*>(arena.allocate(10));
+	uint8_t* b = reinterpret_cast<uint8_t*>(arena.allocate(20));
+	t_assert(a == arena.data);
+	t_assert(b == arena.data + 16);
+	t_assert(arena.used == 36);
+
+	// The most recent block can grow in place; older blocks have to move
+	t_assert(arena.reallocate(b, 20, 40) == b);
+	t_assert(arena.used == 56);
+	a[0] = 7;
+	uint8_t* moved_a = reinterpret_cast<uint8_t*>(arena.reallocate(a, 10, 12));
+	t_assert(moved_a == arena.data + 64);
+	t_assert(moved_a[0] == 7);
+
+	// Freeing the most recent block should give its space back
+	arena.deallocate(moved_a, 12);
+	t_assert(arena.used == 64);
+
+	// Requests that don't fit should fail, and a reset should make everything available
+	t_assert(arena.allocate(1000) == nullptr);
+	arena.reset();
+	t_assert(arena.used == 0);
+	t_assert(arena.allocate(256) == arena.data);
+
+	return nullptr;
+}
+
+const char* test_allocator_pool()
+{
+	ad_pool pool(16, 1024);
+	t_assert(pool.min_block_size == 16);
+
+	// Blocks of the same size class should be recycled in LIFO order
+	void* a = pool.allocate(10);
+	void* b = pool.allocate(16);
+	t_assert(a != nullptr && b != nullptr && a != b);
+	pool.deallocate(a, 10);
+	t_assert(pool.allocate(12) == a);
+
+	// Blocks that stay within their size class shouldn't move when reallocated
+	void* c = pool.allocate(100);
+	t_assert(pool.reallocate(c, 100, 128) == c);
+	void* d = pool.reallocate(c, 128, 129);
+	t_assert(d != c);
+	t_assert(pool.allocate(128) == c);
+
+	// Requests larger than the largest size class should go to the backing allocator
+	counting_allocator_state state = { 0, 0 };
+	const ad_allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, &state };
+	{
+		ad_pool backed_pool(16, 1024, &counting);
+		void* small = backed_pool.allocate(32);
+		t_assert(small != nullptr);
+		t_assert(state.num_blocks == 1);
+		void* large = backed_pool.allocate(16 << AD_POOL_NUM_CLASSES);
+		t_assert(large != nullptr);
+		t_assert(state.num_blocks == 2);
+		backed_pool.deallocate(large, 16 << AD_POOL_NUM_CLASSES);
+		t_assert(state.num_blocks == 1);
+	}
+	t_assert(state.num_blocks == 0);
+	t_assert(state.num_bytes == 0);
+
+	return nullptr;
+}
+
+const char* test_allocator_containers()
+{
+	counting_allocator_state state = { 0, 0 };
+	const ad_allocator counting = { counting_allocate, counting_reallocate, counting_deallocate, &state };
+	{
+		// Curves should allocate both of their buffers with the given allocator
+		ad_curve curve(2, ad_interp::linear, &counting);
+		t_assert(curve.times.allocator == &counting);
+		t_assert(curve.init(4));
+		t_assert(state.num_blocks == 2);
+		t_assert(state.num_bytes == 12 * sizeof(float));
+		const float v[2] = { 1.0f, 2.0f };
+		for (int i = 0; i < 10; i++) {
+			curve.set(static_cast<float>(i), v);
+		}
+		t_assert(state.num_blocks == 2);
+		t_assert(state.num_bytes == (curve.times.capacity + curve.values.capacity) * sizeof(float));
+
+		// Recorders should allocate their chunks with the given allocator, each chunk
+		// (header and samples) as a single block
+		ad_input_recorder recorder(4, 2, &counting);
+		t_assert(recorder.init());
+		t_assert(state.num_blocks == 4);
+		for (int i = 0; i < 8; i++) {
+			t_assert(recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)));
+		}
+		t_assert(state.num_blocks == 5);
+	}
+	t_assert(state.num_blocks == 0);
+	t_assert(state.num_bytes == 0);
+
+	// A whole curve can be carved from an arena, and released when the arena is reset
+	ad_arena arena;
+	t_assert(arena.init(4096));
+	{
+		ad_curve curve(1, ad_interp::constant, &arena.allocator);
+		t_assert(curve.init(8));
+		const float v = 1.0f;
+		for (int i = 0; i < 100; i++) {
+			curve.set(static_cast<float>(i), &v);
+		}
+		t_assert(curve.num_keys == 100);
+		t_assert(reinterpret_cast<uint8_t*>(curve.times.data) >= arena.data);
+		t_assert(reinterpret_cast<uint8_t*>(curve.times.data) < arena.data + arena.capacity);
+	}
+	arena.reset();
+	t_assert(arena.used == 0);
+
+	return nullptr;
+}
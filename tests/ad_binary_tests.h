@@ -0,0 +1,226 @@
+#pragma once
+
+#include "testing.h"
+#include "ad_binary.h"
+#include "ad_curve.h"
+#include "ad_clip.h"
+
+const char* test_binary_curve()
+{
+	// A hermite curve with 3 keys of cardinality 2
+	ad_curve curve(2, ad_interp::hermite);
+	t_assert(curve.init(4));
+	const float values[3][2] = { { 0.0f, 1.0f }, { 2.0f, 3.0f }, { 4.0f, 5.0f } };
+	const float tangents[3][2] = { { 1.0f, 0.0f }, { 2.0f, 0.0f }, { 1.0f, 0.0f } };
+	for (int i = 0; i < 3; i++) {
+		curve.set(static_cast<float>(i), values[i], tangents[i]);
+	}
+
+	// Each section should be padded to 16 bytes: header, curve header, 3 times, 3 keys
+	// of 4 floats
+	const size_t size = curve.binary_size();
+	t_assert(size == 16 + 16 + 16 + 48);
+	alignas(16) uint8_t blob[256];
+	t_assert(curve.write_binary(blob, size - 1) == 0);
+	t_assert(curve.write_binary(blob, sizeof(blob)) == size);
+
+	// Loading should borrow the blob's storage directly, and evaluate identically
+	ad_curve loaded(2, ad_interp::hermite);
+	t_assert(loaded.init_borrowed(blob, size));
+	t_assert(loaded.num_keys == 3);
+	t_assert(loaded.times.borrowed && loaded.values.borrowed);
+	t_assert(reinterpret_cast<uint8_t*>(loaded.times.data) == blob + 32);
+	t_assert(reinterpret_cast<uint8_t*>(loaded.values.data) == blob + 48);
+	float expected[2];
+	float actual[2];
+	for (int i = 0; i <= 8; i++) {
+		const float t = i * 0.25f;
+		t_assert(curve.evaluate(t, expected));
+		t_assert(loaded.evaluate(t, actual));
+		t_assert(expected[0] == actual[0] && expected[1] == actual[1]);
+	}
+
+	// Loading should fail for a mismatched curve, a truncated or misaligned blob, or
+	// a blob of another kind or version
+	ad_curve wrong_interp(2, ad_interp::linear);
+	t_assert(!wrong_interp.init_borrowed(blob, size));
+	ad_curve wrong_cardinality(1, ad_interp::hermite);
+	t_assert(!wrong_cardinality.init_borrowed(blob, size));
+	ad_curve truncated(2, ad_interp::hermite);
+	t_assert(!truncated.init_borrowed(blob, size - 16));
+	ad_curve misaligned(2, ad_interp::hermite);
+	memmove(blob + 4, blob, size);
+	t_assert(!misaligned.init_borrowed(blob + 4, size));
+	memmove(blob, blob + 4, size);
+	reinterpret_cast<ad_binary_header*>(blob)->version = AD_BINARY_VERSION + 1;
+	ad_curve wrong_version(2, ad_interp::hermite);
+	t_assert(!wrong_version.init_borrowed(blob, size));
+	t_assert(ad_binary_check(blob, size, ad_binary_kind::clip) == nullptr);
+
+	return nullptr;
+}
+
+const char* test_binary_clip()
+{
+	// A vec3 linear channel and a scalar constant channel, packed after a curve blob
+	ad_clip clip(2);
+	const size_t cardinalities[] = { 3, 1 };
+	const ad_interp interps[] = { ad_interp::linear, ad_interp::constant };
+	t_assert(clip.init(cardinalities, interps, 4));
+	const float pose_a[] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float pose_b[] = { 2.0f, 4.0f, 6.0f, 2.0f };
+	t_assert(clip.set(0.0f, pose_a));
+	t_assert(clip.set(1.0f, pose_b));
+
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init(1));
+	const float v = 7.0f;
+	curve.set(0.0f, &v);
+
+	alignas(16) uint8_t blob[512];
+	const size_t curve_size = curve.write_binary(blob, sizeof(blob));
+	t_assert(curve_size == 64);
+	const size_t clip_size = clip.write_binary(blob + curve_size, sizeof(blob) - curve_size);
+	t_assert(clip_size == clip.binary_size());
+	t_assert(clip_size % AD_BINARY_ALIGNMENT == 0);
+
+	// Both blobs should load from the packed buffer, with the clip's channel layout
+	// restored and its poses borrowed in place
+	ad_curve loaded_curve(1, ad_interp::linear);
+	t_assert(loaded_curve.init_borrowed(blob, curve_size));
+	ad_clip loaded(2);
+	t_assert(loaded.init_borrowed(blob + curve_size, clip_size));
+	t_assert(loaded.stride == 4);
+	t_assert(loaded.num_keys == 2);
+	t_assert(loaded.channels[1].offset == 3 && loaded.channels[1].cardinality == 1);
+	t_assert(loaded.channels[1].interp == ad_interp::constant);
+	t_assert(loaded.values.borrowed);
+	float pose[4];
+	t_assert(loaded.evaluate(0.5f, pose));
+	t_assert_floats(pose, 1.0f, 2.0f, 3.0f, 1.0f);
+
+	// A clip with a different number of channels can't load it
+	ad_clip wrong_channels(3);
+	t_assert(!wrong_channels.init_borrowed(blob + curve_size, clip_size));
+	ad_clip not_a_clip(2);
+	t_assert(!not_a_clip.init_borrowed(blob, curve_size));
+
+	return nullptr;
+}
+
+const char* test_binary_borrowed_is_read_only()
+{
+	// Build a curve and a clip, then borrow each from a blob
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init(4));
+	ad_clip clip(1);
+	const size_t cardinalities[] = { 1 };
+	const ad_interp interps[] = { ad_interp::linear };
+	t_assert(clip.init(cardinalities, interps, 4));
+	for (int i = 0; i < 4; i++) {
+		const float v = static_cast<float>(i);
+		t_assert(curve.set(static_cast<float>(i), &v));
+		t_assert(clip.set(static_cast<float>(i), &v));
+	}
+	alignas(16) uint8_t blob[512];
+	const size_t curve_size = curve.write_binary(blob, sizeof(blob));
+	const size_t clip_size = clip.write_binary(blob + curve_size, sizeof(blob) - curve_size);
+	t_assert(curve_size > 0 && clip_size > 0);
+	alignas(16) uint8_t original[512];
+	memcpy(original, blob, sizeof(blob));
+
+	ad_curve loaded(1, ad_interp::linear);
+	t_assert(loaded.init_borrowed(blob, curve_size));
+	t_assert(loaded.is_borrowed());
+	ad_clip loaded_clip(1);
+	t_assert(loaded_clip.init_borrowed(blob + curve_size, clip_size));
+
+	// Every edit should fail, whether it would overwrite, insert or remove keys
+	const float v = 9.0f;
+	const float many_times[2] = { 1.0f, 1.5f };
+	const float many_values[2] = { 9.0f, 9.0f };
+	t_assert(!loaded.set(1.0f, &v));
+	t_assert(!loaded.set(1.5f, &v));
+	t_assert(!loaded.set_many(many_times, many_values, 2));
+	t_assert(!loaded.remove_at(2.0f));
+	t_assert(loaded.remove_range(0.0f, 3.0f) == -1);
+	t_assert(!loaded.shift_range(0.0f, 1.0f, 0.5f));
+	t_assert(!loaded.scale_range(0.0f, 3.0f, 2.0f, 0.0f));
+	t_assert(!loaded.reduce(10.0f));
+	t_assert(!loaded.make_uniform());
+	t_assert(!loaded.reserve(16));
+	t_assert(!loaded_clip.set(1.0f, &v));
+	t_assert(!loaded_clip.set(1.5f, &v));
+	t_assert(!loaded_clip.remove_at(2.0f));
+	t_assert(!loaded_clip.reserve(16));
+
+	// The blob, and the borrowed curve's view of it, should be unchanged
+	t_assert(memcmp(original, blob, sizeof(blob)) == 0);
+	t_assert(loaded.num_keys == 4 && loaded_clip.num_keys == 4);
+	float out;
+	t_assert(loaded.evaluate(1.0f, &out));
+	t_assert(out == 1.0f);
+
+	return nullptr;
+}
+
+const char* test_binary_malicious_sizes()
+{
+	// Write a valid curve and clip, then corrupt their key and channel counts
+	ad_curve curve(4, ad_interp::hermite);
+	t_assert(curve.init(2));
+	const float value[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+	t_assert(curve.set(0.0f, value, value));
+	ad_clip clip(2);
+	const size_t cardinalities[] = { 1, 1 };
+	const ad_interp interps[] = { ad_interp::linear, ad_interp::linear };
+	t_assert(clip.init(cardinalities, interps, 2));
+	t_assert(clip.set(0.0f, value));
+	alignas(16) uint8_t curve_blob[256];
+	alignas(16) uint8_t clip_blob[256];
+	const size_t curve_size = curve.write_binary(curve_blob, sizeof(curve_blob));
+	const size_t clip_size = clip.write_binary(clip_blob, sizeof(clip_blob));
+	t_assert(curve_size > 0 && clip_size > 0);
+
+	// Key counts whose section sizes would wrap a 32-bit size_t (as on wasm32), or reach
+	// far beyond the blob on any platform, should be rejected before we read anything
+	ad_binary_curve_header* curve_header = reinterpret_cast<ad_binary_curve_header*>(curve_blob + sizeof(ad_binary_header));
+	const uint32_t bad_counts[] = { 0x08000000u, 0x10000000u, 0x40000000u, 0xffffffffu, 5 };
+	for (uint32_t bad_count : bad_counts) {
+		curve_header->num_keys = bad_count;
+		ad_curve loaded(4, ad_interp::hermite);
+		t_assert(!loaded.init_borrowed(curve_blob, curve_size));
+	}
+	ad_binary_clip_header* clip_header = reinterpret_cast<ad_binary_clip_header*>(clip_blob + sizeof(ad_binary_header));
+	for (uint32_t bad_count : bad_counts) {
+		clip_header->num_keys = bad_count;
+		ad_clip loaded(2);
+		t_assert(!loaded.init_borrowed(clip_blob, clip_size));
+	}
+
+	// Likewise for channel cardinalities that would wrap the clip's stride
+	clip_header->num_keys = 1;
+	ad_binary_clip_channel* channels = reinterpret_cast<ad_binary_clip_channel*>(clip_header + 1);
+	channels[0].cardinality = 0xffffffffu;
+	channels[1].cardinality = 2;
+	ad_clip wrapped(2);
+	t_assert(!wrapped.init_borrowed(clip_blob, clip_size));
+	channels[0].cardinality = 1;
+	channels[1].cardinality = 1;
+	ad_clip restored(2);
+	t_assert(restored.init_borrowed(clip_blob, clip_size));
+
+	// Writing should fail once a blob would outgrow its 32-bit size field, even with room
+	// for it: claim enough keys for that without allocating them, since nothing is read
+	if (sizeof(size_t) > 4) {
+		curve.num_keys = 0x10000000u;
+		clip.num_keys = 0x40000000u;
+		t_assert(curve.binary_size() > UINT32_MAX && clip.binary_size() > UINT32_MAX);
+		const size_t curve_written = curve.write_binary(curve_blob, SIZE_MAX);
+		const size_t clip_written = clip.write_binary(clip_blob, SIZE_MAX);
+		curve.num_keys = 1;
+		clip.num_keys = 1;
+		t_assert(curve_written == 0 && clip_written == 0);
+	}
+	return nullptr;
+}
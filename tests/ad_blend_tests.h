@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+
+#include "testing.h"
+#include "ad_blend.h"
+
+// SIMD kernels may contract multiplies and adds into FMAs (with -mavx2 -mfma, say), so
+// they can differ from the scalar kernel in the last bit: compare within a few ulps
+static bool blend_matches(const float* out, const float* expected, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		if (fabsf(out[i] - expected[i]) > 1e-5f * fmaxf(1.0f, fabsf(expected[i]))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+const char* test_blend_linear()
+{
+	// Every length should match the scalar kernel, without writing past the end
+	float a[20];
+	float b[20];
+	for (size_t i = 0; i < 20; i++) {
+		a[i] = static_cast<float>(i);
+		b[i] = static_cast<float>(i) * -3.0f + 8.0f;
+	}
+	for (size_t n = 1; n < 20; n++) {
+		float expected[20];
+		float out[20];
+		for (size_t i = 0; i < 20; i++) {
+			expected[i] = out[i] = -99.0f;
+		}
+		ad_blend_linear_scalar(a, b, 0.25f, n, expected);
+		ad_blend_linear(a, b, 0.25f, n, out);
+		t_assert(blend_matches(out, expected, n));
+		t_assert(out[n] == -99.0f);
+	}
+
+	const float ends[2] = { 2.0f, 10.0f };
+	float r;
+	ad_blend_linear(ends, ends + 1, 0.75f, 1, &r);
+	t_assert(r == 8.0f);
+
+	return nullptr;
+}
+
+const char* test_blend_cubic()
+{
+	float p0[20];
+	float m0[20];
+	float p1[20];
+	float m1[20];
+	for (size_t i = 0; i < 20; i++) {
+		p0[i] = static_cast<float>(i);
+		m0[i] = 1.0f;
+		p1[i] = static_cast<float>(i) + 2.0f;
+		m1[i] = -0.5f * static_cast<float>(i);
+	}
+	const float weights[4] = { 0.5f, 0.25f, 0.5f, -0.25f };
+	for (size_t n = 1; n < 20; n++) {
+		float expected[20];
+		float out[20];
+		for (size_t i = 0; i < 20; i++) {
+			expected[i] = out[i] = -99.0f;
+		}
+		ad_blend_cubic_scalar(p0, m0, p1, m1, weights, n, expected);
+		ad_blend_cubic(p0, m0, p1, m1, weights, n, out);
+		t_assert(blend_matches(out, expected, n));
+		t_assert(out[n] == -99.0f);
+	}
+
+	return nullptr;
+}
@@ -189,3 +189,121 @@ const char* test_buffer_resize_noshrink()
 
 	return nullptr;
 }
+
+const char* test_buffer_resize_past_double()
+{
+	ad_buffer buf;
+	init_buffer(buf);
+
+	// Inserting more than our current capacity should still grow enough to fit
+	float* ptr = buf.resize_for_edit(3, 20);
+	t_assert(ptr == buf.data + 3);
+	t_assert(buf.capacity == 26);
+	t_assert(buf.size == 26);
+	for (int i = 0; i < 20; i++) {
+		*ptr++ = 100.f;
+	}
+	t_assert_floats(buf.data, 0.f, 1.f, 2.f, 100.f);
+	t_assert_floats(buf.data + 23, 3.f, 4.f, 5.f);
+
+	return nullptr;
+}
+
+const char* test_buffer_growth_policy()
+{
+	// A growth factor of 1 should grow to fit each edit exactly
+	ad_buffer buf;
+	init_buffer(buf);
+	buf.growth_factor = 1.0f;
+	float* ptr = buf.resize_for_edit(0, 3);
+	t_assert(ptr == buf.data);
+	t_assert(buf.capacity == 9);
+	t_assert(buf.size == 9);
+
+	// Reserving ahead should leave room for that many more floats after the edit
+	buf.reserve_ahead = 4;
+	ptr = buf.resize_for_edit(9, 1);
+	t_assert(ptr == buf.data + 9);
+	t_assert(buf.capacity == 14);
+	t_assert(buf.size == 10);
+	*ptr = 42.f;
+	t_assert_floats(buf.data + 3, 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 42.f);
+
+	// Geometric growth should win out when it gives us more room
+	buf.growth_factor = 3.0f;
+	ptr = buf.resize_for_edit(0, 5);
+	t_assert(buf.capacity == 42);
+	t_assert(buf.size == 15);
+
+	return nullptr;
+}
+
+const char* test_buffer_append_grows_in_place()
+{
+	ad_buffer buf;
+	init_buffer(buf);
+
+	// Appending past our capacity should preserve our existing data
+	float* ptr = buf.resize_for_edit(6, 4);
+	t_assert(ptr == buf.data + 6);
+	t_assert(buf.capacity == 16);
+	t_assert(buf.size == 10);
+	*ptr++ = 6.f;
+	*ptr++ = 7.f;
+	*ptr++ = 8.f;
+	*ptr = 9.f;
+	t_assert_floats(buf.data, 0.f, 1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f);
+
+	return nullptr;
+}
+
+const char* test_buffer_reserve()
+{
+	// Reserving should work even before init
+	ad_buffer buf;
+	t_assert(buf.reserve(4));
+	t_assert(buf.data != nullptr);
+	t_assert(buf.capacity == 4);
+	t_assert(buf.size == 0);
+
+	// Reserving less than our capacity should have no effect
+	float* ptr = buf.resize_for_edit(0, 2);
+	*ptr++ = 1.f;
+	*ptr = 2.f;
+	t_assert(buf.reserve(3));
+	t_assert(buf.capacity == 4);
+
+	// Reserving more should preserve our data, and let us fill up without reallocating
+	t_assert(buf.reserve(32));
+	t_assert(buf.capacity == 32);
+	t_assert(buf.size == 2);
+	t_assert_floats(buf.data, 1.f, 2.f);
+	float* const reserved_data = buf.data;
+	buf.resize_for_edit(2, 30);
+	t_assert(buf.data == reserved_data);
+	t_assert(buf.capacity == 32);
+
+	return nullptr;
+}
+
+const char* test_buffer_shrink_to_fit()
+{
+	ad_buffer buf;
+	init_buffer(buf);
+
+	t_assert(buf.shrink_to_fit());
+	t_assert(buf.capacity == 6);
+	t_assert(buf.size == 6);
+	t_assert_floats(buf.data, 0.f, 1.f, 2.f, 3.f, 4.f, 5.f);
+
+	// An empty buffer should keep enough capacity to remain usable
+	buf.resize_for_edit(0, -6);
+	t_assert(buf.shrink_to_fit());
+	t_assert(buf.capacity == 1);
+	t_assert(buf.size == 0);
+	float* ptr = buf.resize_for_edit(0, 3);
+	t_assert(ptr == buf.data);
+	t_assert(buf.capacity == 3);
+
+	return nullptr;
+}
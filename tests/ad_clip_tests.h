@@ -0,0 +1,101 @@
+#pragma once
+
+#include "testing.h"
+#include "ad_clip.h"
+
+const char* test_clip_init()
+{
+	// A vec3 translation channel, a quaternion rotation channel, and a scalar channel
+	ad_clip clip(3);
+	t_assert(clip.num_channels == 3);
+	t_assert(clip.channels == nullptr);
+
+	const size_t cardinalities[] = { 3, 4, 1 };
+	const ad_interp interps[] = { ad_interp::linear, ad_interp::slerp, ad_interp::constant };
+	const bool init_ok = clip.init(cardinalities, interps, 8);
+	t_assert(init_ok);
+	t_assert(clip.stride == 8);
+	t_assert(clip.num_keys == 0);
+	t_assert(clip.times.capacity == 8);
+	t_assert(clip.values.capacity == 64);
+
+	t_assert(clip.channels[0].offset == 0 && clip.channels[0].cardinality == 3);
+	t_assert(clip.channels[1].offset == 3 && clip.channels[1].cardinality == 4);
+	t_assert(clip.channels[2].offset == 7 && clip.channels[2].cardinality == 1);
+	t_assert(clip.channels[1].interp == ad_interp::slerp);
+
+	return nullptr;
+}
+
+const char* test_clip_set()
+{
+	const size_t cardinalities[] = { 1, 2 };
+	ad_clip clip(2);
+	const bool init_ok = clip.init(cardinalities, nullptr, 2);
+	t_assert(init_ok);
+	t_assert(clip.channels[0].interp == ad_interp::constant);
+
+	// Poses should be inserted in time order, sharing a single time per key
+	const float pose_a[] = { 1.0f, 2.0f, 3.0f };
+	const float pose_b[] = { 4.0f, 5.0f, 6.0f };
+	const float pose_c[] = { 7.0f, 8.0f, 9.0f };
+	t_assert(clip.set(2.0f, pose_b));
+	t_assert(clip.set(0.0f, pose_a));
+	t_assert(clip.set(3.0f, pose_c));
+	t_assert(clip.num_keys == 3);
+	t_assert(clip.times.size == 3);
+	t_assert(clip.values.size == 9);
+	t_assert_floats(clip.times.data, 0.0f, 2.0f, 3.0f);
+	t_assert_floats(clip.values.data, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f);
+
+	// Setting an existing time should replace its pose
+	t_assert(clip.set(2.0f, pose_a));
+	t_assert(clip.num_keys == 3);
+	t_assert_floats(clip.values.data, 1.0f, 2.0f, 3.0f, 1.0f, 2.0f, 3.0f, 7.0f, 8.0f, 9.0f);
+
+	// Removing a key should remove its whole pose
+	clip.remove_at(0.0f);
+	clip.remove_at(1.0f);
+	t_assert(clip.num_keys == 2);
+	t_assert_floats(clip.times.data, 2.0f, 3.0f);
+	t_assert_floats(clip.values.data, 1.0f, 2.0f, 3.0f, 7.0f, 8.0f, 9.0f);
+
+	return nullptr;
+}
+
+const char* test_clip_evaluate()
+{
+	// Two linear channels (which should blend as one run), then a quaternion, then a
+	// constant channel
+	const size_t cardinalities[] = { 2, 1, 4, 1 };
+	const ad_interp interps[] = { ad_interp::linear, ad_interp::linear, ad_interp::nlerp, ad_interp::constant };
+	ad_clip clip(4);
+	const bool init_ok = clip.init(cardinalities, interps, 4);
+	t_assert(init_ok);
+
+	// Evaluating an empty clip should fail and leave the output untouched
+	float r[8] = { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f };
+	t_assert(!clip.evaluate(0.0f, r));
+	t_assert_floats(r, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f);
+
+	const float pose_a[] = { 0.0f, 10.0f, 100.0f, 0.0f, 0.0f, 0.0f, 1.0f, 5.0f };
+	const float pose_b[] = { 4.0f, 20.0f, 300.0f, 0.0f, 0.0f, 0.70710678f, 0.70710678f, 6.0f };
+	t_assert(clip.set(0.0f, pose_a));
+	t_assert(clip.set(2.0f, pose_b));
+
+	// Out-of-bounds times should hold the first or last pose
+	t_assert(clip.evaluate(-1.0f, r)); t_assert_floats(r, 0.0f, 10.0f, 100.0f, 0.0f, 0.0f, 0.0f, 1.0f, 5.0f);
+	t_assert(clip.evaluate(9.0f, r)); t_assert_floats(r, 4.0f, 20.0f, 300.0f, 0.0f, 0.0f, 0.70710678f, 0.70710678f, 6.0f);
+
+	// Between keys, each channel should be blended according to its own mode
+	t_assert(clip.evaluate(1.0f, r));
+	t_assert_floats(r, 2.0f, 15.0f, 200.0f);
+	t_assert_floats_near(r + 3, 1e-5f, 0.0f, 0.0f, 0.38268343f, 0.92387953f);
+	t_assert(r[7] == 5.0f);
+
+	// Searching from a hint should work just as it does for curves
+	t_assert(clip.find_nearest_lte_from(1.0f, 1) == 0);
+	t_assert(clip.find_nearest_lte_from(3.0f, 0) == 1);
+
+	return nullptr;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cmath>
+
+#include "testing.h"
+#include "ad_compressed_curve.h"
+
+const char* test_compressed_curve_linear()
+{
+	// A vec3 curve with keys every other frame at 30 fps
+	ad_curve curve(3, ad_interp::linear);
+	t_assert(curve.init(16));
+	for (int i = 0; i < 16; i++) {
+		const float value[3] = { sinf(i * 0.3f) * 10.0f, i * 0.5f, 2.0f };
+		curve.set(i * 2 / 30.0f, value);
+	}
+
+	// 16-bit frame indices and 8- or 16-bit components, plus a min and scale per component
+	ad_compressed_curve compressed8(30.0f, ad_quantize::bits8);
+	t_assert(compressed8.init(curve));
+	t_assert(compressed8.frame_bytes == 2);
+	t_assert(compressed8.key_bytes == 3);
+	t_assert(compressed8.data_size == 24 + 32 + 48);
+	ad_compressed_curve compressed16(30.0f, ad_quantize::bits16);
+	t_assert(compressed16.init(curve));
+	t_assert(compressed16.key_bytes == 6);
+
+	// Evaluation should stay within half a quantization step of the original, both on
+	// and between keys, with a constant component reproduced exactly
+	bool in_tolerance = true;
+	for (int i = -2; i < 70; i++) {
+		const float t = i / 60.0f;
+		float expected[3];
+		float actual8[3];
+		float actual16[3];
+		t_assert(curve.evaluate(t, expected));
+		t_assert(compressed8.evaluate(t, actual8));
+		t_assert(compressed16.evaluate(t, actual16));
+		in_tolerance = in_tolerance && fabsf(actual8[0] - expected[0]) <= 20.0f / 255.0f * 0.5f + 1e-4f;
+		in_tolerance = in_tolerance && fabsf(actual16[0] - expected[0]) <= 20.0f / 65535.0f * 0.5f + 1e-4f;
+		in_tolerance = in_tolerance && fabsf(actual8[1] - expected[1]) <= 7.5f / 255.0f * 0.5f + 1e-4f;
+		in_tolerance = in_tolerance && actual8[2] == 2.0f && actual16[2] == 2.0f;
+	}
+	t_assert(in_tolerance);
+
+	// Frames past 65535 need 32-bit indices
+	ad_curve long_curve(1, ad_interp::constant);
+	t_assert(long_curve.init(2));
+	const float values[2] = { 1.0f, 3.0f };
+	long_curve.set(0.0f, &values[0]);
+	long_curve.set(3000.0f, &values[1]);
+	ad_compressed_curve compressed_long(30.0f);
+	t_assert(compressed_long.init(long_curve));
+	t_assert(compressed_long.frame_bytes == 4);
+	float value;
+	t_assert(compressed_long.evaluate(2999.0f, &value) && value == 1.0f);
+	t_assert(compressed_long.evaluate(3000.0f, &value) && value == 3.0f);
+
+	// Frames far beyond the last key hold its value, and NaN holds the first key's value
+	t_assert(compressed_long.evaluate(1e12f, &value) && value == 3.0f);
+	t_assert(compressed_long.evaluate(INFINITY, &value) && value == 3.0f);
+	t_assert(compressed_long.evaluate(NAN, &value) && value == 1.0f);
+	t_assert(compressed_long.find_nearest_lte(1e12f) == 1);
+	t_assert(compressed_long.find_nearest_lte(NAN) == -1);
+	float last[3];
+	t_assert(compressed8.evaluate(1e12f, last) && last[2] == 2.0f);
+	t_assert(compressed8.find_nearest_lte(1e12f) == 15);
+
+	// Frame indices must fit in 32 bits
+	ad_curve huge_curve(1, ad_interp::constant);
+	t_assert(huge_curve.init(1));
+	huge_curve.set(4294967296.0f, &values[0]);
+	ad_compressed_curve compressed_huge(1.0f);
+	t_assert(!compressed_huge.init(huge_curve));
+
+	// Keys off the frame grid can't be compressed
+	const float off_grid = 0.01f;
+	long_curve.set(off_grid, &values[0]);
+	ad_compressed_curve compressed_off_grid(30.0f);
+	t_assert(!compressed_off_grid.init(long_curve));
+
+	return nullptr;
+}
+
+const char* test_compressed_curve_quaternion()
+{
+	// A slerp curve rotating about an arbitrary axis, with keys every 5 frames at 60 fps
+	ad_curve curve(4, ad_interp::slerp);
+	t_assert(curve.init(16));
+	const float axis[3] = { 0.48f, -0.6f, 0.64f };
+	for (int i = 0; i < 16; i++) {
+		const float half_angle = i * 0.4f - 2.0f;
+		const float s = sinf(half_angle);
+		const float q[4] = { axis[0] * s, axis[1] * s, axis[2] * s, cosf(half_angle) };
+		curve.set(i * 5 / 60.0f, q);
+	}
+
+	// Smallest-three packs each key into 32 or 64 bits
+	ad_compressed_curve compressed8(60.0f, ad_quantize::bits8);
+	t_assert(compressed8.init(curve));
+	t_assert(compressed8.key_bytes == 4);
+	t_assert(compressed8.mins == nullptr);
+	ad_compressed_curve compressed16(60.0f, ad_quantize::bits16);
+	t_assert(compressed16.init(curve));
+	t_assert(compressed16.key_bytes == 8);
+
+	// Decoded rotations should match the original, up to sign
+	float max_error8 = 0.0f;
+	float max_error16 = 0.0f;
+	for (int i = 0; i < 80; i++) {
+		const float t = i / 60.0f;
+		float expected[4];
+		float actual8[4];
+		float actual16[4];
+		t_assert(curve.evaluate(t, expected));
+		t_assert(compressed8.evaluate(t, actual8));
+		t_assert(compressed16.evaluate(t, actual16));
+		float dot8 = 0.0f;
+		float dot16 = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			dot8 += expected[c] * actual8[c];
+			dot16 += expected[c] * actual16[c];
+		}
+		max_error8 = fmaxf(max_error8, 1.0f - fabsf(dot8));
+		max_error16 = fmaxf(max_error16, 1.0f - fabsf(dot16));
+	}
+	t_assert(max_error8 < 1e-5f);
+	t_assert(max_error16 < 1e-6f);
+
+	return nullptr;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "testing.h"
+#include "ad_curve.h"
+#include "ad_curve_journal.h"
+
+// Captures a curve's keys, so that we can check that undo and redo restore them exactly
+struct journal_test_state
+{
+	size_t num_keys;
+	float* times;
+	float* values;
+
+	journal_test_state()
+		: num_keys(0)
+		, times(nullptr)
+		, values(nullptr)
+	{
+	}
+
+	~journal_test_state()
+	{
+		free(times);
+		free(values);
+	}
+
+	void capture(const ad_curve& curve)
+	{
+		num_keys = curve.num_keys;
+		times = reinterpret_cast<float*>(realloc(times, (num_keys + 1) * sizeof(float)));
+		values = reinterpret_cast<float*>(realloc(values, (num_keys * curve.stride + 1) * sizeof(float)));
+		for (size_t i = 0; i < num_keys; i++) {
+			times[i] = curve.key_time(i);
+		}
+		memcpy(values, curve.values.data, num_keys * curve.stride * sizeof(float));
+	}
+
+	bool matches(const ad_curve& curve) const
+	{
+		if (curve.num_keys != num_keys || curve.values.size != num_keys * curve.stride) {
+			return false;
+		}
+		for (size_t i = 0; i < num_keys; i++) {
+			if (curve.key_time(i) != times[i]) {
+				return false;
+			}
+		}
+		return memcmp(values, curve.values.data, num_keys * curve.stride * sizeof(float)) == 0;
+	}
+};
+
+const char* test_curve_journal_undo_redo()
+{
+	// Make one of every kind of edit, capturing the curve after each
+	ad_curve curve(2, ad_interp::linear);
+	ad_curve_journal journal;
+	t_assert(curve.init_uniform(0.0f, 1.0f, 16));
+	t_assert(journal.init(1 << 16));
+	for (size_t i = 0; i < 10; i++) {
+		const float value[2] = { static_cast<float>(i), static_cast<float>(i % 3) };
+		curve.set(static_cast<float>(i), value);
+	}
+	journal.attach(curve);
+	t_assert(!journal.can_undo());
+	t_assert(!journal.can_redo());
+
+	const size_t num_states = 10;
+	journal_test_state states[num_states];
+	states[0].capture(curve);
+	const float a[2] = { 5.0f, 5.0f };
+	const float b[2] = { 6.0f, 6.0f };
+	curve.set(10.0f, a);
+	states[1].capture(curve);
+	curve.set(3.0f, a);
+	states[2].capture(curve);
+	curve.set(3.5f, b);
+	states[3].capture(curve);
+	curve.remove_at(4.0f);
+	states[4].capture(curve);
+	t_assert(curve.remove_range(6.5f, 8.5f) == 2);
+	states[5].capture(curve);
+	const float many_times[4] = { 11.0f, 2.0f, 2.5f, 12.0f };
+	const float many_values[8] = { 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f, 4.0f, 4.0f };
+	t_assert(curve.set_many(many_times, many_values, 4));
+	states[6].capture(curve);
+	t_assert(curve.shift_range(3.0f, 5.5f, 6.0f));
+	states[7].capture(curve);
+	t_assert(curve.scale_range(0.0f, 12.0f, -1.0f, 6.0f));
+	states[8].capture(curve);
+	t_assert(curve.reduce(0.5f));
+	states[9].capture(curve);
+	t_assert(!curve.uniform);
+
+	// Undo every edit, then redo them all, checking that we pass through every state
+	bool all_match = true;
+	for (size_t i = num_states - 1; i > 0; i--) {
+		all_match = all_match && journal.undo() && states[i - 1].matches(curve);
+	}
+	t_assert(all_match);
+	t_assert(!journal.can_undo());
+	t_assert(!journal.undo());
+	for (size_t i = 1; i < num_states; i++) {
+		all_match = all_match && journal.redo() && states[i].matches(curve);
+	}
+	t_assert(all_match);
+	t_assert(!journal.can_redo());
+
+	// A new edit made after undoing discards anything we could have redone
+	t_assert(journal.undo());
+	t_assert(journal.undo());
+	t_assert(journal.can_redo());
+	curve.set(20.0f, a);
+	t_assert(!journal.can_redo());
+	t_assert(journal.undo());
+	t_assert(states[7].matches(curve));
+	t_assert(journal.undo());
+	t_assert(states[6].matches(curve));
+
+	// Lookups still work after undo has rebuilt the curve
+	float value[2];
+	t_assert(curve.evaluate(2.5f, value));
+	t_assert(value[0] == 3.0f);
+	return nullptr;
+}
+
+const char* test_curve_journal_group()
+{
+	// Edits made within a group are undone and redone as one
+	ad_curve curve(1);
+	ad_curve_journal journal;
+	t_assert(curve.init(16));
+	t_assert(journal.init(4096));
+	journal.attach(curve);
+
+	const float one = 1.0f;
+	curve.set(0.0f, &one);
+	journal_test_state before;
+	before.capture(curve);
+	journal.begin_group();
+	for (size_t i = 1; i < 8; i++) {
+		const float value = static_cast<float>(i);
+		curve.set(static_cast<float>(i), &value);
+	}
+	journal.begin_group();
+	curve.remove_at(0.0f);
+	journal.end_group();
+	journal.end_group();
+	journal_test_state after;
+	after.capture(curve);
+	t_assert(curve.num_keys == 7);
+
+	t_assert(journal.undo());
+	t_assert(before.matches(curve));
+	t_assert(journal.undo());
+	t_assert(curve.num_keys == 0);
+	t_assert(!journal.can_undo());
+	t_assert(journal.redo());
+	t_assert(journal.redo());
+	t_assert(after.matches(curve));
+
+	// Destroying the journal detaches it, and destroying the curve would do the same
+	{
+		ad_curve_journal scoped;
+		t_assert(scoped.init(256));
+		journal.detach();
+		scoped.attach(curve);
+		t_assert(curve.journal == &scoped);
+	}
+	t_assert(!curve.journal);
+	return nullptr;
+}
+
+const char* test_curve_journal_capacity()
+{
+	// With room for only a few edits, the oldest are forgotten as we make more
+	ad_curve curve(1);
+	ad_curve_journal journal;
+	t_assert(curve.init(64));
+	const size_t record_size = sizeof(ad_journal_record) + 2 * sizeof(float) + sizeof(uint32_t);
+	t_assert(journal.init(record_size * 8));
+	journal.attach(curve);
+
+	const size_t num_edits = 40;
+	journal_test_state states[num_edits + 1];
+	states[0].capture(curve);
+	for (size_t i = 0; i < num_edits; i++) {
+		const float value = static_cast<float>(i);
+		curve.set(static_cast<float>(i), &value);
+		states[i + 1].capture(curve);
+		t_assert(journal.size <= journal.capacity);
+	}
+
+	// Whatever we can still undo takes us back through the latest states in order
+	size_t num_undone = 0;
+	bool all_match = true;
+	while (journal.can_undo()) {
+		num_undone++;
+		all_match = all_match && journal.undo() && states[num_edits - num_undone].matches(curve);
+	}
+	t_assert(all_match);
+	t_assert(num_undone > 0 && num_undone <= 8);
+	t_assert(curve.num_keys == num_edits - num_undone);
+
+	// An edit too large to journal at all clears the history, rather than leaving part of it
+	float big_times[40];
+	float big_values[40];
+	for (size_t i = 0; i < 40; i++) {
+		big_times[i] = 100.0f + static_cast<float>(i);
+		big_values[i] = static_cast<float>(i);
+	}
+	t_assert(journal.redo());
+	t_assert(curve.set_many(big_times, big_values, 40));
+	t_assert(!journal.can_undo());
+	t_assert(!journal.can_redo());
+	return nullptr;
+}
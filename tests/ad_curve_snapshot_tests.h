@@ -0,0 +1,161 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+
+#include "testing.h"
+#include "ad_curve_snapshot.h"
+
+const char* test_curve_snapshot_edit()
+{
+	ad_shared_curve shared(1, ad_interp::linear);
+	t_assert(shared.init());
+	const ad_curve_snapshot* empty = shared.acquire();
+	t_assert(empty->num_keys == 0);
+	float r;
+	t_assert(!empty->evaluate(0.0f, &r));
+
+	// Edits aren't visible until they're published, and published snapshots never change
+	ad_curve reference(1, ad_interp::linear);
+	t_assert(reference.init(16));
+	for (int i = 999; i >= 0; i--) {
+		const float time = static_cast<float>(i);
+		const float value = static_cast<float>(i % 17);
+		t_assert(shared.set(time, &value));
+		reference.set(time, &value);
+	}
+	const ad_curve_snapshot* unpublished = shared.acquire();
+	t_assert(unpublished == empty);
+	unpublished->release();
+	t_assert(shared.publish());
+	const ad_curve_snapshot* first = shared.acquire();
+	t_assert(first->num_keys == 1000);
+	t_assert(first->num_pages > 1000 / AD_CURVE_PAGE_KEYS);
+	t_assert(empty->num_keys == 0);
+
+	// Evaluating across page boundaries should agree with an ad_curve holding the same keys
+	bool all_match = true;
+	for (float time = -1.0f; time < 1001.0f; time += 0.25f) {
+		float expected;
+		all_match = all_match && first->evaluate(time, &r) && reference.evaluate(time, &expected) && r == expected;
+	}
+	t_assert(all_match);
+
+	// Editing one key copies only the page it's on: every other page is shared
+	const float value = 100.0f;
+	t_assert(shared.set(500.0f, &value));
+	t_assert(shared.remove_at(0.0f));
+	t_assert(shared.remove_at(0.5f));
+	t_assert(shared.publish());
+	const ad_curve_snapshot* second = shared.acquire();
+	t_assert(second->num_keys == 999);
+	t_assert(second->evaluate(500.0f, &r) && r == 100.0f);
+	t_assert(first->evaluate(500.0f, &r) && r == static_cast<float>(500 % 17));
+	t_assert(second->num_pages == first->num_pages);
+	size_t num_shared = 0;
+	for (size_t i = 0; i < second->num_pages; i++) {
+		num_shared += second->pages[i] == first->pages[i] ? 1 : 0;
+	}
+	t_assert(num_shared == first->num_pages - 2);
+
+	// Removing every key from a page drops it
+	for (int i = 1; i < 1000; i++) {
+		t_assert(shared.remove_at(static_cast<float>(i)));
+	}
+	t_assert(shared.publish());
+	const ad_curve_snapshot* third = shared.acquire();
+	t_assert(third->num_keys == 0 && third->num_pages == 0);
+	empty->release();
+	first->release();
+	second->release();
+	third->release();
+	return nullptr;
+}
+
+const char* test_curve_snapshot_concurrent()
+{
+	// While the writer appends keys and overwrites old ones, readers should only ever see
+	// whole versions: in version n, there are n keys, each with a value of n
+	ad_shared_curve shared(1, ad_interp::constant);
+	t_assert(shared.init());
+	const int num_versions = 600;
+	std::atomic<bool> done(false);
+	std::atomic<int> num_torn(0);
+	std::thread readers[3];
+	for (std::thread& reader : readers) {
+		reader = std::thread([&]() {
+			while (!done.load()) {
+				const ad_curve_snapshot* snapshot = shared.acquire();
+				const float n = static_cast<float>(snapshot->num_keys);
+				float r;
+				for (size_t i = 0; i < snapshot->num_keys; i += 37) {
+					if (!snapshot->evaluate(static_cast<float>(i), &r) || r != n) {
+						num_torn.fetch_add(1);
+					}
+				}
+				snapshot->release();
+			}
+		});
+	}
+	bool ok = true;
+	for (int version = 1; version <= num_versions; version++) {
+		const float value = static_cast<float>(version);
+		for (int i = 0; i < version; i++) {
+			ok = ok && shared.set(static_cast<float>(i), &value);
+		}
+		ok = ok && shared.publish();
+	}
+	done.store(true);
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+	t_assert(ok);
+	t_assert(num_torn.load() == 0);
+	return nullptr;
+}
+
+const char* test_curve_snapshot_publish_under_load()
+{
+	// Readers that do nothing but acquire and release keep the writer's wait busy: each
+	// publish should still finish, since it only waits for readers already acquiring
+	ad_shared_curve shared(1);
+	t_assert(shared.init());
+	std::atomic<bool> done(false);
+	std::atomic<size_t> num_started(0);
+	std::atomic<size_t> num_acquired(0);
+	std::thread readers[4];
+	for (std::thread& reader : readers) {
+		reader = std::thread([&]() {
+			size_t n = 0;
+			while (!done.load(std::memory_order_relaxed)) {
+				shared.acquire()->release();
+				if (n++ == 0) {
+					num_started.fetch_add(1);
+				}
+			}
+			num_acquired.fetch_add(n);
+		});
+	}
+
+	// Wait until every reader is busy, so that we don't finish before they're scheduled
+	while (num_started.load() < 4) {
+		std::this_thread::yield();
+	}
+	bool ok = true;
+	for (int i = 0; i < 2000; i++) {
+		const float value = static_cast<float>(i);
+		ok = ok && shared.set(static_cast<float>(i % 10), &value) && shared.publish();
+	}
+	done.store(true);
+	for (std::thread& reader : readers) {
+		reader.join();
+	}
+	t_assert(ok);
+	t_assert(num_acquired.load() >= 4);
+
+	const ad_curve_snapshot* latest = shared.acquire();
+	float r;
+	t_assert(latest->evaluate(9.0f, &r) && r == 1999.0f);
+	latest->release();
+	return nullptr;
+}
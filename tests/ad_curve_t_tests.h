@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cmath>
+
+#include "testing.h"
+#include "ad_curve_t.h"
+
+const char* test_curve_t_vec3()
+{
+	ad_curve_t<float, float, 3> curve(ad_interp::linear);
+	t_assert(curve.init(2));
+	t_assert(curve.stride == 3);
+
+	// Keys are kept sorted, with values overwritten at existing times
+	const float a[3] = { 0.0f, 10.0f, -2.0f };
+	const float b[3] = { 2.0f, 20.0f, -4.0f };
+	const float c[3] = { 1.0f, 1.0f, 1.0f };
+	t_assert(curve.set(1.0f, b));
+	t_assert(curve.set(0.0f, c));
+	t_assert(curve.set(0.0f, a));
+	t_assert(curve.set(2.0f, c));
+	t_assert(curve.num_keys() == 3);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 2.0f);
+	t_assert_floats(curve.values.data, 0.0f, 10.0f, -2.0f, 2.0f, 20.0f, -4.0f, 1.0f, 1.0f, 1.0f);
+
+	float r[6];
+	t_assert(curve.evaluate(0.5f, r)); t_assert_floats(r, 1.0f, 15.0f, -3.0f);
+	t_assert(curve.evaluate(-1.0f, r)); t_assert_floats(r, 0.0f, 10.0f, -2.0f);
+	t_assert(curve.evaluate(5.0f, r)); t_assert_floats(r, 1.0f, 1.0f, 1.0f);
+
+	// Batched evaluation agrees with single lookups, sorted or not
+	const float eval_times[2] = { 1.5f, 0.25f };
+	t_assert(curve.evaluate_many(eval_times, 2, r));
+	t_assert_floats(r, 1.5f, 10.5f, -1.5f, 0.5f, 12.5f, -2.5f);
+
+	curve.remove_at(1.0f);
+	curve.remove_at(1.5f);
+	t_assert(curve.num_keys() == 2);
+	t_assert(curve.evaluate(1.0f, r)); t_assert_floats(r, 0.5f, 5.5f, -0.5f);
+
+	// An empty curve has no value
+	ad_curve_t<float, float, 3> empty;
+	t_assert(empty.init(1));
+	t_assert(!empty.evaluate(0.0f, r));
+	return nullptr;
+}
+
+const char* test_curve_t_time_types()
+{
+	// Ten hours in, float times can't tell keys a millisecond apart, but doubles can
+	const double base = 36000.0;
+	ad_curve_t<double, float, 1> curve(ad_interp::linear);
+	t_assert(curve.init(4));
+	float v = 0.0f; t_assert(curve.set(base, &v));
+	v = 1.0f; t_assert(curve.set(base + 0.001, &v));
+	t_assert(curve.num_keys() == 2);
+	float r;
+	t_assert(curve.evaluate(base + 0.00025, &r)); t_assert_floats_near(&r, 1e-3f, 0.25f);
+	t_assert(static_cast<float>(base) == static_cast<float>(base + 0.001));
+
+	// Integer ticks (here, at 48kHz) are exact however long the recording runs
+	const int64_t ticks_per_day = 48000ll * 60 * 60 * 24;
+	ad_curve_t<int64_t, float, 2> ticks(ad_interp::constant);
+	t_assert(ticks.init(4));
+	const float x[2] = { 1.0f, 2.0f };
+	const float y[2] = { 3.0f, 4.0f };
+	t_assert(ticks.set(ticks_per_day * 30, x));
+	t_assert(ticks.set(ticks_per_day * 30 + 1, y));
+	float r2[2];
+	t_assert(ticks.evaluate(ticks_per_day * 30, r2)); t_assert_floats(r2, 1.0f, 2.0f);
+	t_assert(ticks.evaluate(ticks_per_day * 30 + 1, r2)); t_assert_floats(r2, 3.0f, 4.0f);
+	t_assert(ticks.find_nearest_lte(ticks_per_day * 30 - 1) == -1);
+	return nullptr;
+}
+
+const char* test_curve_t_matches_curve()
+{
+	// Hermite and quaternion curves should evaluate just as ad_curve does
+	ad_curve_t<float, float, 1> hermite(ad_interp::hermite);
+	ad_curve hermite_ref(1, ad_interp::hermite);
+	t_assert(hermite.init(4) && hermite_ref.init(4));
+	t_assert(hermite.stride == 2);
+	const float hermite_keys[3][3] = { { 0.0f, 0.0f, 1.0f }, { 1.0f, 2.0f, -1.0f }, { 3.0f, 1.0f, 0.5f } };
+	for (const float* key : hermite_keys) {
+		t_assert(hermite.set(key[0], key + 1, key + 2));
+		hermite_ref.set(key[0], key + 1, key + 2);
+	}
+
+	ad_curve_t<float, float, 4> slerp(ad_interp::slerp);
+	ad_curve slerp_ref(4, ad_interp::slerp);
+	t_assert(slerp.init(4) && slerp_ref.init(4));
+	const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float rot_z_90[4] = { 0.0f, 0.0f, 0.70710678f, 0.70710678f };
+	t_assert(slerp.set(0.0f, identity));
+	t_assert(slerp.set(1.0f, rot_z_90));
+	slerp_ref.set(0.0f, identity);
+	slerp_ref.set(1.0f, rot_z_90);
+
+	bool all_match = true;
+	for (float time = -0.5f; time < 3.5f; time += 0.125f) {
+		float r[4];
+		float expected[4];
+		all_match = all_match && hermite.evaluate(time, r) && hermite_ref.evaluate(time, expected);
+		all_match = all_match && fabsf(r[0] - expected[0]) < 1e-5f;
+		all_match = all_match && slerp.evaluate(time, r) && slerp_ref.evaluate(time, expected);
+		for (size_t k = 0; k < 4; k++) {
+			all_match = all_match && fabsf(r[k] - expected[k]) < 1e-5f;
+		}
+	}
+	t_assert(all_match);
+	return nullptr;
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <thread>
+
 #include "testing.h"
 #include "ad_curve.h"
+#include "ad_curve_journal.h"
+#include "ad_input_recorder.h"
 
 const char* test_curve_init()
 {
@@ -134,6 +138,33 @@ const char* test_curve_set()
 	return nullptr;
 }
 
+const char* test_curve_set_out_of_memory()
+{
+	// Once an arena runs out, set should fail and leave times and values in agreement
+	ad_arena arena;
+	t_assert(arena.init(1024));
+	ad_curve curve(3, ad_interp::constant, &arena.allocator);
+	t_assert(curve.init(4));
+	size_t num_set = 0;
+	bool consistent = true;
+	for (int i = 0; i < 1000; i++) {
+		const float v[3] = { static_cast<float>(i), 0.0f, 0.0f };
+		const bool ok = curve.set(static_cast<float>(999 - i), v);
+		consistent = consistent && curve.times.size == curve.num_keys && curve.values.size == curve.num_keys * 3;
+		if (!ok) {
+			break;
+		}
+		num_set++;
+	}
+	t_assert(consistent);
+	t_assert(num_set > 0 && num_set < 1000);
+	t_assert(curve.num_keys == num_set);
+	float out[3];
+	t_assert(curve.evaluate(999.0f, out));
+	t_assert(out[0] == 0.0f);
+	return nullptr;
+}
+
 const char* test_curve_remove_at()
 {
 	ad_curve curve(1);
@@ -229,3 +260,759 @@ const char* test_curve_evaluate()
 
 	return nullptr;
 }
+
+const char* test_curve_find_nearest_lte_from()
+{
+	// Populate a curve with 32 keys, one per integer time
+	ad_curve curve(1);
+	const bool init_ok = curve.init(32);
+	t_assert(init_ok);
+	float* ptr = curve.times.resize_for_edit(0, 32);
+	for (size_t i = 0; i < curve.times.size; i++) {
+		*ptr++ = static_cast<float>(i);
+	}
+
+	// Any hint should give the same result as a full binary search
+	const float search_times[] = { -50.f, 0.f, 0.5f, 1.f, 7.25f, 15.f, 16.9f, 30.99f, 31.f, 50.f };
+	for (float search_time : search_times) {
+		const int32_t expected = curve.find_nearest_lte(search_time);
+		for (int32_t hint = -1; hint <= 33; hint++) {
+			t_assert(curve.find_nearest_lte_from(search_time, hint) == expected);
+		}
+	}
+
+	return nullptr;
+}
+
+const char* test_curve_evaluate_many()
+{
+	ad_curve curve(2);
+	const bool init_ok = curve.init(8);
+	t_assert(init_ok);
+
+	// Evaluating an empty curve should fail
+	const float empty_times[] = { 0.0f };
+	float r[12];
+	t_assert(!curve.evaluate_many(empty_times, 1, r));
+
+	float w[2];
+	w[0] = 100.0f; w[1] = 200.0f; curve.set(0.0f, w);
+	w[0] = 101.0f; w[1] = 202.0f; curve.set(1.0f, w);
+	w[0] = 102.0f; w[1] = 204.0f; curve.set(2.0f, w);
+
+	// Sorted times, with duplicates and out-of-bounds times on either side
+	const float sorted_times[] = { -1.0f, 0.0f, 0.5f, 1.0f, 1.0f, 5.0f };
+	t_assert(curve.evaluate_many(sorted_times, 6, r));
+	t_assert_floats(r, 100.0f, 200.0f, 100.0f, 200.0f, 100.0f, 200.0f, 101.0f, 202.0f, 101.0f, 202.0f, 102.0f, 204.0f);
+
+	// Unsorted times should give the same results as individual evaluate calls
+	const float unsorted_times[] = { 2.5f, 0.5f, 1.5f, -3.0f, 2.0f, 1.0f };
+	t_assert(curve.evaluate_many(unsorted_times, 6, r));
+	t_assert_floats(r, 102.0f, 204.0f, 100.0f, 200.0f, 101.0f, 202.0f, 100.0f, 200.0f, 102.0f, 204.0f, 101.0f, 202.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_cursor()
+{
+	ad_curve curve(1);
+	const bool init_ok = curve.init(8);
+	t_assert(init_ok);
+	float v;
+	v = 10.0f; curve.set(0.0f, &v);
+	v = 11.0f; curve.set(1.0f, &v);
+	v = 12.0f; curve.set(2.0f, &v);
+	v = 13.0f; curve.set(3.0f, &v);
+
+	// A new cursor hasn't found any key yet
+	ad_curve_cursor cursor(curve);
+	t_assert(cursor.curve == &curve);
+	t_assert(cursor.index == -1);
+
+	// Seeking should track the last key found, moving in either direction
+	t_assert(cursor.seek(0.5f) == 0 && cursor.index == 0);
+	t_assert(cursor.seek(2.5f) == 2 && cursor.index == 2);
+	t_assert(cursor.seek(9.0f) == 3 && cursor.index == 3);
+	t_assert(cursor.seek(1.0f) == 1 && cursor.index == 1);
+	t_assert(cursor.seek(-1.0f) == -1 && cursor.index == -1);
+
+	// Evaluating via the cursor should match evaluating the curve directly
+	float r;
+	t_assert(cursor.evaluate(1.5f, &r)); t_assert(r == 11.0f);
+	t_assert(cursor.evaluate(3.0f, &r)); t_assert(r == 13.0f);
+	t_assert(cursor.evaluate(-5.0f, &r)); t_assert(r == 10.0f);
+
+	cursor.reset();
+	t_assert(cursor.index == -1);
+
+	return nullptr;
+}
+
+const char* test_curve_remove_at_cardinality()
+{
+	// Removing a key should remove all of its values, not just the first
+	ad_curve curve(2);
+	const bool init_ok = curve.init(8);
+	t_assert(init_ok);
+	float w[2];
+	w[0] = 1.0f; w[1] = 2.0f; curve.set(0.0f, w);
+	w[0] = 3.0f; w[1] = 4.0f; curve.set(1.0f, w);
+	w[0] = 5.0f; w[1] = 6.0f; curve.set(2.0f, w);
+
+	curve.remove_at(1.0f);
+	t_assert(curve.num_keys == 2);
+	t_assert(curve.values.size == 4);
+	t_assert_floats(curve.times.data, 0.0f, 2.0f);
+	t_assert_floats(curve.values.data, 1.0f, 2.0f, 5.0f, 6.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_evaluate_linear()
+{
+	ad_curve curve(2, ad_interp::linear);
+	const bool init_ok = curve.init(8);
+	t_assert(init_ok);
+	t_assert(curve.interp == ad_interp::linear);
+	t_assert(curve.stride == 2);
+
+	float w[2];
+	w[0] = 0.0f; w[1] = 100.0f; curve.set(0.0f, w);
+	w[0] = 10.0f; w[1] = 50.0f; curve.set(1.0f, w);
+	w[0] = 20.0f; w[1] = 50.0f; curve.set(3.0f, w);
+
+	// Out-of-bounds times should hold the value of the first or last key
+	float r[2];
+	t_assert(curve.evaluate(-1.0f, r)); t_assert_floats(r, 0.0f, 100.0f);
+	t_assert(curve.evaluate(5.0f, r)); t_assert_floats(r, 20.0f, 50.0f);
+
+	// Key times should give exact key values, and times between keys should blend
+	t_assert(curve.evaluate(1.0f, r)); t_assert_floats(r, 10.0f, 50.0f);
+	t_assert(curve.evaluate(0.25f, r)); t_assert_floats(r, 2.5f, 87.5f);
+	t_assert(curve.evaluate(2.0f, r)); t_assert_floats(r, 15.0f, 50.0f);
+
+	// Batched evaluation should interpolate in the same way
+	const float times[] = { 0.25f, 2.0f };
+	float rs[4];
+	t_assert(curve.evaluate_many(times, 2, rs)); t_assert_floats(rs, 2.5f, 87.5f, 15.0f, 50.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_evaluate_hermite()
+{
+	ad_curve curve(1, ad_interp::hermite);
+	const bool init_ok = curve.init(8);
+	t_assert(init_ok);
+	t_assert(curve.stride == 2);
+	t_assert(curve.values.capacity == 16);
+
+	// With flat tangents (the default), we should ease in and out between keys
+	float v = 0.0f; curve.set(0.0f, &v);
+	v = 1.0f; curve.set(1.0f, &v);
+	t_assert(curve.values.size == 4);
+	t_assert_floats(curve.values.data, 0.0f, 0.0f, 1.0f, 0.0f);
+	float r;
+	t_assert(curve.evaluate(0.5f, &r)); t_assert(r == 0.5f);
+	t_assert(curve.evaluate(0.25f, &r)); t_assert(r < 0.25f);
+	t_assert(curve.evaluate(0.75f, &r)); t_assert(r > 0.75f);
+
+	// Tangents that match the slope between keys should give a straight line
+	float t = 1.0f;
+	v = 0.0f; curve.set(0.0f, &v, &t);
+	v = 1.0f; curve.set(1.0f, &v, &t);
+	t_assert_floats(curve.values.data, 0.0f, 1.0f, 1.0f, 1.0f);
+	t_assert(curve.evaluate(0.25f, &r)); t_assert_floats_near(&r, 1e-6f, 0.25f);
+
+	// Tangents are per second, so they should scale with the length of the segment
+	v = 3.0f; curve.set(3.0f, &v, &t);
+	t_assert(curve.evaluate(1.5f, &r)); t_assert_floats_near(&r, 1e-6f, 1.5f);
+
+	return nullptr;
+}
+
+const char* test_curve_evaluate_quat()
+{
+	// Blend from identity to a 90-degree rotation about Z, then back to identity via
+	// the negated quaternion, which should take the same short path
+	const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const float rot_z_90[4] = { 0.0f, 0.0f, 0.70710678f, 0.70710678f };
+	const float negated_identity[4] = { 0.0f, 0.0f, 0.0f, -1.0f };
+
+	ad_curve slerp_curve(4, ad_interp::slerp);
+	t_assert(slerp_curve.init(4));
+	slerp_curve.set(0.0f, identity);
+	slerp_curve.set(1.0f, rot_z_90);
+	slerp_curve.set(2.0f, negated_identity);
+
+	float r[4];
+	t_assert(slerp_curve.evaluate(0.5f, r)); t_assert_floats_near(r, 1e-5f, 0.0f, 0.0f, 0.38268343f, 0.92387953f);
+	t_assert(slerp_curve.evaluate(0.25f, r)); t_assert_floats_near(r, 1e-5f, 0.0f, 0.0f, 0.19509032f, 0.98078528f);
+	t_assert(slerp_curve.evaluate(1.75f, r)); t_assert_floats_near(r, 1e-5f, 0.0f, 0.0f, 0.19509032f, 0.98078528f);
+
+	// Nlerp should agree at the midpoint, but not in between
+	ad_curve nlerp_curve(4, ad_interp::nlerp);
+	t_assert(nlerp_curve.init(4));
+	nlerp_curve.set(0.0f, identity);
+	nlerp_curve.set(1.0f, rot_z_90);
+	t_assert(nlerp_curve.evaluate(0.5f, r)); t_assert_floats_near(r, 1e-5f, 0.0f, 0.0f, 0.38268343f, 0.92387953f);
+	t_assert(nlerp_curve.evaluate(0.25f, r)); t_assert_floats_near(r, 1e-4f, 0.0f, 0.0f, 0.18736982f, 0.98228949f);
+
+	return nullptr;
+}
+
+const char* test_curve_reserve()
+{
+	ad_curve curve(3, ad_interp::hermite);
+	const bool init_ok = curve.init(2);
+	t_assert(init_ok);
+
+	// Reserving should make room for both times and values (including tangents)
+	t_assert(curve.reserve(100));
+	t_assert(curve.times.capacity == 100);
+	t_assert(curve.values.capacity == 600);
+	float* const reserved_times = curve.times.data;
+	float* const reserved_values = curve.values.data;
+
+	const float v[3] = { 1.0f, 2.0f, 3.0f };
+	for (size_t i = 0; i < 100; i++) {
+		curve.set(static_cast<float>(i), v);
+	}
+	t_assert(curve.num_keys == 100);
+	t_assert(curve.times.data == reserved_times);
+	t_assert(curve.values.data == reserved_values);
+
+	return nullptr;
+}
+
+const char* test_curve_set_many()
+{
+	ad_curve curve(1);
+	const bool init_ok = curve.init(2);
+	t_assert(init_ok);
+
+	// A sorted batch into an empty curve should be copied as-is
+	const float times_a[] = { 0.0f, 1.0f, 2.0f, 3.0f };
+	const float values_a[] = { 10.0f, 11.0f, 12.0f, 13.0f };
+	t_assert(curve.set_many(times_a, values_a, 4));
+	t_assert(curve.num_keys == 4);
+	t_assert(curve.times.size == 4);
+	t_assert(curve.values.size == 4);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 2.0f, 3.0f);
+	t_assert_floats(curve.values.data, 10.0f, 11.0f, 12.0f, 13.0f);
+
+	// An unsorted batch should be merged in time order, replacing existing keys that
+	// collide, with the last of any duplicates in the batch winning out
+	const float times_b[] = { 5.0f, 1.0f, -1.0f, 2.5f, 5.0f };
+	const float values_b[] = { 50.0f, 21.0f, -10.0f, 25.0f, 55.0f };
+	t_assert(curve.set_many(times_b, values_b, 5));
+	t_assert(curve.num_keys == 7);
+	t_assert(curve.times.size == 7);
+	t_assert(curve.values.size == 7);
+	t_assert_floats(curve.times.data, -1.0f, 0.0f, 1.0f, 2.0f, 2.5f, 3.0f, 5.0f);
+	t_assert_floats(curve.values.data, -10.0f, 10.0f, 21.0f, 12.0f, 25.0f, 13.0f, 55.0f);
+
+	// With the keep policy, existing keys and the first of any duplicates should win
+	const float times_c[] = { 3.0f, 4.0f, 0.0f, 4.0f };
+	const float values_c[] = { 99.0f, 40.0f, 99.0f, 99.0f };
+	t_assert(curve.set_many(times_c, values_c, 4, ad_merge_policy::keep));
+	t_assert(curve.num_keys == 8);
+	t_assert_floats(curve.times.data, -1.0f, 0.0f, 1.0f, 2.0f, 2.5f, 3.0f, 4.0f, 5.0f);
+	t_assert_floats(curve.values.data, -10.0f, 10.0f, 21.0f, 12.0f, 25.0f, 13.0f, 40.0f, 55.0f);
+
+	// A batch with no new keys should just update values
+	const float times_d[] = { 0.0f, 5.0f };
+	const float values_d[] = { 0.5f, 5.5f };
+	t_assert(curve.set_many(times_d, values_d, 2));
+	t_assert(curve.num_keys == 8);
+	t_assert_floats(curve.values.data, -10.0f, 0.5f, 21.0f, 12.0f, 25.0f, 13.0f, 40.0f, 5.5f);
+
+	return nullptr;
+}
+
+const char* test_curve_set_many_stride()
+{
+	// Values (with tangents, for hermite curves) should move together with their times
+	ad_curve curve(2, ad_interp::hermite);
+	const bool init_ok = curve.init(4);
+	t_assert(init_ok);
+	const float v[2] = { 1.0f, 2.0f };
+	const float t[2] = { 3.0f, 4.0f };
+	curve.set(1.0f, v, t);
+
+	const float times[] = { 2.0f, 0.0f };
+	const float values[] = { 5.0f, 6.0f, 7.0f, 8.0f, -1.0f, -2.0f, -3.0f, -4.0f };
+	t_assert(curve.set_many(times, values, 2));
+	t_assert(curve.num_keys == 3);
+	t_assert(curve.values.size == 12);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 2.0f);
+	t_assert_floats(curve.values.data, -1.0f, -2.0f, -3.0f, -4.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f);
+
+	return nullptr;
+}
+
+// Populates a curve with a key at each integer time from 0 to 7, with values 10 to 17
+#define init_range_curve(curve) \
+	t_assert(curve.init(8)); \
+	for (int i = 0; i < 8; i++) { \
+		const float v = 10.0f + i; \
+		curve.set(static_cast<float>(i), &v); \
+	}
+
+const char* test_curve_remove_range()
+{
+	ad_curve curve(1);
+	init_range_curve(curve);
+
+	// Ranges with no keys in them should remove nothing
+	t_assert(curve.remove_range(2.5f, 2.75f) == 0);
+	t_assert(curve.remove_range(-5.0f, -1.0f) == 0);
+	t_assert(curve.num_keys == 8);
+
+	t_assert(curve.remove_range(1.5f, 4.0f) == 3);
+	t_assert(curve.num_keys == 5);
+	t_assert(curve.times.size == 5);
+	t_assert(curve.values.size == 5);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 5.0f, 6.0f, 7.0f);
+	t_assert_floats(curve.values.data, 10.0f, 11.0f, 15.0f, 16.0f, 17.0f);
+
+	t_assert(curve.remove_range(6.0f, 100.0f) == 2);
+	t_assert(curve.remove_range(-100.0f, 0.0f) == 1);
+	t_assert(curve.num_keys == 2);
+	t_assert_floats(curve.times.data, 1.0f, 5.0f);
+	t_assert_floats(curve.values.data, 11.0f, 15.0f);
+
+	// Removing from a curve with more than one float per key should remove whole keys
+	ad_curve curve2(2);
+	t_assert(curve2.init(4));
+	const float w[2] = { 1.0f, 2.0f };
+	const float x[2] = { 3.0f, 4.0f };
+	curve2.set(0.0f, w);
+	curve2.set(1.0f, x);
+	curve2.set(2.0f, w);
+	t_assert(curve2.remove_range(0.5f, 1.5f) == 1);
+	t_assert(curve2.values.size == 4);
+	t_assert_floats(curve2.values.data, 1.0f, 2.0f, 1.0f, 2.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_shift_range()
+{
+	// Shifting keys without passing any others should just change their times
+	ad_curve curve(1);
+	init_range_curve(curve);
+	t_assert(curve.shift_range(2.0f, 3.0f, 0.5f));
+	t_assert(curve.num_keys == 8);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 2.5f, 3.5f, 4.0f, 5.0f, 6.0f, 7.0f);
+	t_assert_floats(curve.values.data, 10.0f, 11.0f, 12.0f, 13.0f, 14.0f, 15.0f, 16.0f, 17.0f);
+
+	// Shifting keys past others should interleave them, and any key that's landed on
+	// should be replaced
+	ad_curve curve2(1);
+	init_range_curve(curve2);
+	t_assert(curve2.shift_range(1.0f, 2.0f, 3.5f));
+	t_assert(curve2.num_keys == 8);
+	t_assert_floats(curve2.times.data, 0.0f, 3.0f, 4.0f, 4.5f, 5.0f, 5.5f, 6.0f, 7.0f);
+	t_assert_floats(curve2.values.data, 10.0f, 13.0f, 14.0f, 11.0f, 15.0f, 12.0f, 16.0f, 17.0f);
+
+	ad_curve curve3(1);
+	init_range_curve(curve3);
+	t_assert(curve3.shift_range(5.0f, 6.0f, -3.0f));
+	t_assert(curve3.num_keys == 6);
+	t_assert(curve3.times.size == 6);
+	t_assert(curve3.values.size == 6);
+	t_assert_floats(curve3.times.data, 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 7.0f);
+	t_assert_floats(curve3.values.data, 10.0f, 11.0f, 15.0f, 16.0f, 14.0f, 17.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_scale_range()
+{
+	// Scaling about a pivot should spread keys out on both sides of it
+	ad_curve curve(1);
+	init_range_curve(curve);
+	t_assert(curve.scale_range(3.0f, 5.0f, 2.0f, 4.0f));
+	t_assert(curve.num_keys == 6);
+	t_assert_floats(curve.times.data, 0.0f, 1.0f, 2.0f, 4.0f, 6.0f, 7.0f);
+	t_assert_floats(curve.values.data, 10.0f, 11.0f, 13.0f, 14.0f, 15.0f, 17.0f);
+
+	// A negative factor should reverse the keys in the range
+	ad_curve curve2(1);
+	init_range_curve(curve2);
+	t_assert(curve2.scale_range(1.0f, 3.0f, -1.0f, 2.0f));
+	t_assert(curve2.num_keys == 8);
+	t_assert_floats(curve2.times.data, 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+	t_assert_floats(curve2.values.data, 10.0f, 13.0f, 12.0f, 11.0f, 14.0f, 15.0f, 16.0f, 17.0f);
+
+	// Scaling hermite keys should scale their tangents inversely, to preserve shape
+	ad_curve curve3(1, ad_interp::hermite);
+	t_assert(curve3.init(4));
+	const float v = 1.0f;
+	const float t = 4.0f;
+	curve3.set(1.0f, &v, &t);
+	curve3.set(2.0f, &v, &t);
+	t_assert(curve3.scale_range(0.0f, 3.0f, 2.0f, 0.0f));
+	t_assert_floats(curve3.times.data, 2.0f, 4.0f);
+	t_assert_floats(curve3.values.data, 1.0f, 2.0f, 1.0f, 2.0f);
+
+	return nullptr;
+}
+
+const char* test_curve_reduce()
+{
+	// Keys along two straight lines should reduce to the three keys at their ends, with
+	// a key that's out of line by more than our tolerance kept as well
+	ad_curve curve(2, ad_interp::linear);
+	t_assert(curve.init(16));
+	for (int i = 0; i <= 10; i++) {
+		const float value[2] = { i <= 5 ? i * 1.0f : 5.0f - (i - 5) * 0.5f, 1.0f + (i == 8 ? 0.12f : 0.0f) };
+		curve.set(static_cast<float>(i), value);
+	}
+	t_assert(curve.reduce(0.1f));
+	t_assert(curve.num_keys == 4);
+	t_assert(curve.times.size == 4);
+	t_assert(curve.values.size == 8);
+	t_assert_floats(curve.times.data, 0.0f, 5.0f, 8.0f, 10.0f);
+
+	// A looser tolerance should let the outlier go
+	t_assert(curve.reduce(0.25f));
+	t_assert(curve.num_keys == 3);
+	t_assert_floats(curve.times.data, 0.0f, 5.0f, 10.0f);
+	t_assert_floats(curve.values.data, 0.0f, 1.0f, 5.0f, 1.0f, 2.5f, 1.0f);
+
+	// Constant keys should be dropped while they stay within tolerance of the last key kept
+	ad_curve steps(1, ad_interp::constant);
+	t_assert(steps.init(8));
+	const float step_values[] = { 1.0f, 1.05f, 1.08f, 1.2f, 1.25f, 2.0f, 2.0f };
+	for (int i = 0; i < 7; i++) {
+		steps.set(static_cast<float>(i), &step_values[i]);
+	}
+	t_assert(steps.reduce(0.1f));
+	t_assert(steps.num_keys == 4);
+	t_assert_floats(steps.times.data, 0.0f, 3.0f, 5.0f, 6.0f);
+
+	// Other interpolation modes can't bound their error, so they refuse to be reduced
+	const ad_interp unsupported[] = { ad_interp::hermite, ad_interp::nlerp, ad_interp::slerp };
+	for (ad_interp interp : unsupported) {
+		ad_curve curved(4, interp);
+		t_assert(curved.init(8));
+		const float identity[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+		for (int i = 0; i < 5; i++) {
+			curved.set(static_cast<float>(i), identity);
+		}
+		t_assert(!curved.reduce(0.1f));
+		t_assert(curved.num_keys == 5);
+	}
+
+	return nullptr;
+}
+
+const char* test_curve_uniform()
+{
+	// Keys appended one step apart should keep a uniform curve free of stored times
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init_uniform(1.0f, 0.5f, 4));
+	for (int i = 0; i < 6; i++) {
+		const float v = static_cast<float>(i * i);
+		curve.set(1.0f + i * 0.5f, &v);
+	}
+	t_assert(curve.uniform);
+	t_assert(curve.num_keys == 6);
+	t_assert(curve.times.data == nullptr);
+	t_assert(curve.key_time(5) == 3.5f);
+
+	// Lookups should compute indices directly, agreeing with key_time at every key
+	t_assert(curve.find_nearest_lte(0.9f) == -1);
+	t_assert(curve.find_nearest_lte(1.0f) == 0);
+	t_assert(curve.find_nearest_lte(1.49f) == 0);
+	t_assert(curve.find_nearest_lte(1.5f) == 1);
+	t_assert(curve.find_nearest_lte(100.0f) == 5);
+	int32_t n = 0;
+	t_assert(curve.find_inclusive_range(1.2f, 2.5f, n) == 1 && n == 3);
+	float value;
+	t_assert(curve.evaluate(1.75f, &value) && value == 2.5f);
+	t_assert(curve.evaluate(5.0f, &value) && value == 25.0f);
+	ad_curve_cursor cursor(curve);
+	t_assert(cursor.evaluate(3.25f, &value) && value == 20.5f);
+
+	// Overwriting an existing key leaves the curve uniform; any other edit stores times
+	const float v = 3.0f;
+	curve.set(2.0f, &v);
+	t_assert(curve.uniform);
+	curve.set(2.25f, &v);
+	t_assert(!curve.uniform);
+	t_assert(curve.num_keys == 7);
+	t_assert_floats(curve.times.data, 1.0f, 1.5f, 2.0f, 2.25f, 2.5f, 3.0f, 3.5f);
+	t_assert(curve.evaluate(2.125f, &value) && value == 3.0f);
+
+	// Removing that key again lets us detect the uniform spacing and drop our times
+	curve.remove_at(2.25f);
+	t_assert(curve.make_uniform());
+	t_assert(curve.uniform && curve.start_time == 1.0f && curve.time_step == 0.5f);
+	t_assert(curve.times.data == nullptr && curve.times.capacity == 0);
+	t_assert(curve.evaluate(1.75f, &value) && value == 2.0f);
+
+	// Unevenly spaced keys can't be made uniform
+	ad_curve uneven(1);
+	t_assert(uneven.init(4));
+	const float times[] = { 0.0f, 1.0f, 2.5f };
+	const float values[] = { 0.0f, 1.0f, 2.0f };
+	t_assert(uneven.set_many(times, values, 3));
+	t_assert(!uneven.make_uniform());
+	t_assert(!uneven.uniform);
+
+	return nullptr;
+}
+
+const char* test_curve_search_index()
+{
+	// A curve of 1000 unevenly-spaced keys, with an index built explicitly
+	ad_curve curve(1);
+	t_assert(curve.init(1000));
+	for (int i = 0; i < 1000; i++) {
+		const float v = static_cast<float>(i);
+		curve.set(i * 2.0f + (i % 3) * 0.5f, &v);
+	}
+	t_assert(!curve.search_index_valid);
+	t_assert(curve.build_search_index());
+	t_assert(curve.search_index_valid);
+	t_assert(curve.search_index.size == 16);
+	t_assert(curve.search_index.data[1] == curve.times.data[64]);
+
+	// Indexed lookups should agree with a plain binary search everywhere, including
+	// exactly on keys, between keys, and outside the curve
+	bool agrees = true;
+	for (int j = -20; j < 4020; j++) {
+		const float t = j * 0.5f;
+		agrees = agrees && curve.find_nearest_lte(t) == ad_find_nearest_lte(curve.times.data, curve.times.size, t);
+		agrees = agrees && curve.find_nearest_lte_from(t, -1) == ad_find_nearest_lte(curve.times.data, curve.times.size, t);
+		int32_t n = 0;
+		const int32_t i = curve.find_inclusive_range(t, t + 3.0f, n);
+		const int32_t expected_lo = ad_find_nearest_lte(curve.times.data, curve.times.size, t);
+		const int32_t expected_hi = ad_find_nearest_lte(curve.times.data, curve.times.size, t + 3.0f);
+		const bool lo_is_exact = expected_lo >= 0 && curve.times.data[expected_lo] == t;
+		const int32_t expected_n = expected_hi - expected_lo + (lo_is_exact ? 1 : 0);
+		agrees = agrees && n == expected_n && (n == 0 ? i == -1 : i == expected_hi - n + 1);
+	}
+	t_assert(agrees);
+
+	// Edits should invalidate the index, and lookups on a curve past the threshold should
+	// rebuild it lazily
+	const float v = -1.0f;
+	curve.set(1.0f, &v);
+	t_assert(!curve.search_index_valid);
+	t_assert(curve.find_nearest_lte(1.25f) == 1);
+	t_assert(!curve.search_index_valid);
+	curve.search_index_threshold = 1000;
+	t_assert(curve.find_nearest_lte(1.25f) == 1);
+	t_assert(curve.search_index_valid);
+	t_assert(curve.find_nearest_lte(2.5f) == 2);
+	curve.remove_at(1.0f);
+	t_assert(!curve.search_index_valid);
+	t_assert(curve.find_nearest_lte(1.25f) == 0);
+
+	return nullptr;
+}
+
+const char* test_curve_search_index_concurrent()
+{
+	// Several threads evaluating the same curve at once should race to build its index
+	// safely, and all get the same results as a plain binary search
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init(4096));
+	for (int i = 0; i < 4096; i++) {
+		const float v = static_cast<float>(i % 7);
+		curve.set(static_cast<float>(i), &v);
+	}
+	curve.search_index_threshold = 1024;
+	t_assert(!curve.search_index_valid);
+
+	const int num_threads = 4;
+	bool agrees[num_threads];
+	std::thread threads[num_threads];
+	for (int thread_i = 0; thread_i < num_threads; thread_i++) {
+		threads[thread_i] = std::thread([&curve, &agrees, thread_i]() {
+			bool thread_agrees = true;
+			for (int j = 0; j < 20000; j++) {
+				const float t = static_cast<float>((j * 37 + thread_i * 101) % 40960) * 0.1f;
+				thread_agrees = thread_agrees && curve.find_nearest_lte(t) == ad_find_nearest_lte(curve.times.data, curve.times.size, t);
+			}
+			agrees[thread_i] = thread_agrees;
+		});
+	}
+	for (int thread_i = 0; thread_i < num_threads; thread_i++) {
+		threads[thread_i].join();
+		t_assert(agrees[thread_i]);
+	}
+	t_assert(curve.search_index_valid);
+
+	return nullptr;
+}
+
+struct dirty_calls
+{
+	int num_calls;
+	float last_from_time;
+	float last_to_time;
+};
+
+static void record_dirty_call(void* user, const ad_curve& /*curve*/, float from_time, float to_time)
+{
+	dirty_calls* calls = reinterpret_cast<dirty_calls*>(user);
+	calls->num_calls++;
+	calls->last_from_time = from_time;
+	calls->last_to_time = to_time;
+}
+
+const char* test_curve_dirty_ranges()
+{
+	// A linear curve with keys at 0..19: each edit dirties the span between its neighbors
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init(32));
+	for (int i = 0; i < 20; i++) {
+		const float v = static_cast<float>(i);
+		curve.set(static_cast<float>(i), &v);
+	}
+	curve.clear_dirty();
+	dirty_calls calls = { 0, 0.0f, 0.0f };
+	curve.dirty_hook = record_dirty_call;
+	curve.dirty_hook_user = &calls;
+
+	// The hook sees each edit's own span, even once it's been merged into a larger range
+	const float v = 0.5f;
+	curve.set(4.5f, &v);
+	t_assert(curve.num_dirty_ranges == 1);
+	t_assert(curve.dirty_ranges[0].from_time == 4.0f && curve.dirty_ranges[0].to_time == 5.0f);
+	t_assert(calls.last_from_time == 4.0f && calls.last_to_time == 5.0f);
+	curve.set(8.0f, &v);
+	t_assert(curve.num_dirty_ranges == 2);
+	t_assert(curve.dirty_ranges[1].from_time == 7.0f && curve.dirty_ranges[1].to_time == 9.0f);
+	t_assert(calls.last_from_time == 7.0f && calls.last_to_time == 9.0f);
+	curve.remove_at(5.0f);
+	t_assert(curve.num_dirty_ranges == 2);
+	t_assert(curve.dirty_ranges[0].from_time == 4.0f && curve.dirty_ranges[0].to_time == 6.0f);
+	t_assert(calls.last_from_time == 4.5f && calls.last_to_time == 6.0f);
+	curve.remove_at(0.0f);
+	t_assert(curve.num_dirty_ranges == 3);
+	t_assert(curve.dirty_ranges[0].from_time == -INFINITY && curve.dirty_ranges[0].to_time == 1.0f);
+	t_assert(calls.last_from_time == -INFINITY && calls.last_to_time == 1.0f);
+	t_assert(calls.num_calls == 4);
+
+	// Once there are too many ranges, the closest are merged
+	curve.set(12.5f, &v);
+	t_assert(curve.num_dirty_ranges == AD_MAX_DIRTY_RANGES);
+	curve.set(17.5f, &v);
+	t_assert(curve.num_dirty_ranges == AD_MAX_DIRTY_RANGES);
+	t_assert(curve.dirty_ranges[1].from_time == 4.0f && curve.dirty_ranges[1].to_time == 9.0f);
+	t_assert(curve.dirty_ranges[3].from_time == 17.0f && curve.dirty_ranges[3].to_time == 18.0f);
+	curve.clear_dirty();
+	t_assert(curve.num_dirty_ranges == 0);
+
+	// Constant curves hold each key until the next, so the previous key is unaffected
+	ad_curve stepped(1);
+	t_assert(stepped.init(16));
+	for (int i = 0; i < 10; i++) {
+		const float w = static_cast<float>(i);
+		stepped.set(static_cast<float>(i), &w);
+	}
+	stepped.clear_dirty();
+	stepped.set(4.5f, &v);
+	t_assert(stepped.num_dirty_ranges == 1);
+	t_assert(stepped.dirty_ranges[0].from_time == 4.5f && stepped.dirty_ranges[0].to_time == 5.0f);
+	return nullptr;
+}
+
+const char* test_curve_dirty_ranges_cover_edits()
+{
+	// Make every kind of edit to curves of each kind of interpolation, checking that any
+	// sample whose value changes falls within a dirty range
+	const ad_interp interps[3] = { ad_interp::constant, ad_interp::linear, ad_interp::hermite };
+	const int num_samples = 300;
+	bool all_covered = true;
+	int num_changed = 0;
+	for (ad_interp interp : interps) {
+		ad_curve curve(1, interp);
+		ad_curve_journal journal;
+		t_assert(curve.init(64));
+		t_assert(journal.init(4096));
+		for (int i = 0; i < 20; i++) {
+			const float v = static_cast<float>((i * 7) % 5);
+			const float tangent = static_cast<float>(i % 3) - 1.0f;
+			curve.set(static_cast<float>(i), &v, &tangent);
+		}
+		journal.attach(curve);
+
+		size_t num_keys_before_bake = 0;
+		for (int edit = 0; edit < 11; edit++) {
+			float before[num_samples];
+			for (int j = 0; j < num_samples; j++) {
+				curve.evaluate(j * 0.1f - 5.0f, before + j);
+			}
+			curve.clear_dirty();
+
+			const float v = 9.0f;
+			const float many_times[2] = { 3.25f, 3.75f };
+			const float many_values[4] = { 9.0f, 1.0f, 8.0f, 1.0f };
+			switch (edit) {
+			case 0: curve.set(6.5f, &v); break;
+			case 1: curve.set(12.0f, &v); break;
+			case 2: curve.remove_at(2.0f); break;
+			case 3: curve.remove_range(14.0f, 15.0f); break;
+			case 4: curve.set_many(many_times, many_values, 2); break;
+			case 5: curve.shift_range(9.0f, 10.0f, 2.5f); break;
+			case 6: curve.scale_range(16.0f, 19.0f, 0.5f, 16.0f); break;
+			case 7:
+				// Only constant and linear curves can be reduced
+				if (interp == ad_interp::hermite) {
+					curve.set(3.0f, &v);
+				}
+				else {
+					curve.reduce(0.5f);
+				}
+				break;
+			case 8:
+				// Only scalar curves can be baked to: bake a sample that's merged onto the
+				// last key, then two chunks' worth that are appended
+				num_keys_before_bake = curve.num_keys;
+				if (interp == ad_interp::hermite) {
+					curve.set(2.5f, &v);
+				}
+				else {
+					ad_input_recorder recorder(4, 2);
+					t_assert(recorder.init());
+					t_assert(recorder.write(curve.times.data[curve.num_keys - 1], v));
+					for (int i = 0; i < 6; i++) {
+						t_assert(recorder.write(20.5f + i, static_cast<float>(i % 4)));
+					}
+					t_assert(ad_bake_to_curve(recorder, curve));
+					t_assert(curve.num_keys == num_keys_before_bake + 6);
+				}
+				break;
+			case 9:
+				// A single undo takes back the whole bake
+				t_assert(journal.undo());
+				t_assert(curve.num_keys == num_keys_before_bake);
+				break;
+			case 10: journal.redo(); break;
+			}
+			for (int j = 0; j < num_samples; j++) {
+				const float t = j * 0.1f - 5.0f;
+				float after;
+				curve.evaluate(t, &after);
+				if (after != before[j]) {
+					num_changed++;
+					bool covered = false;
+					for (size_t r = 0; r < curve.num_dirty_ranges; r++) {
+						covered = covered || (t >= curve.dirty_ranges[r].from_time && t <= curve.dirty_ranges[r].to_time);
+					}
+					all_covered = all_covered && covered;
+				}
+			}
+		}
+	}
+	t_assert(num_changed > 0);
+	t_assert(all_covered);
+	return nullptr;
+}
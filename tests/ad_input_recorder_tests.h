@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <thread>
+
 #include "testing.h"
 #include "ad_input_recorder.h"
 
@@ -135,3 +138,325 @@ const char* test_input_recorder_constant_value()
 
     return nullptr;
 }
+
+const char* test_input_recorder_reader()
+{
+    // 4 samples per chunk, with 1 chunk preallocated
+    ad_input_recorder recorder(4, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+
+    // A new reader should start at the first chunk, with nothing to read yet
+    ad_input_record_reader reader(recorder);
+    t_assert(reader.chunk == recorder.first);
+    t_assert(reader.index == 0);
+    ad_input_sample samples[16];
+    t_assert(reader.read(samples, 16) == 0);
+
+    // Samples should become readable as soon as they're written
+    bool ok;
+    ok = recorder.handle_sample(0.0f, 1.0f); t_assert(ok);
+    ok = recorder.handle_sample(0.1f, 2.0f); t_assert(ok);
+    t_assert(reader.read(samples, 16) == 2);
+    t_assert(samples[0].time == 0.0f && samples[0].value == 1.0f);
+    t_assert(samples[1].time == 0.1f && samples[1].value == 2.0f);
+    t_assert(reader.read(samples, 16) == 0);
+
+    // Reading should cross chunk boundaries, and respect the maximum we ask for
+    for (int i = 2; i < 10; i++) {
+        ok = recorder.handle_sample(i * 0.1f, i + 1.0f); t_assert(ok);
+    }
+    t_assert(reader.read(samples, 5) == 5);
+    t_assert(samples[0].value == 3.0f);
+    t_assert(samples[4].value == 7.0f);
+    t_assert(reader.read(samples, 16) == 3);
+    t_assert(samples[2].value == 10.0f);
+
+    // Peeking should give us a view into the current chunk without consuming it
+    ok = recorder.handle_sample(1.0f, 11.0f); t_assert(ok);
+    const ad_input_sample* view = nullptr;
+    t_assert(reader.peek(view) == 1);
+    t_assert(view[0].value == 11.0f);
+    t_assert(reader.peek(view) == 1);
+    reader.consume(1);
+    t_assert(reader.peek(view) == 0);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_concurrent_reader()
+{
+    // Record on one thread while reading on another: every sample should arrive in
+    // order, with no torn or missing samples
+    const int num_samples = 200000;
+    ad_input_recorder recorder(64, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+
+    std::atomic<bool> producer_ok(true);
+    std::thread producer([&recorder, &producer_ok]() {
+        for (int i = 0; i < num_samples; i++) {
+            if (!recorder.handle_sample(static_cast<float>(i), static_cast<float>(i))) {
+                producer_ok = false;
+                return;
+            }
+        }
+    });
+
+    ad_input_record_reader reader(recorder);
+    int num_read = 0;
+    bool in_order = true;
+    ad_input_sample samples[100];
+    while (num_read < num_samples && in_order && producer_ok) {
+        const size_t n = reader.read(samples, 100);
+        for (size_t i = 0; i < n; i++) {
+            in_order = in_order && samples[i].time == static_cast<float>(num_read) && samples[i].value == samples[i].time;
+            num_read++;
+        }
+    }
+    producer.join();
+    t_assert(producer_ok);
+    t_assert(in_order);
+    t_assert(num_read == num_samples);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_reset()
+{
+    // 4 samples per chunk, with 1 chunk preallocated: record enough to span 3 chunks
+    ad_input_recorder recorder(4, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    bool ok;
+    for (int i = 0; i < 10; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)); t_assert(ok);
+    }
+    ad_input_record_chunk* first = recorder.first;
+    t_assert(recorder.write_head == first->next->next);
+    t_assert(recorder.num_free_chunks == 0);
+
+    // Resetting should rewind to our first chunk and keep the rest for reuse
+    recorder.reset();
+    t_assert(recorder.first == first);
+    t_assert(recorder.write_head == first);
+    t_assert(first->size == 0);
+    t_assert(first->next == nullptr);
+    t_assert(recorder.num_free_chunks == 2);
+    t_assert(recorder.last_time_seen == -1.0f);
+
+    // Recording again should draw from the free list before allocating anything new
+    for (int i = 0; i < 10; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i) * 2.0f); t_assert(ok);
+    }
+    t_assert(recorder.num_free_chunks == 0);
+    t_assert(first->data[0].value == 0.0f);
+    t_assert(first->next->next->data[1].value == 18.0f);
+    t_assert(first->next->next->size == 2);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_release_read_chunks()
+{
+    // 4 samples per chunk, with 1 chunk preallocated
+    ad_input_recorder recorder(4, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    ad_input_record_reader reader(recorder);
+    ad_input_sample samples[16];
+    bool ok;
+    for (int i = 0; i < 10; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)); t_assert(ok);
+    }
+
+    // Nothing has been read, so nothing can be released
+    recorder.release_read_chunks(reader);
+    t_assert(recorder.num_free_chunks == 0);
+
+    // Once the reader moves past the first two chunks, they can be recycled
+    t_assert(reader.read(samples, 9) == 9);
+    recorder.release_read_chunks(reader);
+    t_assert(recorder.num_free_chunks == 2);
+    t_assert(recorder.first == reader.chunk);
+    t_assert(recorder.first == recorder.write_head);
+
+    // Recording should continue into recycled chunks, and the reader should follow along
+    for (int i = 10; i < 16; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)); t_assert(ok);
+    }
+    t_assert(recorder.num_free_chunks == 0);
+    t_assert(reader.read(samples, 16) == 7);
+    t_assert(samples[0].value == 9.0f);
+    t_assert(samples[6].value == 15.0f);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_concurrent_release()
+{
+    // Release chunks from the recording thread while another thread reads: every sample
+    // should still arrive in order, and recording should keep reusing released chunks
+    ad_input_recorder recorder(64, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    const int num_samples = 100000;
+    ad_input_record_reader reader(recorder);
+    std::atomic<bool> producer_ok(true);
+    std::thread producer([&recorder, &reader, &producer_ok]() {
+        for (int i = 0; i < num_samples; i++) {
+            if (!recorder.handle_sample(static_cast<float>(i), static_cast<float>(i))) {
+                producer_ok = false;
+                return;
+            }
+            if (i % 100 == 0) {
+                recorder.release_read_chunks(reader);
+            }
+        }
+    });
+
+    int num_read = 0;
+    bool in_order = true;
+    ad_input_sample samples[100];
+    while (num_read < num_samples && in_order && producer_ok) {
+        const size_t n = reader.read(samples, 100);
+        for (size_t i = 0; i < n; i++) {
+            in_order = in_order && samples[i].time == static_cast<float>(num_read) && samples[i].value == samples[i].time;
+            num_read++;
+        }
+    }
+    producer.join();
+    t_assert(producer_ok);
+    t_assert(in_order);
+    t_assert(num_read == num_samples);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_ring()
+{
+    // 4 samples per chunk, with 3 chunks in a fixed ring
+    ad_input_recorder recorder(4, 3, ad_default_allocator(), ad_input_record_mode::ring);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    ad_input_record_chunk* chunks[3] = { recorder.first, recorder.first->next, recorder.first->next->next };
+
+    // Filling every chunk should leave the oldest one recycled as our new write head
+    bool ok;
+    for (int i = 0; i < 12; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)); t_assert(ok);
+    }
+    t_assert(recorder.first == chunks[1]);
+    t_assert(recorder.write_head == chunks[0]);
+    t_assert(chunks[0]->size == 0);
+    t_assert(chunks[2]->next == chunks[0]);
+
+    // Continuing to record should overwrite the oldest samples without ever allocating,
+    // leaving the most recent samples readable from the first chunk
+    for (int i = 12; i < 30; i++) {
+        ok = recorder.handle_sample(static_cast<float>(i), static_cast<float>(i)); t_assert(ok);
+    }
+    t_assert(recorder.num_free_chunks == 0);
+    ad_input_record_reader reader(recorder);
+    ad_input_sample samples[16];
+    const size_t num_read = reader.read(samples, 16);
+    t_assert(num_read == 10);
+    t_assert(samples[0].value == 20.0f);
+    t_assert(samples[9].value == 29.0f);
+
+    // Resetting a ring should keep its chunks linked in place
+    recorder.reset();
+    t_assert(recorder.write_head == recorder.first);
+    t_assert(recorder.first->next->next->next == nullptr);
+    t_assert(recorder.first->next->next->size == 0);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_bake_to_curve()
+{
+    // 4 samples per chunk, with 1 chunk preallocated
+    ad_input_recorder recorder(4, 1);
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    bool ok;
+    for (int i = 0; i < 6; i++) {
+        ok = recorder.handle_sample(i * 0.5f, static_cast<float>(i)); t_assert(ok);
+    }
+
+    // Baking should append every committed sample, across chunks, as a linear curve
+    ad_curve curve(1, ad_interp::linear);
+    ad_input_record_reader reader(recorder);
+    t_assert(ad_bake_to_curve(reader, curve));
+    t_assert(curve.num_keys == 6);
+    t_assert(curve.times.size == 6);
+    t_assert(curve.values.size == 6);
+    t_assert_floats(curve.times.data, 0.0f, 0.5f, 1.0f, 1.5f, 2.0f, 2.5f);
+    t_assert_floats(curve.values.data, 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f);
+    float value;
+    t_assert(curve.evaluate(0.75f, &value));
+    t_assert(value == 1.5f);
+
+    // Holding a value records nothing until we flush, which commits the hold key
+    ok = recorder.handle_sample(3.0f, 5.0f); t_assert(ok);
+    ok = recorder.handle_sample(3.5f, 5.0f); t_assert(ok);
+    t_assert(ad_bake_to_curve(reader, curve));
+    t_assert(curve.num_keys == 6);
+    t_assert(recorder.flush());
+    t_assert(recorder.flush());
+
+    // Baking again should pick up only what's been committed since
+    ok = recorder.handle_sample(4.0f, 7.0f); t_assert(ok);
+    t_assert(ad_bake_to_curve(reader, curve));
+    t_assert(curve.num_keys == 8);
+    t_assert(curve.times.data[6] == 3.5f && curve.values.data[6] == 5.0f);
+    t_assert(curve.times.data[7] == 4.0f && curve.values.data[7] == 7.0f);
+
+    // Baking the whole recorder onto an existing curve should merge with its keys
+    ad_curve merged(1, ad_interp::linear);
+    t_assert(merged.init(2));
+    const float v = 9.0f;
+    merged.set(0.5f, &v);
+    t_assert(ad_bake_to_curve(recorder, merged));
+    t_assert(merged.num_keys == 8);
+    t_assert(merged.values.data[1] == 1.0f);
+
+    return nullptr;
+}
+
+const char* test_input_recorder_tolerance()
+{
+    // Record a noisy ramp with a tolerance wider than the noise
+    ad_input_recorder recorder(64, 1);
+    recorder.tolerance = 0.05f;
+    const bool init_ok = recorder.init();
+    t_assert(init_ok);
+    const int num_samples = 1000;
+    float values[num_samples];
+    uint32_t state = 1;
+    bool ok;
+    for (int i = 0; i < num_samples; i++) {
+        state = state * 1664525u + 1013904223u;
+        const float noise = (static_cast<float>(state >> 8) / 16777216.0f - 0.5f) * 0.04f;
+        const float ramp = i < 500 ? i * 0.01f : 5.0f - (i - 500) * 0.002f;
+        values[i] = ramp + noise;
+        ok = recorder.handle_sample(i * 0.01f, values[i]); t_assert(ok);
+    }
+    t_assert(recorder.flush());
+
+    // The baked curve should need only a handful of keys, and reproduce every sample
+    // to within tolerance
+    ad_curve curve(1, ad_interp::linear);
+    t_assert(ad_bake_to_curve(recorder, curve));
+    t_assert(curve.num_keys < 20);
+    t_assert(curve.times.data[curve.num_keys - 1] == (num_samples - 1) * 0.01f);
+    bool in_tolerance = true;
+    for (int i = 0; i < num_samples; i++) {
+        float value;
+        curve.evaluate(i * 0.01f, &value);
+        in_tolerance = in_tolerance && fabsf(value - values[i]) <= 0.05f + 1e-4f;
+    }
+    t_assert(in_tolerance);
+
+    return nullptr;
+}
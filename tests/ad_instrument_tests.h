@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+
+#include "testing.h"
+#include "ad_instrument.h"
+#include "ad_buffer.h"
+#include "ad_curve.h"
+#include "ad_input_recorder.h"
+
+const char* test_instrument_counters()
+{
+	// Counters only move in builds with -DAD_INSTRUMENT=1: otherwise they stay at zero
+	ad_reset_counters();
+	ad_counters& counters = ad_get_counters();
+
+	// 8 keys take 3 steps to search; inserting a key at the front of a full buffer of
+	// 4 floats reallocates and copies all 4, and removing it shifts them back
+	const float times[] = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+	ad_find_nearest_lte(times, 8, 3.5f);
+	ad_buffer buffer;
+	t_assert(buffer.init(4));
+	t_assert(buffer.resize_for_edit(0, 4));
+	t_assert(buffer.resize_for_edit(0, 1));
+	t_assert(buffer.resize_for_edit(0, -1));
+
+	// A recorder with one chunk of 2 samples drops the repeated value, and allocates a
+	// new chunk each time the last one fills up: after 4 samples, there are 3 chunks
+	ad_input_recorder recorder(2, 1);
+	t_assert(recorder.init());
+	t_assert(recorder.handle_sample(0.0f, 1.0f));
+	t_assert(recorder.handle_sample(1.0f, 1.0f));
+	t_assert(recorder.handle_sample(2.0f, 2.0f));
+	t_assert(recorder.handle_sample(3.0f, 3.0f));
+
+	const uint64_t on = AD_INSTRUMENT ? 1 : 0;
+	t_assert(counters.search_iterations.load() == 3 * on);
+	t_assert(counters.reallocations.load() == 1 * on);
+	t_assert(counters.bytes_moved.load() == 8 * sizeof(float) * on);
+	t_assert(counters.chunk_allocations.load() == 3 * on);
+	t_assert(counters.samples_dropped.load() == 1 * on);
+
+	ad_reset_counters();
+	t_assert(counters.search_iterations.load() == 0);
+	return nullptr;
+}
+
+const char* test_instrument_trace()
+{
+	// A log that was never initialized drops events instead of writing them anywhere
+	ad_trace_log uninitialized;
+	uninitialized.add("dropped", 1, 0, 1);
+	t_assert(uninitialized.size == 0);
+	t_assert(!uninitialized.write_chrome_json("bin/test_trace.json"));
+
+	ad_trace_log log;
+	t_assert(log.init(1));
+	ad_set_trace_hook(ad_trace_log::hook, &log);
+
+	// Trace scopes in the library report to our log only when instrumentation is enabled
+	ad_curve curve(1, ad_interp::linear);
+	t_assert(curve.init(4));
+	const float times[] = { 0.0f, 1.0f };
+	const float values[] = { 0.0f, 1.0f };
+	t_assert(curve.set_many(times, values, 2));
+	ad_set_trace_hook(nullptr, nullptr);
+	t_assert(curve.set_many(times, values, 2));
+	t_assert(log.size == (AD_INSTRUMENT ? 1u : 0u));
+	if (log.size > 0) {
+		t_assert(strcmp(log.events[0].name, "ad_curve::set_many") == 0);
+		t_assert(log.events[0].end_ns >= log.events[0].begin_ns);
+	}
+
+	// Events can also be added directly, and the log grows to fit them
+	const size_t num_library_events = log.size;
+	log.add("first", 1, 5000, 7500);
+	log.add("second", 2, 6000, 6000);
+	t_assert(log.size == num_library_events + 2);
+	t_assert(log.capacity >= log.size);
+
+	// Timestamps are written in microseconds, relative to the earliest event
+	const char* path = "bin/test_trace.json";
+	t_assert(log.write_chrome_json(path));
+	FILE* fp = fopen(path, "r");
+	t_assert(fp);
+	char text[1024] = {};
+	fread(text, 1, sizeof(text) - 1, fp);
+	fclose(fp);
+	remove(path);
+	t_assert(strstr(text, "{\"traceEvents\": [") == text);
+	t_assert(strstr(text, "{\"name\": \"first\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": 0.000, \"dur\": 2.500},"));
+	t_assert(strstr(text, "{\"name\": \"second\", \"ph\": \"X\", \"pid\": 1, \"tid\": 2, \"ts\": 1.000, \"dur\": 0.000}\n]}"));
+	return nullptr;
+}
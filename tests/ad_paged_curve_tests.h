@@ -0,0 +1,158 @@
+#pragma once
+
+#include "testing.h"
+#include "ad_paged_curve.h"
+
+const char* test_paged_curve_edit()
+{
+	// Insert keys in a scrambled order, splitting pages as they fill, then remove every
+	// third key: we should agree with an ad_curve given the same edits throughout
+	ad_paged_curve paged(2, ad_interp::linear);
+	ad_curve reference(2, ad_interp::linear);
+	t_assert(paged.init());
+	t_assert(reference.init(16));
+	const size_t num_keys = 3000;
+	bool ok = true;
+	for (size_t i = 0; i < num_keys; i++) {
+		const size_t key = (i * 1237) % num_keys;
+		const float value[2] = { static_cast<float>(key % 23), static_cast<float>(i) };
+		ok = ok && paged.set(static_cast<float>(key), value);
+		reference.set(static_cast<float>(key), value);
+	}
+	for (size_t key = 0; key < num_keys; key += 3) {
+		ok = ok && paged.remove_at(static_cast<float>(key));
+		reference.remove_at(static_cast<float>(key));
+	}
+	ok = ok && paged.remove_at(0.5f);
+	t_assert(ok);
+	t_assert(paged.num_keys() == reference.num_keys);
+
+	// Pages stay in order, and none overflows
+	const ad_curve_snapshot* table = paged.table;
+	size_t total = 0;
+	bool in_order = true;
+	for (size_t page_i = 0; page_i < table->num_pages; page_i++) {
+		const ad_curve_page* page = table->pages[page_i];
+		in_order = in_order && page->num_keys > 0 && page->num_keys <= AD_CURVE_PAGE_KEYS;
+		in_order = in_order && table->page_first_times[page_i] == page->times[0];
+		in_order = in_order && (page_i == 0 || page->times[0] > table->pages[page_i - 1]->times[table->pages[page_i - 1]->num_keys - 1]);
+		total += page->num_keys;
+	}
+	t_assert(in_order);
+	t_assert(total == reference.num_keys);
+
+	// Single and batched evaluation should both match, including across page boundaries
+	const size_t num_samples = 4 * num_keys + 8;
+	float* times = reinterpret_cast<float*>(malloc(num_samples * sizeof(float)));
+	float* paged_out = reinterpret_cast<float*>(malloc(num_samples * 2 * sizeof(float)));
+	float* reference_out = reinterpret_cast<float*>(malloc(num_samples * 2 * sizeof(float)));
+	for (size_t i = 0; i < num_samples; i++) {
+		times[i] = static_cast<float>(i) * 0.25f - 1.0f;
+	}
+	t_assert(paged.evaluate_many(times, num_samples, paged_out));
+	t_assert(reference.evaluate_many(times, num_samples, reference_out));
+	bool all_match = memcmp(paged_out, reference_out, num_samples * 2 * sizeof(float)) == 0;
+	for (size_t i = 0; i < num_samples; i += 7) {
+		float r[2];
+		all_match = all_match && paged.evaluate(times[i], r) && r[0] == reference_out[i * 2] && r[1] == reference_out[i * 2 + 1];
+	}
+	free(times);
+	free(paged_out);
+	free(reference_out);
+	t_assert(all_match);
+	return nullptr;
+}
+
+static void* limited_allocate(void* user, size_t size)
+{
+	size_t* remaining = reinterpret_cast<size_t*>(user);
+	if (*remaining == 0) {
+		return nullptr;
+	}
+	(*remaining)--;
+	return malloc(size);
+}
+
+static void* limited_reallocate(void* user, void* ptr, size_t /*old_size*/, size_t new_size)
+{
+	return ptr ? realloc(ptr, new_size) : limited_allocate(user, new_size);
+}
+
+static void limited_deallocate(void* /*user*/, void* ptr, size_t /*size*/)
+{
+	free(ptr);
+}
+
+const char* test_paged_curve_split_out_of_memory()
+{
+	// Fill one page in reverse order, with only enough allocations left for the table and
+	// that page, plus the new page for a split: inserting before the first key needs to
+	// grow the table too, which should fail without losing any of the page's keys
+	size_t remaining = 3;
+	const ad_allocator allocator = { limited_allocate, limited_reallocate, limited_deallocate, &remaining };
+	ad_paged_curve paged(1, ad_interp::constant, &allocator);
+	t_assert(paged.init());
+	bool ok = true;
+	for (size_t i = 0; i < AD_CURVE_PAGE_KEYS; i++) {
+		const float value = static_cast<float>(i);
+		ok = ok && paged.set(static_cast<float>(AD_CURVE_PAGE_KEYS - i), &value);
+	}
+	t_assert(ok);
+	t_assert(paged.table->num_pages == 1 && paged.table->page_capacity == 1);
+
+	const float value = -1.0f;
+	t_assert(!paged.set(0.5f, &value));
+	t_assert(paged.num_keys() == AD_CURVE_PAGE_KEYS);
+	t_assert(paged.table->pages[0]->num_keys == AD_CURVE_PAGE_KEYS);
+	bool all_match = true;
+	for (size_t i = 0; i < AD_CURVE_PAGE_KEYS; i++) {
+		float out;
+		all_match = all_match && paged.evaluate(static_cast<float>(AD_CURVE_PAGE_KEYS - i), &out) && out == static_cast<float>(i);
+	}
+	t_assert(all_match);
+	return nullptr;
+}
+
+const char* test_paged_curve_assign()
+{
+	// Assigning from an ad_curve packs its keys into full pages
+	ad_curve source(1, ad_interp::hermite);
+	t_assert(source.init(1000));
+	for (size_t i = 0; i < 1000; i++) {
+		const float value = static_cast<float>(i % 5);
+		const float tangent = 1.0f;
+		source.set(static_cast<float>(i) * 0.5f, &value, &tangent);
+	}
+	ad_paged_curve paged(1, ad_interp::hermite);
+	t_assert(paged.init());
+	t_assert(paged.assign(source));
+	t_assert(paged.num_keys() == 1000);
+	t_assert(paged.table->num_pages == (1000 + AD_CURVE_PAGE_KEYS - 1) / AD_CURVE_PAGE_KEYS);
+	bool all_match = true;
+	for (float time = -1.0f; time < 501.0f; time += 0.1f) {
+		float r;
+		float expected;
+		all_match = all_match && paged.evaluate(time, &r) && source.evaluate(time, &expected) && r == expected;
+	}
+	t_assert(all_match);
+
+	// A snapshot is unchanged by later edits, which copy only the pages they touch
+	const ad_curve_snapshot* snapshot = paged.snapshot();
+	const float value = 9.0f;
+	t_assert(paged.set(0.0f, &value));
+	float r;
+	t_assert(paged.evaluate(0.0f, &r) && r == 9.0f);
+	t_assert(snapshot->evaluate(0.0f, &r) && r == 0.0f);
+	t_assert(paged.table != snapshot);
+	t_assert(paged.table->pages[0] != snapshot->pages[0]);
+	t_assert(paged.table->pages[1] == snapshot->pages[1]);
+	snapshot->release();
+
+	// Assigning an empty curve empties us
+	ad_curve empty(1, ad_interp::hermite);
+	t_assert(empty.init(1));
+	t_assert(paged.assign(empty));
+	t_assert(paged.num_keys() == 0);
+	t_assert(!paged.evaluate(0.0f, &r));
+	return nullptr;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+
+#include "testing.h"
+#include "ad_thread_pool.h"
+
+static void count_task(void* user, size_t task_i)
+{
+	// Uneven tasks, so that threads finish their own ranges at different times and steal
+	std::atomic<int>* counts = reinterpret_cast<std::atomic<int>*>(user);
+	volatile float sink = 0.0f;
+	for (size_t i = 0; i < (task_i % 7) * 200; i++) {
+		sink = sink + 1.0f;
+	}
+	counts[task_i].fetch_add(1);
+}
+
+const char* test_thread_pool_run()
+{
+	ad_thread_pool pool(3);
+	t_assert(pool.init());
+	t_assert(pool.num_workers == (AD_THREADS ? 3u : 0u));
+
+	// Every task should run exactly once per run, across repeated runs of varying size
+	static std::atomic<int> counts[5000];
+	const size_t num_tasks[] = { 1, 2, 5, 5000, 37 };
+	for (size_t run_i = 0; run_i < 5; run_i++) {
+		for (size_t i = 0; i < 5000; i++) {
+			counts[i].store(0);
+		}
+		pool.run(count_task, counts, num_tasks[run_i]);
+		bool exactly_once = true;
+		for (size_t i = 0; i < 5000; i++) {
+			exactly_once = exactly_once && counts[i].load() == (i < num_tasks[run_i] ? 1 : 0);
+		}
+		t_assert(exactly_once);
+	}
+
+	// A pool with no workers runs everything on the calling thread
+	ad_thread_pool serial(0);
+	t_assert(serial.init());
+	for (size_t i = 0; i < 100; i++) {
+		counts[i].store(0);
+	}
+	serial.run(count_task, counts, 100);
+	t_assert(counts[0].load() == 1 && counts[99].load() == 1);
+
+	return nullptr;
+}
+
+const char* test_thread_pool_evaluate_jobs()
+{
+	// 50 vec3 curves, each evaluated at 20 times, writing to one contiguous output array
+	const size_t num_curves = 50;
+	const size_t num_times = 20;
+	ad_curve* curves[num_curves];
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++) {
+		curves[curve_i] = new ad_curve(3, ad_interp::linear);
+		t_assert(curves[curve_i]->init(10));
+		for (int key_i = 0; key_i < 10; key_i++) {
+			const float value[3] = { static_cast<float>(curve_i), static_cast<float>(key_i), static_cast<float>(key_i * key_i) };
+			curves[curve_i]->set(static_cast<float>(key_i), value);
+		}
+	}
+	const size_t num_jobs = num_curves * num_times;
+	ad_eval_job* jobs = new ad_eval_job[num_jobs];
+	float* out = new float[num_jobs * 3];
+	for (size_t job_i = 0; job_i < num_jobs; job_i++) {
+		jobs[job_i].curve = curves[job_i % num_curves];
+		jobs[job_i].time = static_cast<float>(job_i / num_curves) * 0.45f;
+		jobs[job_i].out_value = out + job_i * 3;
+	}
+
+	// Parallel results should match evaluating each job directly, for any batch size
+	ad_thread_pool pool(3);
+	t_assert(pool.init());
+	const size_t batch_sizes[] = { 1, 7, 64, 10000 };
+	for (size_t batch_size : batch_sizes) {
+		memset(out, 0, num_jobs * 3 * sizeof(float));
+		t_assert(ad_evaluate_jobs(&pool, jobs, num_jobs, batch_size));
+		bool matches = true;
+		for (size_t job_i = 0; job_i < num_jobs; job_i++) {
+			float expected[3];
+			jobs[job_i].curve->evaluate(jobs[job_i].time, expected);
+			matches = matches && memcmp(expected, out + job_i * 3, sizeof(expected)) == 0;
+		}
+		t_assert(matches);
+	}
+	t_assert(ad_evaluate_jobs(nullptr, jobs, num_jobs));
+
+	// An empty curve can't be evaluated, which should fail the whole call
+	ad_curve empty(3);
+	jobs[num_jobs / 2].curve = &empty;
+	t_assert(!ad_evaluate_jobs(&pool, jobs, num_jobs));
+
+	for (size_t curve_i = 0; curve_i < num_curves; curve_i++) {
+		delete curves[curve_i];
+	}
+	delete[] jobs;
+	delete[] out;
+	return nullptr;
+}
@@ -1,14 +1,30 @@
 #include <cstdio>
 
 #include "testing.h"
+#include "ad_allocator_tests.h"
 #include "ad_buffer_tests.h"
+#include "ad_blend_tests.h"
 #include "ad_curve_tests.h"
+#include "ad_curve_t_tests.h"
+#include "ad_paged_curve_tests.h"
+#include "ad_curve_snapshot_tests.h"
+#include "ad_curve_journal_tests.h"
+#include "ad_clip_tests.h"
 #include "ad_input_recorder_tests.h"
+#include "ad_binary_tests.h"
+#include "ad_compressed_curve_tests.h"
+#include "ad_thread_pool_tests.h"
+#include "ad_instrument_tests.h"
 
 int main(void)
 {
 	t_begin();
 
+	t_run(test_allocator_default);
+	t_run(test_allocator_arena);
+	t_run(test_allocator_pool);
+	t_run(test_allocator_containers);
+
 	t_run(test_buffer_init);
 	t_run(test_buffer_remove_one);
 	t_run(test_buffer_remove_many_left);
@@ -19,17 +35,87 @@ int main(void)
 	t_run(test_buffer_add_many_right);
 	t_run(test_buffer_resize);
 	t_run(test_buffer_resize_noshrink);
+	t_run(test_buffer_resize_past_double);
+	t_run(test_buffer_growth_policy);
+	t_run(test_buffer_append_grows_in_place);
+	t_run(test_buffer_reserve);
+	t_run(test_buffer_shrink_to_fit);
+
+	t_run(test_blend_linear);
+	t_run(test_blend_cubic);
 
 	t_run(test_curve_init);
 	t_run(test_curve_find_nearest_lte);
 	t_run(test_curve_find_inclusive_range);
 	t_run(test_curve_set);
+	t_run(test_curve_set_out_of_memory);
 	t_run(test_curve_remove_at);
 	t_run(test_curve_evaluate);
+	t_run(test_curve_find_nearest_lte_from);
+	t_run(test_curve_evaluate_many);
+	t_run(test_curve_cursor);
+	t_run(test_curve_remove_at_cardinality);
+	t_run(test_curve_evaluate_linear);
+	t_run(test_curve_evaluate_hermite);
+	t_run(test_curve_evaluate_quat);
+	t_run(test_curve_reserve);
+	t_run(test_curve_set_many);
+	t_run(test_curve_set_many_stride);
+	t_run(test_curve_remove_range);
+	t_run(test_curve_shift_range);
+	t_run(test_curve_scale_range);
+	t_run(test_curve_reduce);
+	t_run(test_curve_uniform);
+	t_run(test_curve_search_index);
+	t_run(test_curve_search_index_concurrent);
+	t_run(test_curve_dirty_ranges);
+	t_run(test_curve_dirty_ranges_cover_edits);
+
+	t_run(test_curve_journal_undo_redo);
+	t_run(test_curve_journal_group);
+	t_run(test_curve_journal_capacity);
+
+	t_run(test_curve_t_vec3);
+	t_run(test_curve_t_time_types);
+	t_run(test_curve_t_matches_curve);
+
+	t_run(test_paged_curve_edit);
+	t_run(test_paged_curve_split_out_of_memory);
+	t_run(test_paged_curve_assign);
+
+	t_run(test_curve_snapshot_edit);
+	t_run(test_curve_snapshot_concurrent);
+	t_run(test_curve_snapshot_publish_under_load);
+
+	t_run(test_clip_init);
+	t_run(test_clip_set);
+	t_run(test_clip_evaluate);
 
 	t_run(test_input_recorder_init);
 	t_run(test_input_recorder_chunks);
 	t_run(test_input_recorder_constant_value);
+	t_run(test_input_recorder_reader);
+	t_run(test_input_recorder_concurrent_reader);
+	t_run(test_input_recorder_reset);
+	t_run(test_input_recorder_release_read_chunks);
+	t_run(test_input_recorder_concurrent_release);
+	t_run(test_input_recorder_ring);
+	t_run(test_input_recorder_bake_to_curve);
+	t_run(test_input_recorder_tolerance);
+
+	t_run(test_binary_curve);
+	t_run(test_binary_clip);
+	t_run(test_binary_borrowed_is_read_only);
+	t_run(test_binary_malicious_sizes);
+
+	t_run(test_compressed_curve_linear);
+	t_run(test_compressed_curve_quaternion);
+
+	t_run(test_thread_pool_run);
+	t_run(test_thread_pool_evaluate_jobs);
+
+	t_run(test_instrument_counters);
+	t_run(test_instrument_trace);
 
 	t_end();
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cmath>
+
 #define t_stringify(x) #x
 #define t_stringify_(x) t_stringify(x)
 #define t_lineno t_stringify_(__LINE__)
@@ -18,6 +20,18 @@
 		} \
 	} while (0);
 
+#define t_assert_floats_near(data, tolerance, ...) \
+	do { \
+		static const float expected[] = {__VA_ARGS__}; \
+		bool got_expected = true; \
+		for (size_t t_i = 0; t_i < sizeof(expected) / sizeof(float); t_i++) { \
+			got_expected = got_expected && fabsf((data)[t_i] - expected[t_i]) <= (tolerance); \
+		} \
+		if (!got_expected) { \
+			return "assertion failed: " #data " was not near {" #__VA_ARGS__ "} as expected (" t_lineno ")"; \
+		} \
+	} while (0);
+
 #define t_begin() \
 	int num_tests_run = 0; \
 	int num_tests_ok = 0;